@@ -0,0 +1,171 @@
+/*
+Monotonic arena for transient allocations (e.g. the parsing state of a file load).
+
+Allocations are served by bumping a pointer in the current block, and are all released at once
+by release_arena. The first block can be provided by the caller (e.g. a buffer on the stack), so
+that small loads perform no heap allocations at all for their transient state.
+
+Each allocation is preceded by its size, so that arena_realloc can be used as a drop-in realloc
+(as required by the libcsv allocation hooks). The most recent allocation is grown in place when
+there is room in the block; otherwise it is copied to a new location.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mcmc_arena.h"
+
+#define ARENA_HEADER_SIZE sizeof(size_t)  // Size of the header stored before each allocation.
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+static unsigned char* block_data(ArenaBlock* block){
+    return (unsigned char*) (block + 1);
+}
+
+
+static size_t size_of(const void* ptr){
+    size_t n_bytes;
+    memcpy(&n_bytes, (const unsigned char*) ptr - ARENA_HEADER_SIZE, sizeof(size_t));
+    return n_bytes;
+}
+
+
+static void set_size(void* ptr, size_t n_bytes){
+    memcpy((unsigned char*) ptr - ARENA_HEADER_SIZE, &n_bytes, sizeof(size_t));
+}
+
+
+// Position, within the block, of an aligned allocation that starts after its header.
+static size_t aligned_position(ArenaBlock* block, size_t alignment){
+    uintptr_t start = (uintptr_t) (block_data(block) + block->used + ARENA_HEADER_SIZE);
+    uintptr_t aligned = (start + alignment - 1) & ~((uintptr_t) alignment - 1);
+    return block->used + ARENA_HEADER_SIZE + (size_t) (aligned - start);
+}
+
+
+// Adds a new block with room for at least n_bytes at the given alignment.
+static int add_block(Arena* arena_p, size_t n_bytes, size_t alignment){
+    size_t capacity = arena_p->head ? 2 * arena_p->head->capacity : ARENA_MIN_BLOCK_SIZE;
+    size_t needed = n_bytes + ARENA_HEADER_SIZE + alignment;
+    ArenaBlock* block;
+
+    if (capacity < ARENA_MIN_BLOCK_SIZE) capacity = ARENA_MIN_BLOCK_SIZE;
+    if (capacity < needed) capacity = needed;
+
+    block = (ArenaBlock*) malloc(sizeof(ArenaBlock) + capacity);
+    if (!block) return EXIT_FAILURE;
+
+    block->prev = arena_p->head;
+    block->capacity = capacity;
+    block->used = 0;
+    block->owned = 1;
+    arena_p->head = block;
+    arena_p->total += capacity;
+    return EXIT_SUCCESS;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Initializes an arena. If buf is given, it is used as the first block (and is never freed by the
+arena); it must be aligned to ARENA_ALIGNMENT and larger than an ArenaBlock header.
+*/
+void init_arena(Arena* arena_p, void* buf, size_t buf_size){
+    memset(arena_p, 0, sizeof(Arena));
+
+    if (buf && buf_size > sizeof(ArenaBlock)){
+        ArenaBlock* block = (ArenaBlock*) buf;
+        block->prev = NULL;
+        block->capacity = buf_size - sizeof(ArenaBlock);
+        block->used = 0;
+        block->owned = 0;
+        arena_p->head = block;
+    }
+}
+
+
+/*
+Allocates n_bytes with the given alignment (a power of two). Returns NULL on failure.
+*/
+void* arena_alloc_aligned(Arena* arena_p, size_t n_bytes, size_t alignment){
+    ArenaBlock* block = arena_p->head;
+    size_t pos;
+    void* ptr;
+
+    if (alignment < ARENA_ALIGNMENT) alignment = ARENA_ALIGNMENT;
+
+    if (!block || aligned_position(block, alignment) + n_bytes > block->capacity){
+        if (add_block(arena_p, n_bytes, alignment)) return NULL;
+        block = arena_p->head;
+    }
+
+    pos = aligned_position(block, alignment);
+    ptr = block_data(block) + pos;
+    block->used = pos + n_bytes;
+    set_size(ptr, n_bytes);
+    arena_p->last = ptr;
+    return ptr;
+}
+
+
+/*
+Allocates n_bytes aligned to ARENA_ALIGNMENT. Returns NULL on failure.
+*/
+void* arena_alloc(Arena* arena_p, size_t n_bytes){
+    return arena_alloc_aligned(arena_p, n_bytes, ARENA_ALIGNMENT);
+}
+
+
+/*
+Resizes an allocation of the arena, with the semantics of realloc (ptr may be NULL).
+The old memory is not released until release_arena.
+*/
+void* arena_realloc(Arena* arena_p, void* ptr, size_t n_bytes){
+    ArenaBlock* block = arena_p->head;
+    size_t old_size;
+    void* new_ptr;
+
+    if (!ptr) return arena_alloc(arena_p, n_bytes);
+    old_size = size_of(ptr);
+
+    // Most recent allocation: grow or shrink in place if it fits in the block.
+    if (ptr == arena_p->last){
+        size_t pos = (size_t) ((unsigned char*) ptr - block_data(block));
+        if (pos + n_bytes <= block->capacity){
+            block->used = pos + n_bytes;
+            set_size(ptr, n_bytes);
+            return ptr;
+        }
+    }
+    else if (n_bytes <= old_size){
+        set_size(ptr, n_bytes);
+        return ptr;
+    }
+
+    new_ptr = arena_alloc(arena_p, n_bytes);
+    if (new_ptr) memcpy(new_ptr, ptr, (old_size < n_bytes) ? old_size : n_bytes);
+    return new_ptr;
+}
+
+
+/*
+Releases all the memory of the arena at once. The arena can then be reused (with no initial buffer).
+*/
+void release_arena(Arena* arena_p){
+    ArenaBlock* block = arena_p->head;
+
+    while (block){
+        ArenaBlock* prev = block->prev;
+        if (block->owned) free(block);
+        block = prev;
+    }
+    memset(arena_p, 0, sizeof(Arena));
+}
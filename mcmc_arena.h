@@ -0,0 +1,38 @@
+#ifndef MCMC_ARENA_H
+#define MCMC_ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ARENA_MIN_BLOCK_SIZE 4096  // Minimum size, in bytes, of the blocks allocated by an arena.
+#define ARENA_ALIGNMENT 16         // Default alignment of the allocations.
+
+// Block of memory of an arena. The allocations follow the header.
+typedef struct ArenaBlock {
+    struct ArenaBlock* prev;
+    size_t capacity;   // Bytes available after the header.
+    size_t used;
+    int owned;         // Whether the block was allocated by the arena (and must be freed by it).
+} ArenaBlock;
+
+// Monotonic arena: allocations are only released all at once, by release_arena.
+typedef struct {
+    ArenaBlock* head;  // Current block.
+    void* last;        // Most recent allocation, which can be grown in place.
+    size_t total;      // Bytes allocated by all blocks.
+} Arena;
+
+void init_arena(Arena* arena_p, void* buf, size_t buf_size);
+void* arena_alloc(Arena* arena_p, size_t n_bytes);
+void* arena_alloc_aligned(Arena* arena_p, size_t n_bytes, size_t alignment);
+void* arena_realloc(Arena* arena_p, void* ptr, size_t n_bytes);
+void release_arena(Arena* arena_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
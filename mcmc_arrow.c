@@ -0,0 +1,257 @@
+/*
+Export of loaded data through the Arrow C Data Interface.
+
+The exported ArrowArray takes over the buffers of the loaded data, so that consumers (e.g. pyarrow,
+the R arrow package or nanoarrow) can adopt them without copying. The release callbacks free the
+buffers in the same way as free_ili_input / free_csv_vector would.
+No dependency on the Arrow library is required.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcmc_arrow.h"
+
+#define ILI_NUM_COLUMNS 3  // Number of exported columns of an ILIinput (year, week, estInc).
+
+static const char* ili_column_names[ILI_NUM_COLUMNS] = {"year", "week", "estInc"};
+
+
+// ------------------------------------------------------------------------------------------------
+// PRIVATE DATA AND RELEASE CALLBACKS
+// ------------------------------------------------------------------------------------------------
+
+// Private data of an exported primitive column. Owns the data buffer.
+typedef struct ColumnPrivate{
+    const void* buffers[2];  // Validity bitmap (always NULL, no nulls) and data buffer.
+    void* data;
+} ColumnPrivate;
+
+// Private data of an exported struct array. Owns the child structs.
+typedef struct StructPrivate{
+    const void* buffers[1];  // Validity bitmap (always NULL, no nulls).
+    struct ArrowArray* children[ILI_NUM_COLUMNS];
+} StructPrivate;
+
+// Private data of an exported schema. Owns the child structs and a copy of the field name.
+typedef struct SchemaPrivate{
+    char* name;
+    struct ArrowSchema* children[ILI_NUM_COLUMNS];
+} SchemaPrivate;
+
+
+static void release_column_array(struct ArrowArray* array_p){
+    ColumnPrivate* priv = (ColumnPrivate*) array_p->private_data;
+
+    untrack_memory(priv->data);
+    free(priv->data);
+    free(priv);
+    array_p->release = NULL;  // Marks as released.
+}
+
+
+static void release_struct_array(struct ArrowArray* array_p){
+    StructPrivate* priv = (StructPrivate*) array_p->private_data;
+
+    for (int64_t i = 0; i < array_p->n_children; i++){
+        struct ArrowArray* child = priv->children[i];
+        if (child->release) child->release(child);  // Children may have been moved by the consumer.
+        free(child);
+    }
+    free(priv);
+    array_p->release = NULL;
+}
+
+
+static void release_schema(struct ArrowSchema* schema_p){
+    SchemaPrivate* priv = (SchemaPrivate*) schema_p->private_data;
+
+    for (int64_t i = 0; i < schema_p->n_children; i++){
+        struct ArrowSchema* child = priv->children[i];
+        if (child->release) child->release(child);
+        free(child);
+    }
+    free(priv->name);
+    free(priv);
+    schema_p->release = NULL;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+// Fills a schema struct with no children. The name is copied.
+static int init_schema(struct ArrowSchema* schema_p, const char* format, const char* name){
+    SchemaPrivate* priv = (SchemaPrivate*) calloc(1, sizeof(SchemaPrivate));
+
+    if (!priv) return EXIT_FAILURE;
+    if (name){
+        priv->name = (char*) malloc(strlen(name) + 1);
+        if (!priv->name){
+            free(priv);
+            return EXIT_FAILURE;
+        }
+        strcpy(priv->name, name);
+    }
+
+    schema_p->format = format;
+    schema_p->name = priv->name;
+    schema_p->metadata = NULL;
+    schema_p->flags = 0;  // Columns have no nulls.
+    schema_p->n_children = 0;
+    schema_p->children = priv->children;
+    schema_p->dictionary = NULL;
+    schema_p->release = release_schema;
+    schema_p->private_data = priv;
+    return EXIT_SUCCESS;
+}
+
+
+// Fills an array struct for a primitive column. Ownership of data is taken only on success.
+static int init_column_array(struct ArrowArray* array_p, void* data, size_t size){
+    ColumnPrivate* priv = (ColumnPrivate*) malloc(sizeof(ColumnPrivate));
+
+    if (!priv) return EXIT_FAILURE;
+    priv->buffers[0] = NULL;
+    priv->buffers[1] = data;
+    priv->data = data;
+
+    array_p->length = (int64_t) size;
+    array_p->null_count = 0;
+    array_p->offset = 0;
+    array_p->n_buffers = 2;
+    array_p->n_children = 0;
+    array_p->buffers = priv->buffers;
+    array_p->children = NULL;
+    array_p->dictionary = NULL;
+    array_p->release = release_column_array;
+    array_p->private_data = priv;
+    return EXIT_SUCCESS;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Exports an ILIinput as an Arrow struct array (equivalent to a record batch) with int32 columns
+"year", "week" and "estInc".
+
+The arrays of the ILIinput are moved into the exported array, not copied. On success, data_p is
+left as after a call to free_ili_input, and the buffers are freed by the release callback of
+array_p. The schema has its own, independent release callback.
+
+@param data_p  Pointer to a loaded ILIinput struct.
+@param array_p  Pointer to an uninitialized ArrowArray, to which the data is exported.
+@param schema_p  Pointer to an uninitialized ArrowSchema, to which the data type is exported.
+
+@return An integer error code. On failure, data_p is left untouched.
+*/
+int export_ili_input_arrow(ILIinput* data_p, struct ArrowArray* array_p, struct ArrowSchema* schema_p){
+    int* columns[ILI_NUM_COLUMNS] = {data_p->year, data_p->week, data_p->estInc};
+    StructPrivate* priv;
+    SchemaPrivate* schema_priv;
+    int i;
+
+    // Schema: struct of three int32 fields
+    if (init_schema(schema_p, "+s", "")){
+        fprintf(stderr, "Failed to allocate ArrowSchema @ export_ili_input_arrow.\n");
+        return EXIT_FAILURE;
+    }
+    schema_priv = (SchemaPrivate*) schema_p->private_data;
+    for (i = 0; i < ILI_NUM_COLUMNS; i++){
+        struct ArrowSchema* child = (struct ArrowSchema*) malloc(sizeof(struct ArrowSchema));
+        if (!child || init_schema(child, "i", ili_column_names[i])){
+            free(child);
+            break;
+        }
+        schema_priv->children[i] = child;
+        schema_p->n_children++;
+    }
+    if (i < ILI_NUM_COLUMNS){
+        fprintf(stderr, "Failed to allocate ArrowSchema children @ export_ili_input_arrow.\n");
+        schema_p->release(schema_p);
+        return EXIT_FAILURE;
+    }
+
+    // Array: allocate everything before taking ownership of the columns
+    priv = (StructPrivate*) calloc(1, sizeof(StructPrivate));
+    for (i = 0; priv && i < ILI_NUM_COLUMNS; i++){
+        priv->children[i] = (struct ArrowArray*) malloc(sizeof(struct ArrowArray));
+        if (!priv->children[i]) break;
+    }
+    if (!priv || i < ILI_NUM_COLUMNS){
+        fprintf(stderr, "Failed to allocate ArrowArray @ export_ili_input_arrow.\n");
+        for (i = 0; priv && i < ILI_NUM_COLUMNS; i++) free(priv->children[i]);
+        free(priv);
+        schema_p->release(schema_p);
+        return EXIT_FAILURE;
+    }
+
+    priv->buffers[0] = NULL;
+    array_p->length = (int64_t) data_p->size;
+    array_p->null_count = 0;
+    array_p->offset = 0;
+    array_p->n_buffers = 1;
+    array_p->n_children = 0;
+    array_p->buffers = priv->buffers;
+    array_p->children = priv->children;
+    array_p->dictionary = NULL;
+    array_p->release = release_struct_array;
+    array_p->private_data = priv;
+
+    for (i = 0; i < ILI_NUM_COLUMNS; i++){
+        if (init_column_array(priv->children[i], columns[i], data_p->size)){
+            fprintf(stderr, "Failed to allocate ArrowArray column @ export_ili_input_arrow.\n");
+            // Columns not yet exported are still owned by data_p.
+            for (int j = i; j < ILI_NUM_COLUMNS; j++) free(priv->children[j]);
+            for (int j = 0; j < i; j++) ((ColumnPrivate*) priv->children[j]->private_data)->data = NULL;
+            array_p->release(array_p);
+            schema_p->release(schema_p);
+            return EXIT_FAILURE;
+        }
+        array_p->n_children++;
+    }
+
+    // Ownership has been transferred
+    data_p->year = data_p->week = data_p->estInc = NULL;
+    data_p->size = 0;
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Exports a vector of doubles (e.g. as read with read_csv_double_vector) as an Arrow float64 array.
+
+The vector is moved into the exported array, not copied. On success, *vec_p is set to NULL and
+the vector is freed by the release callback of array_p.
+
+@param vec_p  Pointer to the vector of doubles.
+@param size  Number of elements in the vector.
+@param name  Field name given to the exported schema. Copied.
+@param array_p  Pointer to an uninitialized ArrowArray, to which the data is exported.
+@param schema_p  Pointer to an uninitialized ArrowSchema, to which the data type is exported.
+
+@return An integer error code. On failure, *vec_p is left untouched.
+*/
+int export_double_vector_arrow(double* *vec_p, size_t size, const char* name,
+    struct ArrowArray* array_p, struct ArrowSchema* schema_p){
+
+    if (init_schema(schema_p, "g", name)){
+        fprintf(stderr, "Failed to allocate ArrowSchema @ export_double_vector_arrow.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (init_column_array(array_p, *vec_p, size)){
+        fprintf(stderr, "Failed to allocate ArrowArray @ export_double_vector_arrow.\n");
+        schema_p->release(schema_p);
+        return EXIT_FAILURE;
+    }
+
+    *vec_p = NULL;  // Ownership has been transferred
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+#ifndef MCMC_ARROW_H
+#define MCMC_ARROW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "mcmc_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Structs of the Arrow C Data Interface (https://arrow.apache.org/docs/format/CDataInterface.html).
+// The layout is part of the Arrow ABI, so the definitions are shared with any other producer.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    // Array type description
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowSchema*);
+    // Opaque producer-specific data
+    void* private_data;
+};
+
+struct ArrowArray {
+    // Array data description
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowArray*);
+    // Opaque producer-specific data
+    void* private_data;
+};
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+int export_ili_input_arrow(ILIinput* data_p, struct ArrowArray* array_p, struct ArrowSchema* schema_p);
+int export_double_vector_arrow(double* *vec_p, size_t size, const char* name,
+    struct ArrowArray* array_p, struct ArrowSchema* schema_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
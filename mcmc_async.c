@@ -0,0 +1,168 @@
+/*
+Asynchronous loading of inputs on background threads.
+
+Each load runs the usual reader (read_ili_csv, read_csv_double_vector) on its own thread, so that
+several inputs load concurrently with each other and with the model setup. Typical use:
+
+    LoadHandle ili_load, contacts_load;
+    start_ili_load(&ili_load, ili_fname);
+    start_double_vector_load(&contacts_load, contacts_fname);
+    // ... RNG seeding, allocations ...
+    if (wait_ili_load(&ili_load, &data) | wait_double_vector_load(&contacts_load, &contacts, &t)) ...
+
+Every started load must be waited for exactly once, which joins its thread.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcmc_async.h"
+#include "mcmc_trace.h"
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+// Thread function: runs the reader corresponding to the kind of load.
+static void* load_thread(void* handle_vp){
+    LoadHandle* handle_p = (LoadHandle*) handle_vp;
+
+    trace_set_thread_name("async load");
+    switch (handle_p->kind){
+    case LOAD_ILI_CSV:
+        handle_p->status = read_ili_csv(handle_p->fname, &handle_p->ili);
+        break;
+
+    case LOAD_DOUBLE_VECTOR:
+        handle_p->status = read_csv_double_vector(handle_p->fname, &handle_p->vec, &handle_p->vsize);
+        break;
+
+    default:
+        handle_p->status = EXIT_FAILURE;
+        break;
+    }
+
+    atomic_store_explicit(&handle_p->done, 1, memory_order_release);
+    return NULL;
+}
+
+
+static int start_load(LoadHandle* handle_p, LoadKind kind, const char* fname){
+    int err;
+
+    memset(handle_p, 0, sizeof(LoadHandle));
+    handle_p->kind = kind;
+    atomic_init(&handle_p->done, 0);
+
+    handle_p->fname = (char*) malloc(strlen(fname) + 1);
+    if (!handle_p->fname){
+        fprintf(stderr, "Failed to allocate load handle for %s.\n", fname);
+        return EXIT_FAILURE;
+    }
+    strcpy(handle_p->fname, fname);
+
+    err = pthread_create(&handle_p->thread, NULL, load_thread, handle_p);
+    if (err){
+        fprintf(stderr, "Failed to start loading thread for %s: \"%s\"\n", fname, strerror(err));
+        free(handle_p->fname); handle_p->fname = NULL;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+// Joins the loading thread and releases the handle. Returns the status of the reader.
+static int join_load(LoadHandle* handle_p){
+    int err = pthread_join(handle_p->thread, NULL);
+
+    if (err){
+        fprintf(stderr, "Failed to join loading thread for %s: \"%s\"\n", handle_p->fname, strerror(err));
+        handle_p->status = EXIT_FAILURE;
+    }
+    free(handle_p->fname); handle_p->fname = NULL;
+    return handle_p->status;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Starts reading an ILI csv file (as read_ili_csv) on a background thread.
+
+@param handle_p  Pointer to a LoadHandle, which must remain valid until wait_ili_load.
+@param fname  Path for the csv file. Copied.
+
+@return An integer error code (failure to start the thread). Reading errors are reported by wait_ili_load.
+*/
+int start_ili_load(LoadHandle* handle_p, const char* fname){
+    return start_load(handle_p, LOAD_ILI_CSV, fname);
+}
+
+
+/*
+Starts reading a csv file of doubles (as read_csv_double_vector) on a background thread.
+
+@param handle_p  Pointer to a LoadHandle, which must remain valid until wait_double_vector_load.
+@param fname  Path for the csv file. Copied.
+
+@return An integer error code (failure to start the thread).
+*/
+int start_double_vector_load(LoadHandle* handle_p, const char* fname){
+    return start_load(handle_p, LOAD_DOUBLE_VECTOR, fname);
+}
+
+
+/*
+Returns 1 if the load has finished, 0 if it is still running. Does not block.
+*/
+int poll_load(const LoadHandle* handle_p){
+    return atomic_load_explicit(&handle_p->done, memory_order_acquire);
+}
+
+
+/*
+Waits for an ILI load to finish and moves its result to data_p, as read_ili_csv would have written it.
+
+@return The error code returned by read_ili_csv.
+*/
+int wait_ili_load(LoadHandle* handle_p, ILIinput* data_p){
+    int status = join_load(handle_p);
+
+    *data_p = handle_p->ili;
+    memset(&handle_p->ili, 0, sizeof(ILIinput));
+    return status;
+}
+
+
+/*
+Waits for a double vector load to finish and moves its result to vec_p and vsize_p, as
+read_csv_double_vector would have written them (the vector is released with free_csv_vector).
+
+@return The error code returned by read_csv_double_vector.
+*/
+int wait_double_vector_load(LoadHandle* handle_p, double* *vec_p, size_t* vsize_p){
+    int status = join_load(handle_p);
+
+    *vec_p = handle_p->vec;
+    *vsize_p = handle_p->vsize;
+    handle_p->vec = NULL;
+    handle_p->vsize = 0;
+    return status;
+}
+
+
+/*
+Returns the memory held by the result of a load (heap), which is empty until the load has finished
+and after the result was moved by a wait function.
+*/
+MemoryUsage load_memory(const LoadHandle* handle_p){
+    MemoryUsage usage = {0, 0, MEMORY_HEAP};
+
+    if (!poll_load(handle_p)) return usage;
+    if (handle_p->kind == LOAD_ILI_CSV) return ili_input_memory(&handle_p->ili);
+    return region_memory(handle_p->vec, handle_p->vsize * sizeof(double), MEMORY_HEAP);
+}
@@ -0,0 +1,35 @@
+#ifndef MCMC_ASYNC_H
+#define MCMC_ASYNC_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "mcmc_io.h"
+
+// Kind of input loaded by a LoadHandle.
+typedef enum {
+    LOAD_ILI_CSV = 1,        // read_ili_csv
+    LOAD_DOUBLE_VECTOR = 2   // read_csv_double_vector
+} LoadKind;
+
+// Handle of an input being loaded on a background thread.
+typedef struct {
+    pthread_t thread;
+    LoadKind kind;
+    char* fname;
+    atomic_int done;  // Set when the load has finished (successfully or not).
+    int status;       // Error code returned by the reader. Valid once done.
+
+    // Results, moved to the caller by the wait functions.
+    ILIinput ili;
+    double* vec;
+    size_t vsize;
+} LoadHandle;
+
+int start_ili_load(LoadHandle* handle_p, const char* fname);
+int start_double_vector_load(LoadHandle* handle_p, const char* fname);
+int poll_load(const LoadHandle* handle_p);
+int wait_ili_load(LoadHandle* handle_p, ILIinput* data_p);
+int wait_double_vector_load(LoadHandle* handle_p, double* *vec_p, size_t* vsize_p);
+MemoryUsage load_memory(const LoadHandle* handle_p);
+
+#endif
@@ -0,0 +1,349 @@
+/*
+Minibatch and subsample views over ILI data, for stochastic-gradient MCMC.
+
+The batch buffers are allocated once (alloc_ili_batch) and reused at every iteration, so that
+packing a minibatch costs time proportional to the batch size and performs no allocations.
+The gather of rows has AVX2 and AVX-512 variants using vector gather instructions, selected at
+run time (see mcmc_cpu.h).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "mcmc_cpu.h"
+#include "mcmc_batch.h"
+
+#ifdef CPU_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+#define BATCH_ALIGNMENT 64  // Alignment, in bytes, of the batch buffers (one cache line).
+
+typedef void (*gather_func)(const int* src, const size_t* rows, size_t n, int* dst);
+
+static gather_func gather_kernel;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+// Allocates a cache-line aligned buffer. The size is rounded up as required by aligned_alloc.
+static void* alloc_aligned(size_t n_bytes){
+    size_t rounded = (n_bytes + BATCH_ALIGNMENT - 1) / BATCH_ALIGNMENT * BATCH_ALIGNMENT;
+    if (rounded == 0) rounded = BATCH_ALIGNMENT;
+    return aligned_alloc(BATCH_ALIGNMENT, rounded);
+}
+
+
+// Draws an index uniformly from [0, n).
+static size_t draw_index(size_t n, uniform_func uniform, void* rng){
+    size_t i = (size_t) (uniform(rng) * n);
+    return (i < n) ? i : n - 1;  // Guards against rounding at the upper edge.
+}
+
+
+// Copies one int column at the given rows. The vector variants store to the aligned batch buffers.
+static void gather_scalar(const int* src, const size_t* rows, size_t n, int* dst){
+    for (size_t i = 0; i < n; i++){
+        dst[i] = src[rows[i]];
+    }
+}
+
+
+#ifdef CPU_HAVE_AVX2
+CPU_TARGET_AVX2 static void gather_avx2(const int* src, const size_t* rows, size_t n, int* dst){
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4){
+        __m256i idx = _mm256_loadu_si256((const __m256i*) (rows + i));
+        _mm_store_si128((__m128i*) (dst + i), _mm256_i64gather_epi32(src, idx, sizeof(int)));
+    }
+    gather_scalar(src, rows + i, n - i, dst + i);
+}
+#endif
+
+
+#ifdef CPU_HAVE_AVX512
+CPU_TARGET_AVX512 static void gather_avx512(const int* src, const size_t* rows, size_t n, int* dst){
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        __m512i idx = _mm512_loadu_si512((const void*) (rows + i));
+        _mm256_store_si256((__m256i*) (dst + i), _mm512_i64gather_epi32(idx, src, sizeof(int)));
+    }
+    gather_scalar(src, rows + i, n - i, dst + i);
+}
+#endif
+
+
+static void resolve_kernels(void){
+    gather_kernel = gather_scalar;
+
+    switch (cpu_isa()){
+    case CPU_ISA_AVX512:
+#ifdef CPU_HAVE_AVX512
+        gather_kernel = gather_avx512;
+        break;
+#endif
+    case CPU_ISA_AVX2:
+#ifdef CPU_HAVE_AVX2
+        gather_kernel = gather_avx2;
+#endif
+        break;
+    case CPU_ISA_SCALAR:
+        break;
+    }
+}
+
+
+// Packs the rows currently listed in batch_p->rows[0 ... n-1].
+static void pack_rows(const ILIinput* data_p, size_t n, ILIbatch* batch_p){
+    pthread_once(&kernels_once, resolve_kernels);
+    gather_kernel(data_p->year, batch_p->rows, n, batch_p->year);
+    gather_kernel(data_p->week, batch_p->rows, n, batch_p->week);
+    gather_kernel(data_p->estInc, batch_p->rows, n, batch_p->estInc);
+    batch_p->size = n;
+}
+
+
+/*
+Returns the influenza season (as the year in which it starts) to which a given epiweek belongs.
+Seasons start at week ILI_SEASON_START_WEEK.
+*/
+int ili_season_of(int year, int week){
+    return (week >= ILI_SEASON_START_WEEK) ? year : year - 1;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// BATCH BUFFERS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Allocates the aligned buffers of a minibatch with room for `capacity` rows.
+The buffers can then be reused by the gather and sample functions without further allocations.
+*/
+int alloc_ili_batch(ILIbatch* batch_p, size_t capacity){
+    batch_p->rows =   (size_t*) alloc_aligned(capacity * sizeof(size_t));
+    batch_p->year =   (int*) alloc_aligned(capacity * sizeof(int));
+    batch_p->week =   (int*) alloc_aligned(capacity * sizeof(int));
+    batch_p->estInc = (int*) alloc_aligned(capacity * sizeof(int));
+    batch_p->capacity = capacity;
+    batch_p->size = 0;
+
+    if (!batch_p->rows || !batch_p->year || !batch_p->week || !batch_p->estInc){
+        fprintf(stderr, "Failed to allocate ILIbatch buffers @ alloc_ili_batch.\n");
+        free_ili_batch(batch_p);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Frees the buffers of an ILIbatch struct. Sets its pointers to NULL and its sizes to 0.
+*/
+void free_ili_batch(ILIbatch* batch_p){
+    free(batch_p->rows); batch_p->rows = NULL;
+    free(batch_p->year); batch_p->year = NULL;
+    free(batch_p->week); batch_p->week = NULL;
+    free(batch_p->estInc); batch_p->estInc = NULL;
+    batch_p->capacity = batch_p->size = 0;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// GATHER AND SAMPLING
+// ------------------------------------------------------------------------------------------------
+
+/*
+Packs the given rows of an ILIinput into a preallocated batch.
+
+@param data_p  Pointer to the source ILIinput struct.
+@param rows  Row indices (0-based) to be packed, in order. Must be smaller than data_p->size.
+@param n  Number of rows to pack. Must not exceed the batch capacity.
+@param batch_p  Pointer to an allocated ILIbatch, to which the rows are written.
+
+@return An integer error code.
+*/
+int gather_ili_batch(const ILIinput* data_p, const size_t* rows, size_t n, ILIbatch* batch_p){
+    if (n > batch_p->capacity){
+        fprintf(stderr, "Batch of %zu rows exceeds capacity %zu @ gather_ili_batch.\n",
+            n, batch_p->capacity);
+        return EXIT_FAILURE;
+    }
+
+    if (rows != batch_p->rows)
+        memcpy(batch_p->rows, rows, n * sizeof(size_t));
+
+    pack_rows(data_p, n, batch_p);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Packs the rows of an index view into a preallocated batch.
+*/
+int gather_ili_view(ILIindexView view, ILIbatch* batch_p){
+    return gather_ili_batch(view.src, view.rows, view.size, batch_p);
+}
+
+
+/*
+Draws a minibatch of n rows uniformly (with replacement) and packs it into a preallocated batch.
+
+@param data_p  Pointer to the source ILIinput struct. Must not be empty.
+@param n  Number of rows to draw. Must not exceed the batch capacity.
+@param uniform  Function returning uniform random numbers in [0, 1).
+@param rng  State of the random number generator, passed to `uniform`.
+@param batch_p  Pointer to an allocated ILIbatch, to which the rows are written.
+
+@return An integer error code.
+*/
+int sample_ili_batch(const ILIinput* data_p, size_t n, uniform_func uniform, void* rng,
+    ILIbatch* batch_p){
+
+    if (n > batch_p->capacity || data_p->size == 0){
+        fprintf(stderr, "Cannot draw %zu rows from %zu into batch of capacity %zu @ sample_ili_batch.\n",
+            n, data_p->size, batch_p->capacity);
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < n; i++){
+        batch_p->rows[i] = draw_index(data_p->size, uniform, rng);
+    }
+
+    pack_rows(data_p, n, batch_p);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Groups the rows of an ILIinput by influenza season (see ili_season_of).
+Should be called once after loading; the strata can then be used at every iteration.
+Fails if a year is not positive or if the rows span more than ILI_MAX_SEASONS seasons, which
+usually means a wrong year in the data.
+
+@param data_p  Pointer to the source ILIinput struct.
+@param strata_p  Pointer to an ILIstrata struct, which is allocated and written.
+
+@return An integer error code.
+*/
+int build_ili_strata(const ILIinput* data_p, ILIstrata* strata_p){
+    int min_season, max_season;
+    size_t n_seasons;
+    size_t *count;  // Number of rows in each season, then write cursor for each season.
+    size_t s, i;
+
+    memset(strata_p, 0, sizeof(ILIstrata));
+    if (data_p->size == 0) return EXIT_SUCCESS;
+
+    // Range of seasons
+    min_season = INT_MAX;
+    max_season = INT_MIN;
+    for (i = 0; i < data_p->size; i++){
+        int season;
+        if (data_p->year[i] < 1){
+            fprintf(stderr, "Invalid year %d at row %zu @ build_ili_strata.\n", data_p->year[i], i);
+            return EXIT_FAILURE;
+        }
+        season = ili_season_of(data_p->year[i], data_p->week[i]);
+        if (season < min_season) min_season = season;
+        if (season > max_season) max_season = season;
+    }
+    if ((long) max_season - min_season >= ILI_MAX_SEASONS){
+        fprintf(stderr, "Seasons %d to %d span more than %d seasons (wrong year?) @ build_ili_strata.\n",
+            min_season, max_season, ILI_MAX_SEASONS);
+        return EXIT_FAILURE;
+    }
+    n_seasons = (size_t) (max_season - min_season) + 1;
+
+    // Counting sort of the rows by season
+    count = (size_t*) calloc(n_seasons, sizeof(size_t));
+    strata_p->season = (int*) malloc(n_seasons * sizeof(int));
+    strata_p->offset = (size_t*) malloc((n_seasons + 1) * sizeof(size_t));
+    strata_p->rows = (size_t*) malloc(data_p->size * sizeof(size_t));
+    if (!count || !strata_p->season || !strata_p->offset || !strata_p->rows){
+        fprintf(stderr, "Failed to allocate ILIstrata @ build_ili_strata.\n");
+        free(count);
+        free_ili_strata(strata_p);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < data_p->size; i++){
+        count[ili_season_of(data_p->year[i], data_p->week[i]) - min_season]++;
+    }
+
+    // Offsets of the non-empty seasons. Count is turned into the write cursor of each season.
+    strata_p->offset[0] = 0;
+    for (s = 0; s < n_seasons; s++){
+        size_t n_rows = count[s];
+        if (n_rows == 0) continue;
+        count[s] = strata_p->offset[strata_p->n_strata];
+        strata_p->season[strata_p->n_strata] = min_season + (int) s;
+        strata_p->offset[strata_p->n_strata + 1] = strata_p->offset[strata_p->n_strata] + n_rows;
+        strata_p->n_strata++;
+    }
+
+    for (i = 0; i < data_p->size; i++){
+        strata_p->rows[count[ili_season_of(data_p->year[i], data_p->week[i]) - min_season]++] = i;
+    }
+
+    free(count);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Frees the arrays of an ILIstrata struct. Sets its pointers to NULL and its size to 0.
+*/
+void free_ili_strata(ILIstrata* strata_p){
+    free(strata_p->season); strata_p->season = NULL;
+    free(strata_p->offset); strata_p->offset = NULL;
+    free(strata_p->rows); strata_p->rows = NULL;
+    strata_p->n_strata = 0;
+}
+
+
+/*
+Draws a minibatch stratified by season: n_per_stratum rows (with replacement) from each season.
+Rows are packed season by season, in the order of strata_p->season.
+
+@param data_p  Pointer to the source ILIinput struct.
+@param strata_p  Pointer to the strata built from data_p with build_ili_strata.
+@param n_per_stratum  Number of rows to draw from each season.
+@param uniform  Function returning uniform random numbers in [0, 1).
+@param rng  State of the random number generator, passed to `uniform`.
+@param batch_p  Pointer to an allocated ILIbatch with capacity for n_strata * n_per_stratum rows.
+
+@return An integer error code.
+*/
+int sample_ili_batch_stratified(const ILIinput* data_p, const ILIstrata* strata_p,
+    size_t n_per_stratum, uniform_func uniform, void* rng, ILIbatch* batch_p){
+
+    size_t n = strata_p->n_strata * n_per_stratum;
+    size_t pos = 0;
+
+    if (n > batch_p->capacity){
+        fprintf(stderr, "Stratified batch of %zu rows exceeds capacity %zu @ sample_ili_batch_stratified.\n",
+            n, batch_p->capacity);
+        return EXIT_FAILURE;
+    }
+
+    for (size_t s = 0; s < strata_p->n_strata; s++){
+        const size_t* stratum_rows = strata_p->rows + strata_p->offset[s];
+        size_t stratum_size = strata_p->offset[s + 1] - strata_p->offset[s];
+
+        for (size_t i = 0; i < n_per_stratum; i++){
+            batch_p->rows[pos++] = stratum_rows[draw_index(stratum_size, uniform, rng)];
+        }
+    }
+
+    pack_rows(data_p, n, batch_p);
+    return EXIT_SUCCESS;
+}
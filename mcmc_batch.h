@@ -0,0 +1,62 @@
+#ifndef MCMC_BATCH_H
+#define MCMC_BATCH_H
+
+#include <stddef.h>
+#include "mcmc_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ILI_SEASON_START_WEEK 40  // Epiweek at which an influenza season begins.
+#define ILI_MAX_SEASONS 1000      // Widest range of seasons accepted by build_ili_strata.
+
+// Read-only view of a subset of the rows of an ILIinput, given by row indices.
+// Does not own any memory.
+typedef struct {
+    const ILIinput* src;  // Data the rows refer to.
+    const size_t* rows;   // Row indices (0-based) into src.
+    size_t size;          // Number of rows in the view.
+} ILIindexView;
+
+// Reusable, aligned scratch buffers holding a packed minibatch of ILI rows.
+typedef struct {
+    size_t capacity;  // Maximum number of rows the batch can hold.
+    size_t size;      // Number of rows currently packed.
+    size_t *rows;     // Source row of each packed element.
+    int *year;
+    int *week;
+    int *estInc;
+} ILIbatch;
+
+// Rows of an ILIinput grouped by influenza season, for stratified sampling.
+typedef struct {
+    size_t n_strata;  // Number of (non-empty) seasons.
+    int *season;      // Starting year of each season.
+    size_t *offset;   // Stratum s holds rows[offset[s]] ... rows[offset[s+1] - 1].
+    size_t *rows;     // Row indices, grouped by season.
+} ILIstrata;
+
+// Uniform random number generator in [0, 1), as provided by the sampler.
+typedef double (*uniform_func)(void* rng);
+
+int ili_season_of(int year, int week);
+
+int alloc_ili_batch(ILIbatch* batch_p, size_t capacity);
+void free_ili_batch(ILIbatch* batch_p);
+
+int gather_ili_batch(const ILIinput* data_p, const size_t* rows, size_t n, ILIbatch* batch_p);
+int gather_ili_view(ILIindexView view, ILIbatch* batch_p);
+int sample_ili_batch(const ILIinput* data_p, size_t n, uniform_func uniform, void* rng,
+    ILIbatch* batch_p);
+
+int build_ili_strata(const ILIinput* data_p, ILIstrata* strata_p);
+void free_ili_strata(ILIstrata* strata_p);
+int sample_ili_batch_stratified(const ILIinput* data_p, const ILIstrata* strata_p,
+    size_t n_per_stratum, uniform_func uniform, void* rng, ILIbatch* batch_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,643 @@
+/*
+Single-file bundle of input datasets (ILI data, contacts, covariates), with manifest and provenance.
+
+A bundle is opened with one open/fstat/mmap, after which every dataset is available as a view
+pointing into the mapping. No parsing or copying is performed.
+
+File layout:
+    BundleHeader | datasets | provenance text | manifest (BundleEntry[])
+where each dataset is its column data (each column 64-byte aligned) followed by its block checksums.
+
+The column data is checksummed (CRC32C, see mcmc_checksum.h) in blocks of BUNDLE_BLOCK_SIZE bytes,
+at write time. The checksums are verified eagerly, when the bundle is opened, or lazily, one block
+at a time, the first time a range of rows it holds is accessed (bundle_ili_rows, bundle_double_rows
+or verify_bundle_rows). Each block is verified at most once by the lazy checks, so that integrity
+costs one pass over the data that is actually used, at memory speed. The manifest has its own
+CRC32C, always checked.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mcmc_checksum.h"
+#include "mcmc_trace.h"
+#include "mcmc_bundle.h"
+
+// Verification state of a block.
+#define BLOCK_UNVERIFIED 0
+#define BLOCK_VALID 1
+#define BLOCK_CORRUPTED 2
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+static int write_bytes(BundleWriter* w, const void* data, size_t n){
+    if (n && fwrite(data, 1, n, w->fp) != n){
+        fprintf(stderr, "Failed to write to %s: \"%s\"\n", w->fname, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    w->file_pos += n;
+    return EXIT_SUCCESS;
+}
+
+
+// Writes zeros up to the next multiple of align.
+static int write_padding(BundleWriter* w, size_t align){
+    static const char zeros[BUNDLE_ALIGNMENT] = {0};
+    size_t pad = (align - w->file_pos % align) % align;
+    return write_bytes(w, zeros, pad);
+}
+
+
+// Appends a new entry to the manifest, with its name set. Returns NULL on failure.
+static BundleEntry* new_entry(BundleWriter* w, const char* name, BundleKind kind){
+    BundleEntry* entry_p;
+
+    if (strlen(name) >= BUNDLE_NAME_SIZE){
+        fprintf(stderr, "Dataset name \"%s\" is too long (max %d characters).\n", name, BUNDLE_NAME_SIZE - 1);
+        return NULL;
+    }
+
+    if (w->n_entries == w->entries_capacity){
+        size_t new_capacity = w->entries_capacity ? 2 * w->entries_capacity : 8;
+        BundleEntry* new_entries = (BundleEntry*) realloc(w->entries, new_capacity * sizeof(BundleEntry));
+        if (!new_entries){
+            fprintf(stderr, "Failed to allocate bundle manifest @ new_entry.\n");
+            return NULL;
+        }
+        retrack_memory(w->entries, new_entries, new_capacity * sizeof(BundleEntry));
+        w->entries = new_entries;
+        w->entries_capacity = new_capacity;
+    }
+
+    entry_p = &w->entries[w->n_entries];
+    memset(entry_p, 0, sizeof(BundleEntry));
+    strcpy(entry_p->name, name);
+    entry_p->kind = kind;
+    return entry_p;
+}
+
+
+// Size, in bytes, of the elements of the columns of a dataset.
+static size_t elem_size_of(const BundleEntry* entry_p){
+    return (entry_p->kind == BUNDLE_ILI) ? sizeof(int) : sizeof(double);
+}
+
+
+// Number of checksum blocks of each column of a dataset.
+static size_t blocks_per_column(const BundleEntry* entry_p, size_t block_size){
+    size_t n_bytes = entry_p->size * elem_size_of(entry_p);
+    return (n_bytes + block_size - 1) / block_size;
+}
+
+
+/*
+Writes the columns of a dataset (each aligned), followed by their block checksums, and sets the
+entry offsets. All columns have n_bytes bytes.
+*/
+static int write_columns(BundleWriter* w, BundleEntry* entry_p, const void* const* columns,
+    uint32_t n_columns, size_t n_bytes){
+    size_t n_blocks = blocks_per_column(entry_p, BUNDLE_BLOCK_SIZE);
+    uint32_t* checksums = (uint32_t*) malloc((n_columns * n_blocks + 1) * sizeof(uint32_t));
+    int status = EXIT_SUCCESS;
+
+    if (!checksums){
+        fprintf(stderr, "Failed to allocate block checksums @ write_columns.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t c = 0; c < n_columns && status == EXIT_SUCCESS; c++){
+        const unsigned char* data = (const unsigned char*) columns[c];
+        TraceSpan span = trace_begin("bundle", "checksum");
+
+        for (size_t b = 0; b < n_blocks; b++){
+            size_t start = b * BUNDLE_BLOCK_SIZE;
+            size_t size = (n_bytes - start < BUNDLE_BLOCK_SIZE) ? n_bytes - start : BUNDLE_BLOCK_SIZE;
+            checksums[c * n_blocks + b] = crc32c(data + start, size, 0);
+        }
+        trace_end_bytes(span, n_bytes);
+
+        span = trace_begin("bundle", "write");
+        status = write_padding(w, BUNDLE_ALIGNMENT);
+        entry_p->column_offset[entry_p->n_columns++] = w->file_pos;
+        if (status == EXIT_SUCCESS) status = write_bytes(w, data, n_bytes);
+        trace_end_bytes(span, n_bytes);
+    }
+
+    if (status == EXIT_SUCCESS) status = write_padding(w, sizeof(uint32_t));
+    entry_p->checksum_offset = w->file_pos;
+    if (status == EXIT_SUCCESS) status = write_bytes(w, checksums, n_columns * n_blocks * sizeof(uint32_t));
+
+    free(checksums);
+    return status;
+}
+
+
+static void free_bundle_writer(BundleWriter* w){
+    untrack_memory(w->entries);
+    free(w->entries); w->entries = NULL;
+    free(w->fname); w->fname = NULL;
+    w->n_entries = w->entries_capacity = 0;
+}
+
+
+/*
+Verifies blocks [first, end) of each column of a dataset against their stored checksums.
+Blocks already verified are skipped, unless recheck is set. The state of the blocks is accessed
+atomically, as views may be taken from several threads (a block may then be checked twice).
+*/
+static int check_blocks(const Bundle* b, const BundleEntry* entry_p, size_t first, size_t end,
+    int recheck){
+    const unsigned char* base = (const unsigned char*) b->map;
+    const uint32_t* checksums = (const uint32_t*) (base + entry_p->checksum_offset);
+    size_t block_size = b->header->block_size;
+    size_t n_bytes = entry_p->size * elem_size_of(entry_p);
+    size_t n_blocks = blocks_per_column(entry_p, block_size);
+    unsigned char* state = b->block_state + b->block_base[entry_p - b->entries];
+    TraceSpan span = trace_begin("bundle", "checksum");
+    uint64_t n_checked = 0;
+    int status = EXIT_SUCCESS;
+
+    for (uint32_t c = 0; c < entry_p->n_columns; c++){
+        const unsigned char* column = base + entry_p->column_offset[c];
+
+        for (size_t k = first; k < end; k++){
+            size_t i = c * n_blocks + k;
+            size_t start = k * block_size;
+            size_t size = (n_bytes - start < block_size) ? n_bytes - start : block_size;
+            unsigned char s = __atomic_load_n(&state[i], __ATOMIC_RELAXED);
+
+            if (s == BLOCK_UNVERIFIED || (recheck && s == BLOCK_VALID)){
+                s = (crc32c(column + start, size, 0) == checksums[i]) ? BLOCK_VALID : BLOCK_CORRUPTED;
+                __atomic_store_n(&state[i], s, __ATOMIC_RELAXED);
+                n_checked += size;
+            }
+            if (s == BLOCK_CORRUPTED){
+                fprintf(stderr, "Dataset \"%s\" of bundle is corrupted (column %u, bytes %zu to %zu).\n",
+                    entry_p->name, c, start, start + size);
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+    trace_end_bytes(span, n_checked);
+    return status;
+}
+
+
+/*
+Checks that rows [first_row, first_row + n_rows) are within a dataset and, with BUNDLE_VERIFY_LAZY,
+verifies the blocks holding them (once).
+*/
+static int verify_rows_on_access(const Bundle* b, const char* name, size_t first_row, size_t n_rows){
+    const BundleEntry* entry_p = find_bundle_entry(b, name);
+
+    if (first_row > entry_p->size || n_rows > entry_p->size - first_row){
+        fprintf(stderr, "Rows [%zu, %zu) are out of dataset \"%s\" (%zu rows).\n",
+            first_row, first_row + n_rows, entry_p->name, (size_t) entry_p->size);
+        return EXIT_FAILURE;
+    }
+    if (b->verify != BUNDLE_VERIFY_LAZY) return EXIT_SUCCESS;
+    return verify_bundle_rows(b, entry_p, first_row, n_rows);
+}
+
+
+// Checks that a region lies within the mapped file.
+static int in_bounds(const Bundle* b, uint64_t offset, uint64_t n_bytes){
+    return offset <= b->map_size && n_bytes <= b->map_size - offset;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// WRITING
+// ------------------------------------------------------------------------------------------------
+
+/*
+Creates a bundle file. Datasets are then added with add_bundle_* and the file is finalized with
+close_bundle_writer.
+
+@return An integer error code.
+*/
+int open_bundle_writer(BundleWriter* writer_p, const char* fname){
+    BundleHeader header = {};  // Placeholder, rewritten at close.
+
+    memset(writer_p, 0, sizeof(BundleWriter));
+
+    writer_p->fname = (char*) malloc(strlen(fname) + 1);
+    if (!writer_p->fname){
+        fprintf(stderr, "Failed to allocate bundle writer @ open_bundle_writer.\n");
+        return EXIT_FAILURE;
+    }
+    strcpy(writer_p->fname, fname);
+
+    writer_p->fp = fopen(fname, "wb");
+    if (!writer_p->fp) {
+        fprintf(stderr, "Failed to open %s: \"%s\"\n", fname, strerror(errno));
+        free_bundle_writer(writer_p);
+        return EXIT_FAILURE;
+    }
+
+    if (write_bytes(writer_p, &header, sizeof(BundleHeader))){
+        fclose(writer_p->fp);
+        free_bundle_writer(writer_p);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Adds an ILI dataset to the bundle.
+*/
+int add_bundle_ili(BundleWriter* writer_p, const char* name, ILIview view){
+    BundleEntry* entry_p = new_entry(writer_p, name, BUNDLE_ILI);
+    const void* columns[3] = {view.year, view.week, view.estInc};
+    size_t n_bytes = view.size * sizeof(int);
+
+    if (!entry_p) return EXIT_FAILURE;
+    entry_p->size = view.size;
+
+    if (write_columns(writer_p, entry_p, columns, 3, n_bytes)) return EXIT_FAILURE;
+
+    writer_p->n_entries++;
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Adds a vector of doubles (e.g. contacts or covariates) to the bundle.
+*/
+int add_bundle_double_vector(BundleWriter* writer_p, const char* name, DoubleView view){
+    BundleEntry* entry_p = new_entry(writer_p, name, BUNDLE_DOUBLE_VECTOR);
+    const void* columns[1] = {view.data};
+
+    if (!entry_p) return EXIT_FAILURE;
+    entry_p->size = view.size;
+
+    if (write_columns(writer_p, entry_p, columns, 1, view.size * sizeof(double))) return EXIT_FAILURE;
+
+    writer_p->n_entries++;
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Writes the provenance text and the manifest, finalizes the header and closes the file.
+The writer is freed even if an error occurs.
+
+@param writer_p  Pointer to an open BundleWriter.
+@param provenance  Free-form text describing the origin of the data (sources, dates, versions).
+    May be NULL.
+
+@return An integer error code.
+*/
+int close_bundle_writer(BundleWriter* writer_p, const char* provenance){
+    BundleHeader header = {};
+    size_t manifest_bytes = writer_p->n_entries * sizeof(BundleEntry);
+    int status = EXIT_SUCCESS;
+
+    if (!provenance) provenance = "";
+
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = BUNDLE_VERSION;
+    header.n_entries = (uint32_t) writer_p->n_entries;
+    header.provenance_offset = writer_p->file_pos;
+    header.provenance_size = strlen(provenance);
+    header.manifest_crc = crc32c(writer_p->entries, manifest_bytes, 0);
+    header.block_size = BUNDLE_BLOCK_SIZE;
+
+    if (write_bytes(writer_p, provenance, header.provenance_size + 1)
+        || write_padding(writer_p, sizeof(uint64_t))){
+        status = EXIT_FAILURE;
+    }
+    else{
+        header.entries_offset = writer_p->file_pos;
+        header.file_size = writer_p->file_pos + manifest_bytes;
+
+        if (write_bytes(writer_p, writer_p->entries, manifest_bytes)
+            || fseek(writer_p->fp, 0, SEEK_SET)
+            || fwrite(&header, sizeof(BundleHeader), 1, writer_p->fp) != 1){
+            fprintf(stderr, "Failed to finalize bundle %s.\n", writer_p->fname);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    if (fclose(writer_p->fp)){
+        fprintf(stderr, "Failed to close %s: \"%s\"\n", writer_p->fname, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    writer_p->fp = NULL;
+
+    free_bundle_writer(writer_p);
+    return status;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// READING
+// ------------------------------------------------------------------------------------------------
+
+/*
+Opens a bundle with a single memory mapping of the file and validates its structure.
+
+@param fname  Path for the bundle file. Must be a null-terminated string.
+@param bundle_p  Pointer to a Bundle struct, which is initialized.
+@param verify  When the block checksums of the datasets are verified: BUNDLE_VERIFY_EAGER checks
+    all of them now (reads the whole file), BUNDLE_VERIFY_LAZY checks each block the first time
+    a range of rows it holds is accessed (bundle_ili_rows, bundle_double_rows), and
+    BUNDLE_VERIFY_NONE only on request.
+
+@return An integer error code.
+*/
+int open_bundle(const char* fname, Bundle* bundle_p, BundleVerify verify){
+    TraceSpan span;
+    const BundleHeader* header;
+    struct stat st;
+    int fd;
+
+    memset(bundle_p, 0, sizeof(Bundle));
+
+    // --- File mapping
+    span = trace_begin("bundle", "map");
+    fd = open(fname, O_RDONLY);
+    if (fd < 0){
+        fprintf(stderr, "Failed to open %s: \"%s\"\n", fname, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (fstat(fd, &st) || (size_t) st.st_size < sizeof(BundleHeader)){
+        fprintf(stderr, "File %s is not a valid bundle (too small).\n", fname);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    bundle_p->map_size = (size_t) st.st_size;
+    bundle_p->map = mmap(NULL, bundle_p->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping remains valid.
+    if (bundle_p->map == MAP_FAILED){
+        fprintf(stderr, "Failed to map %s: \"%s\"\n", fname, strerror(errno));
+        bundle_p->map = NULL;
+        return EXIT_FAILURE;
+    }
+    track_memory(bundle_p->map, bundle_p->map_size, MEMORY_MMAP);
+    trace_end_bytes(span, bundle_p->map_size);
+
+    // --- Structure validation
+    header = (const BundleHeader*) bundle_p->map;
+    bundle_p->header = header;
+    bundle_p->entries = (const BundleEntry*) ((const char*) bundle_p->map + header->entries_offset);
+
+    if (memcmp(header->magic, BUNDLE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != BUNDLE_VERSION
+        || header->block_size == 0
+        || header->file_size != bundle_p->map_size
+        || header->entries_offset % sizeof(uint64_t) != 0
+        || !in_bounds(bundle_p, header->entries_offset, (uint64_t) header->n_entries * sizeof(BundleEntry))
+        || header->provenance_size >= bundle_p->map_size
+        || !in_bounds(bundle_p, header->provenance_offset, header->provenance_size + 1)
+        || bundle_provenance(bundle_p)[header->provenance_size] != '\0'){
+        fprintf(stderr, "File %s is not a valid bundle (bad header).\n", fname);
+        close_bundle(bundle_p);
+        return EXIT_FAILURE;
+    }
+
+    if (crc32c(bundle_p->entries, header->n_entries * sizeof(BundleEntry), 0) != header->manifest_crc){
+        fprintf(stderr, "Manifest of bundle %s is corrupted (checksum mismatch).\n", fname);
+        close_bundle(bundle_p);
+        return EXIT_FAILURE;
+    }
+
+    // --- Datasets and their block checksums
+    bundle_p->block_base = (size_t*) malloc((header->n_entries + 1) * sizeof(size_t));
+    if (!bundle_p->block_base){
+        fprintf(stderr, "Failed to allocate bundle blocks @ open_bundle.\n");
+        close_bundle(bundle_p);
+        return EXIT_FAILURE;
+    }
+    bundle_p->block_base[0] = 0;
+
+    for (uint32_t i = 0; i < header->n_entries; i++){
+        const BundleEntry* entry_p = &bundle_p->entries[i];
+        size_t elem_size = elem_size_of(entry_p);
+        size_t n_blocks = 0;
+        int valid = (entry_p->kind == BUNDLE_ILI && entry_p->n_columns == 3)
+            || (entry_p->kind == BUNDLE_DOUBLE_VECTOR && entry_p->n_columns == 1);
+
+        for (uint32_t c = 0; valid && c < entry_p->n_columns; c++){
+            valid = entry_p->column_offset[c] % BUNDLE_ALIGNMENT == 0
+                && entry_p->size <= bundle_p->map_size / elem_size
+                && in_bounds(bundle_p, entry_p->column_offset[c], entry_p->size * elem_size);
+        }
+        if (valid){
+            n_blocks = entry_p->n_columns * blocks_per_column(entry_p, header->block_size);
+            valid = entry_p->checksum_offset % sizeof(uint32_t) == 0
+                && in_bounds(bundle_p, entry_p->checksum_offset, n_blocks * sizeof(uint32_t));
+        }
+        if (!valid || memchr(entry_p->name, '\0', BUNDLE_NAME_SIZE) == NULL){
+            fprintf(stderr, "Dataset %u of bundle %s is invalid.\n", i, fname);
+            close_bundle(bundle_p);
+            return EXIT_FAILURE;
+        }
+        bundle_p->block_base[i + 1] = bundle_p->block_base[i] + n_blocks;
+    }
+
+    bundle_p->block_state = (unsigned char*) calloc(bundle_p->block_base[header->n_entries] + 1, 1);
+    if (!bundle_p->block_state){
+        fprintf(stderr, "Failed to allocate bundle blocks @ open_bundle.\n");
+        close_bundle(bundle_p);
+        return EXIT_FAILURE;
+    }
+    bundle_p->verify = verify;
+
+    if (verify == BUNDLE_VERIFY_EAGER && verify_bundle(bundle_p)){
+        fprintf(stderr, "Bundle %s failed verification.\n", fname);
+        close_bundle(bundle_p);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Unmaps the bundle. Views obtained from it become invalid.
+*/
+void close_bundle(Bundle* bundle_p){
+    untrack_memory(bundle_p->map);
+    if (bundle_p->map) munmap(bundle_p->map, bundle_p->map_size);
+    free(bundle_p->block_base);
+    free(bundle_p->block_state);
+    memset(bundle_p, 0, sizeof(Bundle));
+}
+
+
+/*
+Recomputes the checksum of every block of every dataset and compares it with the one stored.
+
+@return An integer error code (failure if any dataset is corrupted).
+*/
+int verify_bundle(const Bundle* bundle_p){
+    int status = EXIT_SUCCESS;
+
+    for (uint32_t i = 0; i < bundle_p->header->n_entries; i++){
+        const BundleEntry* entry_p = &bundle_p->entries[i];
+        size_t n_blocks = blocks_per_column(entry_p, bundle_p->header->block_size);
+
+        if (check_blocks(bundle_p, entry_p, 0, n_blocks, 1)) status = EXIT_FAILURE;
+    }
+    return status;
+}
+
+
+/*
+Verifies the blocks that hold rows [first_row, first_row + n_rows) of each column of a dataset,
+unless already verified. Meant for the first access to a range of a large dataset.
+
+@return An integer error code (failure if any of the blocks is corrupted).
+*/
+int verify_bundle_rows(const Bundle* bundle_p, const BundleEntry* entry_p, size_t first_row,
+    size_t n_rows){
+    size_t elem_size = elem_size_of(entry_p);
+    size_t block_size = bundle_p->header->block_size;
+
+    if (first_row > entry_p->size || n_rows > entry_p->size - first_row){
+        fprintf(stderr, "Rows [%zu, %zu) are out of dataset \"%s\" (%zu rows).\n",
+            first_row, first_row + n_rows, entry_p->name, (size_t) entry_p->size);
+        return EXIT_FAILURE;
+    }
+    if (n_rows == 0) return EXIT_SUCCESS;
+
+    return check_blocks(bundle_p, entry_p, first_row * elem_size / block_size,
+        ((first_row + n_rows) * elem_size - 1) / block_size + 1, 0);
+}
+
+
+/*
+Returns the manifest entry of a dataset, or NULL if there is no dataset with the given name.
+*/
+const BundleEntry* find_bundle_entry(const Bundle* bundle_p, const char* name){
+    for (uint32_t i = 0; i < bundle_p->header->n_entries; i++){
+        if (strcmp(bundle_p->entries[i].name, name) == 0) return &bundle_p->entries[i];
+    }
+    return NULL;
+}
+
+
+/*
+Gives a read-only view of an ILI dataset of the bundle. Valid until close_bundle.
+No checksums are verified: with BUNDLE_VERIFY_LAZY, the rows must be accessed through
+bundle_ili_rows (or checked with verify_bundle_rows) before they are read.
+
+@return An integer error code.
+*/
+int bundle_ili_view(const Bundle* bundle_p, const char* name, ILIview* view_p){
+    const BundleEntry* entry_p = find_bundle_entry(bundle_p, name);
+    const char* base = (const char*) bundle_p->map;
+
+    if (!entry_p || entry_p->kind != BUNDLE_ILI){
+        fprintf(stderr, "Bundle has no ILI dataset named \"%s\".\n", name);
+        return EXIT_FAILURE;
+    }
+
+    view_p->size = entry_p->size;
+    view_p->year = (const int*) (base + entry_p->column_offset[0]);
+    view_p->week = (const int*) (base + entry_p->column_offset[1]);
+    view_p->estInc = (const int*) (base + entry_p->column_offset[2]);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Gives a read-only view of rows [first_row, first_row + n_rows) of an ILI dataset of the bundle.
+Valid until close_bundle. If the bundle was opened with BUNDLE_VERIFY_LAZY, the blocks holding the
+rows are verified, unless already verified by an earlier access.
+
+@return An integer error code (failure if the rows are out of range or corrupted).
+*/
+int bundle_ili_rows(const Bundle* bundle_p, const char* name, size_t first_row, size_t n_rows,
+    ILIview* view_p){
+    ILIview full;
+
+    if (bundle_ili_view(bundle_p, name, &full)) return EXIT_FAILURE;
+    if (verify_rows_on_access(bundle_p, name, first_row, n_rows)) return EXIT_FAILURE;
+
+    view_p->size = n_rows;
+    view_p->year = full.year + first_row;
+    view_p->week = full.week + first_row;
+    view_p->estInc = full.estInc + first_row;
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Gives a read-only view of a double vector dataset of the bundle. Valid until close_bundle.
+No checksums are verified: with BUNDLE_VERIFY_LAZY, the rows must be accessed through
+bundle_double_rows (or checked with verify_bundle_rows) before they are read.
+
+@return An integer error code.
+*/
+int bundle_double_view(const Bundle* bundle_p, const char* name, DoubleView* view_p){
+    const BundleEntry* entry_p = find_bundle_entry(bundle_p, name);
+
+    if (!entry_p || entry_p->kind != BUNDLE_DOUBLE_VECTOR){
+        fprintf(stderr, "Bundle has no double vector dataset named \"%s\".\n", name);
+        return EXIT_FAILURE;
+    }
+
+    view_p->size = entry_p->size;
+    view_p->data = (const double*) ((const char*) bundle_p->map + entry_p->column_offset[0]);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Gives a read-only view of rows [first_row, first_row + n_rows) of a double vector dataset of the
+bundle (see bundle_ili_rows).
+
+@return An integer error code (failure if the rows are out of range or corrupted).
+*/
+int bundle_double_rows(const Bundle* bundle_p, const char* name, size_t first_row, size_t n_rows,
+    DoubleView* view_p){
+    DoubleView full;
+
+    if (bundle_double_view(bundle_p, name, &full)) return EXIT_FAILURE;
+    if (verify_rows_on_access(bundle_p, name, first_row, n_rows)) return EXIT_FAILURE;
+
+    view_p->size = n_rows;
+    view_p->data = full.data + first_row;
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Returns the provenance text of the bundle (null-terminated).
+*/
+const char* bundle_provenance(const Bundle* bundle_p){
+    return (const char*) bundle_p->map + bundle_p->header->provenance_offset;
+}
+
+
+/*
+Returns the memory held by the mapping of a bundle. Only the pages read so far (or prefetched by
+the system) are resident.
+*/
+MemoryUsage bundle_memory(const Bundle* bundle_p){
+    return region_memory(bundle_p->map, bundle_p->map_size, MEMORY_MMAP);
+}
+
+
+/*
+Returns the memory held by a bundle writer (heap; the manifest). Column data is written as added.
+*/
+MemoryUsage bundle_writer_memory(const BundleWriter* writer_p){
+    MemoryUsage usage = region_memory(writer_p->entries, writer_p->entries_capacity * sizeof(BundleEntry),
+        MEMORY_HEAP);
+    usage.resident = writer_p->n_entries * sizeof(BundleEntry);
+    return usage;
+}
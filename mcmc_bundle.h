@@ -0,0 +1,103 @@
+#ifndef MCMC_BUNDLE_H
+#define MCMC_BUNDLE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mcmc_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BUNDLE_MAGIC "MCMCBNDL"
+#define BUNDLE_VERSION 2
+#define BUNDLE_NAME_SIZE 48       // Maximum size of a dataset name, including the null terminator.
+#define BUNDLE_MAX_COLUMNS 3      // Maximum number of columns in a dataset.
+#define BUNDLE_ALIGNMENT 64       // Alignment, in bytes, of each column in the file.
+#define BUNDLE_BLOCK_SIZE 262144  // Size, in bytes, of the blocks of column data with a checksum.
+
+// Kind of data held by a dataset of the bundle.
+typedef enum {
+    BUNDLE_ILI = 1,            // ILI data (int32 columns year, week, estInc).
+    BUNDLE_DOUBLE_VECTOR = 2   // Vector of doubles (e.g. contacts or covariates).
+} BundleKind;
+
+// When the checksums of the column data are verified.
+typedef enum {
+    BUNDLE_VERIFY_NONE = 0,   // Only on request (verify_bundle, verify_bundle_rows).
+    BUNDLE_VERIFY_EAGER = 1,  // All datasets, when the bundle is opened (reads the whole file).
+    BUNDLE_VERIFY_LAZY = 2    // Each block the first time its rows are accessed (bundle_*_rows).
+} BundleVerify;
+
+// File header, at offset 0. All values are in native (little-endian) byte order.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_entries;          // Number of datasets.
+    uint64_t entries_offset;     // Offset of the manifest (array of BundleEntry).
+    uint64_t provenance_offset;  // Offset of the provenance text (null-terminated).
+    uint64_t provenance_size;    // Size of the provenance text, excluding the null terminator.
+    uint64_t file_size;
+    uint32_t manifest_crc;       // CRC32C of the manifest.
+    uint32_t block_size;         // Bytes of column data covered by each block checksum.
+    uint64_t reserved;
+} BundleHeader;
+
+// Manifest entry describing one dataset.
+typedef struct {
+    char name[BUNDLE_NAME_SIZE];
+    uint32_t kind;               // BundleKind
+    uint32_t n_columns;
+    uint64_t size;               // Number of rows.
+    uint64_t column_offset[BUNDLE_MAX_COLUMNS];
+    uint64_t checksum_offset;    // Offset of the CRC32C of each block, column after column (uint32_t).
+} BundleEntry;
+
+// Bundle being written.
+typedef struct {
+    FILE* fp;
+    char* fname;
+    uint64_t file_pos;
+    BundleEntry* entries;
+    size_t n_entries;
+    size_t entries_capacity;
+} BundleWriter;
+
+// Bundle opened for reading. The whole file is memory-mapped.
+typedef struct {
+    void* map;
+    size_t map_size;
+    const BundleHeader* header;
+    const BundleEntry* entries;
+    BundleVerify verify;
+    size_t* block_base;           // Index, in block_state, of the first block of each dataset.
+    unsigned char* block_state;   // Verification state of each block (per column).
+} Bundle;
+
+int open_bundle_writer(BundleWriter* writer_p, const char* fname);
+int add_bundle_ili(BundleWriter* writer_p, const char* name, ILIview view);
+int add_bundle_double_vector(BundleWriter* writer_p, const char* name, DoubleView view);
+int close_bundle_writer(BundleWriter* writer_p, const char* provenance);
+MemoryUsage bundle_writer_memory(const BundleWriter* writer_p);
+
+int open_bundle(const char* fname, Bundle* bundle_p, BundleVerify verify);
+void close_bundle(Bundle* bundle_p);
+int verify_bundle(const Bundle* bundle_p);
+int verify_bundle_rows(const Bundle* bundle_p, const BundleEntry* entry_p, size_t first_row,
+    size_t n_rows);
+const BundleEntry* find_bundle_entry(const Bundle* bundle_p, const char* name);
+int bundle_ili_view(const Bundle* bundle_p, const char* name, ILIview* view_p);
+int bundle_ili_rows(const Bundle* bundle_p, const char* name, size_t first_row, size_t n_rows,
+    ILIview* view_p);
+int bundle_double_view(const Bundle* bundle_p, const char* name, DoubleView* view_p);
+int bundle_double_rows(const Bundle* bundle_p, const char* name, size_t first_row, size_t n_rows,
+    DoubleView* view_p);
+const char* bundle_provenance(const Bundle* bundle_p);
+MemoryUsage bundle_memory(const Bundle* bundle_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,129 @@
+/*
+Tool that packs csv inputs into a single bundle file (see mcmc_bundle.h).
+
+Usage:
+    mcmc_bundle_gen <output.bundle> <kind>:<name>=<file.csv> [<kind>:<name>=<file.csv> ...]
+
+where <kind> is "ili" (read with read_ili_csv) or "vector" (read with read_csv_double_vector).
+The provenance of the bundle records the creation time and the path, size and modification time
+of each source file.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "mcmc_io.h"
+#include "mcmc_bundle.h"
+
+#define PROVENANCE_LINE_SIZE 1024  // Maximum size of each line of the provenance text.
+
+
+// Appends a formatted line to the provenance text. Returns nonzero on allocation failure.
+static int append_provenance(char* *text_p, size_t* len_p, const char* line){
+    size_t n = strlen(line);
+    char* new_text = (char*) realloc(*text_p, *len_p + n + 1);
+
+    if (!new_text) return 1;
+    memcpy(new_text + *len_p, line, n + 1);
+    *text_p = new_text;
+    *len_p += n;
+    return 0;
+}
+
+
+// Reads one csv input and adds it to the bundle.
+static int add_dataset(BundleWriter* writer_p, const char* kind, const char* name, const char* fname){
+    if (strcmp(kind, "ili") == 0){
+        ILIinput data = {};
+        int status;
+
+        if (read_ili_csv(fname, &data)){
+            free_ili_input(&data);
+            return EXIT_FAILURE;
+        }
+        status = add_bundle_ili(writer_p, name, ili_view(&data));
+        free_ili_input(&data);
+        return status;
+    }
+    else if (strcmp(kind, "vector") == 0){
+        double* vec = NULL;
+        size_t size = 0;
+        int status;
+
+        if (read_csv_double_vector(fname, &vec, &size)){
+            free_csv_vector(vec);
+            return EXIT_FAILURE;
+        }
+        status = add_bundle_double_vector(writer_p, name, double_view(vec, size));
+        free_csv_vector(vec);
+        return status;
+    }
+
+    fprintf(stderr, "Unknown dataset kind \"%s\" (expected \"ili\" or \"vector\").\n", kind);
+    return EXIT_FAILURE;
+}
+
+
+int main(int argc, char *argv[])
+{
+    BundleWriter writer;
+    char line[PROVENANCE_LINE_SIZE];
+    char time_str[64];
+    char* provenance = NULL;
+    size_t provenance_len = 0;
+    time_t now = time(NULL);
+    int status = EXIT_SUCCESS;
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <output.bundle> <kind>:<name>=<file.csv> [...]\n"
+            "  kind: \"ili\" or \"vector\"\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (open_bundle_writer(&writer, argv[1])) return EXIT_FAILURE;
+
+    strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    snprintf(line, sizeof(line), "created: %s by mcmc_bundle_gen\n", time_str);
+    status = append_provenance(&provenance, &provenance_len, line);
+
+    // Datasets. Each argument has the form kind:name=path, and is split in place.
+    for (int i = 2; i < argc && status == EXIT_SUCCESS; i++){
+        char* kind = argv[i];
+        char* name = strchr(kind, ':');
+        char* fname = name ? strchr(name, '=') : NULL;
+        struct stat st;
+
+        if (!name || !fname){
+            fprintf(stderr, "Invalid input \"%s\" (expected <kind>:<name>=<file.csv>).\n", kind);
+            status = EXIT_FAILURE;
+            break;
+        }
+        *name++ = '\0';
+        *fname++ = '\0';
+
+        status = add_dataset(&writer, kind, name, fname);
+        if (status) break;
+
+        if (stat(fname, &st) == 0){
+            strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S%z", localtime(&st.st_mtime));
+            snprintf(line, sizeof(line), "dataset: %s (%s) from %s, %lld bytes, modified %s\n",
+                name, kind, fname, (long long) st.st_size, time_str);
+        }
+        else{
+            snprintf(line, sizeof(line), "dataset: %s (%s) from %s\n", name, kind, fname);
+        }
+        status = append_provenance(&provenance, &provenance_len, line);
+    }
+
+    if (close_bundle_writer(&writer, provenance) || status){
+        fprintf(stderr, "Failed to generate %s.\n", argv[1]);
+        remove(argv[1]);
+        status = EXIT_FAILURE;
+    }
+
+    free(provenance);
+    return status;
+}
@@ -0,0 +1,401 @@
+/*
+In-process parse cache in front of the csv readers.
+
+Repeated loads of the same file (e.g. once per chain or per cross-validation fold) return a shared,
+read-only view of the data parsed the first time. A cached file is considered unchanged if its
+device, inode, size and modification time are the same. If only the metadata changed (e.g. the file
+was touched or copied over with the same content), the content hash of the file is recomputed and,
+if equal, the cached data is still used.
+
+Entries are reference counted: the views stay valid until cache_release, even if the entry is
+evicted or invalidated meanwhile. Unreferenced entries are evicted in least-recently-used order
+when the cached data exceeds the memory limit (set_cache_limit).
+All functions are thread-safe. Files are parsed outside the cache lock.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "mcmc_cache.h"
+#include "mcmc_async.h"
+#include "mcmc_checksum.h"
+
+#define CACHE_N_BUCKETS 64          // Number of buckets of the hash table (chained).
+#define CACHE_HASH_BUF_SIZE 65536   // Size, in bytes, of the chunks read to hash a file.
+
+
+// Identity of a file on disk.
+typedef struct FileIdentity{
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+} FileIdentity;
+
+struct CacheEntry{
+    char* fname;
+    LoadKind kind;
+    uint64_t key_hash;
+    FileIdentity identity;
+    uint64_t content_hash;
+
+    // Data
+    ILIinput ili;
+    double* vec;
+    size_t vsize;
+    size_t bytes;
+
+    int refcount;
+    int in_table;          // Whether the entry is still in the hash table (not evicted or stale).
+    CacheEntry* next;      // Next entry in the bucket.
+    CacheEntry* lru_prev;  // Towards the most recently used entry.
+    CacheEntry* lru_next;  // Towards the least recently used entry.
+};
+
+// The process-wide cache.
+static struct {
+    pthread_mutex_t mutex;
+    CacheEntry* buckets[CACHE_N_BUCKETS];
+    CacheEntry* lru_head;  // Most recently used.
+    CacheEntry* lru_tail;  // Least recently used.
+    CacheStats stats;
+    size_t detached_bytes;  // Bytes of entries removed from the table, but still referenced.
+} cache = {PTHREAD_MUTEX_INITIALIZER, {NULL}, NULL, NULL, {0, 0, CACHE_DEFAULT_LIMIT, 0, 0, 0, 0}, 0};
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+static uint64_t key_hash(const char* fname, LoadKind kind){
+    return crc32c(fname, strlen(fname), crc32c(&kind, sizeof(kind), 0));
+}
+
+
+static int stat_identity(const char* fname, FileIdentity* id_p){
+    struct stat st;
+
+    if (stat(fname, &st)) return EXIT_FAILURE;
+    memset(id_p, 0, sizeof(FileIdentity));
+    id_p->dev = st.st_dev;
+    id_p->ino = st.st_ino;
+    id_p->size = st.st_size;
+    id_p->mtime = st.st_mtim;
+    return EXIT_SUCCESS;
+}
+
+
+static int same_identity(const FileIdentity* a, const FileIdentity* b){
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size
+        && a->mtime.tv_sec == b->mtime.tv_sec && a->mtime.tv_nsec == b->mtime.tv_nsec;
+}
+
+
+// Content hash of a file from its CRC32C, with bit 32 set, so that an empty file does not give 0.
+static uint64_t content_hash_of(uint32_t crc){
+    return ((uint64_t) 1 << 32) | crc;
+}
+
+
+// Hashes the content of a file (see content_hash_of). Returns 0 if it cannot be read.
+static uint64_t hash_file(const char* fname){
+    char* buf = (char*) malloc(CACHE_HASH_BUF_SIZE);
+    FILE* fp = fopen(fname, "rb");
+    uint32_t crc = 0;
+    uint64_t hash;
+    size_t bytes_read;
+
+    if (!buf || !fp){
+        free(buf);
+        if (fp) fclose(fp);
+        return 0;
+    }
+    while ((bytes_read = fread(buf, 1, CACHE_HASH_BUF_SIZE, fp)) > 0){
+        crc = crc32c(buf, bytes_read, crc);
+    }
+    hash = ferror(fp) ? 0 : content_hash_of(crc);
+
+    fclose(fp);
+    free(buf);
+    return hash;
+}
+
+
+static void free_entry(CacheEntry* e){
+    free_ili_input(&e->ili);
+    free_csv_vector(e->vec);
+    free(e->fname);
+    free(e);
+}
+
+
+// LRU list operations. Must be called with the cache lock held.
+static void lru_unlink(CacheEntry* e){
+    if (e->lru_prev) e->lru_prev->lru_next = e->lru_next;
+    else cache.lru_head = e->lru_next;
+    if (e->lru_next) e->lru_next->lru_prev = e->lru_prev;
+    else cache.lru_tail = e->lru_prev;
+    e->lru_prev = e->lru_next = NULL;
+}
+
+
+static void lru_push_front(CacheEntry* e){
+    e->lru_prev = NULL;
+    e->lru_next = cache.lru_head;
+    if (cache.lru_head) cache.lru_head->lru_prev = e;
+    cache.lru_head = e;
+    if (!cache.lru_tail) cache.lru_tail = e;
+}
+
+
+// Removes an entry from the table and LRU list. It is freed now or at its last release.
+// Must be called with the cache lock held.
+static void remove_entry(CacheEntry* e){
+    CacheEntry* *link = &cache.buckets[e->key_hash % CACHE_N_BUCKETS];
+
+    while (*link != e) link = &(*link)->next;
+    *link = e->next;
+    lru_unlink(e);
+
+    e->in_table = 0;
+    cache.stats.n_entries--;
+    cache.stats.bytes -= e->bytes;
+    if (e->refcount == 0) free_entry(e);
+    else cache.detached_bytes += e->bytes;
+}
+
+
+// Evicts unreferenced entries, least recently used first, until within the limit.
+// Must be called with the cache lock held.
+static void evict_to_limit(void){
+    CacheEntry* e = cache.lru_tail;
+
+    while (e && cache.stats.bytes > cache.stats.limit){
+        CacheEntry* prev = e->lru_prev;
+        if (e->refcount == 0){
+            remove_entry(e);
+            cache.stats.evictions++;
+        }
+        e = prev;
+    }
+}
+
+
+// Must be called with the cache lock held.
+static CacheEntry* find_entry(const char* fname, LoadKind kind, uint64_t hash){
+    for (CacheEntry* e = cache.buckets[hash % CACHE_N_BUCKETS]; e; e = e->next){
+        if (e->key_hash == hash && e->kind == kind && strcmp(e->fname, fname) == 0) return e;
+    }
+    return NULL;
+}
+
+
+// Takes a reference to an entry in the table and marks it as most recently used.
+// Must be called with the cache lock held.
+static CacheEntry* acquire_entry(CacheEntry* e){
+    e->refcount++;
+    lru_unlink(e);
+    lru_push_front(e);
+    return e;
+}
+
+
+// Parses a file into a new (unlinked) entry. The content hash is computed as the file is parsed.
+static CacheEntry* parse_entry(const char* fname, LoadKind kind, uint64_t hash, const FileIdentity* id_p){
+    CacheEntry* e = (CacheEntry*) calloc(1, sizeof(CacheEntry));
+    uint32_t crc = 0;
+    int status;
+
+    if (!e || !(e->fname = (char*) malloc(strlen(fname) + 1))){
+        fprintf(stderr, "Failed to allocate cache entry for %s.\n", fname);
+        free(e);
+        return NULL;
+    }
+    strcpy(e->fname, fname);
+    e->kind = kind;
+    e->key_hash = hash;
+    e->identity = *id_p;
+
+    if (kind == LOAD_ILI_CSV){
+        status = read_ili_csv_crc(fname, &e->ili, &crc);
+        e->bytes = 3 * e->ili.size * sizeof(int);
+    }
+    else{
+        status = read_csv_double_vector_crc(fname, &e->vec, &e->vsize, &crc);
+        e->bytes = e->vsize * sizeof(double);
+    }
+    e->content_hash = content_hash_of(crc);
+
+    if (status){
+        free_entry(e);
+        return NULL;
+    }
+    return e;  // The data is registered in the memory registry by the readers.
+}
+
+
+// Returns a referenced entry for the file, parsing it if not cached or changed.
+static CacheEntry* cache_get(const char* fname, LoadKind kind){
+    uint64_t hash = key_hash(fname, kind);
+    FileIdentity id;
+    CacheEntry *e, *fresh;
+    uint64_t content_hash = 0;
+
+    if (stat_identity(fname, &id)){
+        fprintf(stderr, "Failed to open %s: \"%s\"\n", fname, strerror(errno));
+        return NULL;
+    }
+
+    // --- Lookup
+    pthread_mutex_lock(&cache.mutex);
+    e = find_entry(fname, kind, hash);
+    if (e && same_identity(&e->identity, &id)){
+        cache.stats.hits++;
+        acquire_entry(e);
+        pthread_mutex_unlock(&cache.mutex);
+        return e;
+    }
+    if (e) content_hash = e->content_hash;
+    pthread_mutex_unlock(&cache.mutex);
+
+    // --- Metadata changed: the content may still be the same
+    if (content_hash && hash_file(fname) == content_hash){
+        pthread_mutex_lock(&cache.mutex);
+        e = find_entry(fname, kind, hash);
+        if (e && e->content_hash == content_hash){
+            e->identity = id;
+            cache.stats.rehash_hits++;
+            acquire_entry(e);
+            pthread_mutex_unlock(&cache.mutex);
+            return e;
+        }
+        pthread_mutex_unlock(&cache.mutex);
+    }
+
+    // --- Miss: parse outside the lock, then insert
+    fresh = parse_entry(fname, kind, hash, &id);
+    if (!fresh) return NULL;
+
+    pthread_mutex_lock(&cache.mutex);
+    cache.stats.misses++;
+    e = find_entry(fname, kind, hash);
+    if (e) remove_entry(e);  // Stale, or inserted concurrently: the freshest parse wins.
+
+    fresh->in_table = 1;
+    fresh->next = cache.buckets[hash % CACHE_N_BUCKETS];
+    cache.buckets[hash % CACHE_N_BUCKETS] = fresh;
+    lru_push_front(fresh);
+    cache.stats.n_entries++;
+    cache.stats.bytes += fresh->bytes;
+    acquire_entry(fresh);
+    evict_to_limit();
+    pthread_mutex_unlock(&cache.mutex);
+
+    return fresh;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Reads an ILI csv file through the parse cache.
+
+@param fname  Path for the csv file. Must be a null-terminated string.
+@param view_p  Pointer to an ILIview, set to the (shared, read-only) cached data.
+@param entry_pp  Set to the cache entry, which must be released with cache_release when the
+    view is no longer used.
+
+@return An integer error code.
+*/
+int cache_read_ili_csv(const char* fname, ILIview* view_p, CacheEntry* *entry_pp){
+    CacheEntry* e = cache_get(fname, LOAD_ILI_CSV);
+
+    *entry_pp = e;
+    if (!e) return EXIT_FAILURE;
+
+    *view_p = ili_view(&e->ili);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Reads a csv file of doubles through the parse cache. See cache_read_ili_csv.
+*/
+int cache_read_double_vector(const char* fname, DoubleView* view_p, CacheEntry* *entry_pp){
+    CacheEntry* e = cache_get(fname, LOAD_DOUBLE_VECTOR);
+
+    *entry_pp = e;
+    if (!e) return EXIT_FAILURE;
+
+    *view_p = double_view(e->vec, e->vsize);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Releases a reference to a cache entry. Views obtained with it must not be used afterwards.
+*/
+void cache_release(CacheEntry* entry_p){
+    if (!entry_p) return;
+
+    pthread_mutex_lock(&cache.mutex);
+    entry_p->refcount--;
+    if (entry_p->refcount == 0){
+        if (!entry_p->in_table){
+            cache.detached_bytes -= entry_p->bytes;
+            free_entry(entry_p);
+        }
+        else evict_to_limit();
+    }
+    pthread_mutex_unlock(&cache.mutex);
+}
+
+
+/*
+Sets the maximum number of bytes of cached data, evicting unreferenced entries if needed.
+*/
+void set_cache_limit(size_t max_bytes){
+    pthread_mutex_lock(&cache.mutex);
+    cache.stats.limit = max_bytes;
+    evict_to_limit();
+    pthread_mutex_unlock(&cache.mutex);
+}
+
+
+/*
+Removes all entries from the cache. Entries still referenced are freed at their last release.
+*/
+void clear_cache(void){
+    pthread_mutex_lock(&cache.mutex);
+    while (cache.lru_head) remove_entry(cache.lru_head);
+    pthread_mutex_unlock(&cache.mutex);
+}
+
+
+CacheStats get_cache_stats(void){
+    CacheStats stats;
+
+    pthread_mutex_lock(&cache.mutex);
+    stats = cache.stats;
+    pthread_mutex_unlock(&cache.mutex);
+    return stats;
+}
+
+
+/*
+Returns the memory held by the cached data (heap), including entries evicted but still referenced.
+*/
+MemoryUsage cache_memory(void){
+    MemoryUsage usage = {0, 0, MEMORY_HEAP};
+
+    pthread_mutex_lock(&cache.mutex);
+    usage.resident = usage.capacity = cache.stats.bytes + cache.detached_bytes;
+    pthread_mutex_unlock(&cache.mutex);
+    return usage;
+}
@@ -0,0 +1,41 @@
+#ifndef MCMC_CACHE_H
+#define MCMC_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "mcmc_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CACHE_DEFAULT_LIMIT ((size_t) 256 << 20)  // Default memory limit of the cache, in bytes.
+
+// Entry of the parse cache. Opaque; holds one reference to the cached data.
+typedef struct CacheEntry CacheEntry;
+
+// Counters of the parse cache.
+typedef struct {
+    size_t n_entries;
+    size_t bytes;        // Bytes held by cached data.
+    size_t limit;
+    uint64_t hits;
+    uint64_t rehash_hits; // Hits after the file metadata changed but its content did not.
+    uint64_t misses;
+    uint64_t evictions;
+} CacheStats;
+
+int cache_read_ili_csv(const char* fname, ILIview* view_p, CacheEntry* *entry_pp);
+int cache_read_double_vector(const char* fname, DoubleView* view_p, CacheEntry* *entry_pp);
+void cache_release(CacheEntry* entry_p);
+
+void set_cache_limit(size_t max_bytes);
+void clear_cache(void);
+CacheStats get_cache_stats(void);
+MemoryUsage cache_memory(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1362 @@
+/*
+Output of MCMC chain samples in the Arrow IPC file format.
+
+The files can be opened (and memory-mapped) directly by pyarrow, polars, R arrow, etc.
+The format is self-implemented: the flatbuffer metadata is encoded by a small builder below, so
+there is no dependency on libarrow or on the flatbuffers library.
+
+File layout (see https://arrow.apache.org/docs/format/Columnar.html#ipc-file-format):
+    "ARROW1" + padding | Schema message | RecordBatch messages ... | EOS | Footer | footer size | "ARROW1"
+
+Each message is: 0xFFFFFFFF | int32 metadata size | flatbuffer Message (padded to 8 bytes) | body.
+All values are written in the native byte order, which is declared as little-endian.
+
+Several chains running as threads of one process can also write a single file (SharedChainFile),
+each through its own buffered ChainStream. Each record batch then holds the samples of one chain,
+with an extra "chain" column; the space for a batch is reserved with an atomic increment of the
+file end and written with pwrite, so the threads never contend for the file. The footer, written
+at the end, lists the batches ordered by chain and iteration, and its metadata holds the chunk
+index (chain and iteration range of each batch).
+
+The latest samples can also be mirrored into a shared-memory ring (mirror_chain_writer), so that a
+running chain can be monitored from another process without flushing or parsing the output, and
+a downsample of the whole chain can be kept in a small sidecar for trace plots
+(downsample_chain_writer, or downsample_chain_stream for each chain of a shared file).
+*/
+
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+#include "mcmc_chain.h"
+#include "mcmc_trace.h"
+#include "mcmc_metrics.h"
+
+#define ARROW_MAGIC "ARROW1"
+#define ARROW_CONTINUATION 0xFFFFFFFFu
+#define ARROW_METADATA_V5 4
+
+// Identifiers of the flatbuffer unions of the Arrow schema (Schema.fbs and Message.fbs).
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_RECORD_BATCH 3
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_FLOATING_POINT 3
+#define ARROW_PRECISION_DOUBLE 2
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024  // As on Linux and the BSDs.
+#endif
+#define PAD8(n) (((n) + 7) & ~(size_t) 7)
+
+#define FB_MAX_FIELDS 8  // Maximum number of fields in a flatbuffer table built here.
+#define FB_INIT_CAPACITY 1024
+
+
+// ------------------------------------------------------------------------------------------------
+// FLATBUFFER BUILDER
+// ------------------------------------------------------------------------------------------------
+
+/*
+Minimal flatbuffer builder. As in the reference implementation, the buffer is built back to front,
+so that references (unsigned offsets) always point forward. Positions are measured as the size of
+the buffer, from its end, at the moment an object was written.
+*/
+typedef struct FbBuilder{
+    unsigned char* buf;  // Data occupies buf[capacity - size ... capacity - 1].
+    size_t capacity;
+    size_t size;
+    int err;             // Set if an allocation failed.
+
+    size_t field_pos[FB_MAX_FIELDS];  // Position of each field of the current table (0 = absent).
+    int n_fields;        // Number of vtable slots of the current table.
+    size_t table_start;  // Size at the start of the current table.
+} FbBuilder;
+
+
+static void fb_init(FbBuilder* b){
+    b->capacity = FB_INIT_CAPACITY;
+    b->buf = (unsigned char*) malloc(b->capacity);
+    b->size = 0;
+    b->err = (b->buf == NULL);
+}
+
+
+static void fb_free(FbBuilder* b){
+    free(b->buf); b->buf = NULL;
+    b->capacity = b->size = 0;
+}
+
+
+// Prepends n bytes (zeros if data is NULL).
+static void fb_push(FbBuilder* b, const void* data, size_t n){
+    if (b->err) return;
+
+    if (b->size + n > b->capacity){
+        size_t new_capacity = b->capacity;
+        unsigned char* new_buf;
+
+        while (b->size + n > new_capacity) new_capacity *= 2;
+        new_buf = (unsigned char*) malloc(new_capacity);
+        if (!new_buf){
+            b->err = 1;
+            return;
+        }
+        memcpy(new_buf + new_capacity - b->size, b->buf + b->capacity - b->size, b->size);
+        free(b->buf);
+        b->buf = new_buf;
+        b->capacity = new_capacity;
+    }
+
+    b->size += n;
+    if (data) memcpy(b->buf + b->capacity - b->size, data, n);
+    else memset(b->buf + b->capacity - b->size, 0, n);
+}
+
+
+// Pads so that, after pushing len more bytes, the buffer size is a multiple of align.
+static void fb_prealign(FbBuilder* b, size_t len, size_t align){
+    size_t pad = (align - ((b->size + len) % align)) % align;
+    fb_push(b, NULL, pad);
+}
+
+
+static void fb_push_scalar(FbBuilder* b, const void* value, size_t n){
+    fb_prealign(b, n, n);
+    fb_push(b, value, n);
+}
+
+
+// Prepends a reference to the object at position pos.
+static void fb_push_offset(FbBuilder* b, size_t pos){
+    uint32_t offset;
+
+    fb_prealign(b, sizeof(uint32_t), sizeof(uint32_t));
+    offset = (uint32_t) (b->size + sizeof(uint32_t) - pos);
+    fb_push(b, &offset, sizeof(uint32_t));
+}
+
+
+static size_t fb_create_string(FbBuilder* b, const char* s){
+    uint32_t len = (uint32_t) strlen(s);
+
+    fb_prealign(b, len + 1, sizeof(uint32_t));
+    fb_push(b, NULL, 1);  // Null terminator
+    fb_push(b, s, len);
+    fb_push(b, &len, sizeof(uint32_t));
+    return b->size;
+}
+
+
+static size_t fb_create_offset_vector(FbBuilder* b, const size_t* pos, size_t n){
+    uint32_t len = (uint32_t) n;
+
+    fb_prealign(b, n * sizeof(uint32_t), sizeof(uint32_t));
+    for (size_t i = n; i > 0; i--){
+        fb_push_offset(b, pos[i - 1]);
+    }
+    fb_push(b, &len, sizeof(uint32_t));
+    return b->size;
+}
+
+
+// Vector of structs, given as their raw bytes. All structs used here have 8-byte alignment.
+static size_t fb_create_struct_vector(FbBuilder* b, const void* data, size_t n_bytes, size_t n){
+    uint32_t len = (uint32_t) n;
+
+    fb_prealign(b, n_bytes, sizeof(int64_t));
+    fb_push(b, data, n_bytes);
+    fb_push(b, &len, sizeof(uint32_t));
+    return b->size;
+}
+
+
+static void fb_start_table(FbBuilder* b){
+    memset(b->field_pos, 0, sizeof(b->field_pos));
+    b->n_fields = 0;
+    b->table_start = b->size;
+}
+
+
+static void fb_mark_field(FbBuilder* b, int slot){
+    b->field_pos[slot] = b->size;
+    if (slot + 1 > b->n_fields) b->n_fields = slot + 1;
+}
+
+
+static void fb_add_scalar(FbBuilder* b, int slot, const void* value, size_t n){
+    fb_push_scalar(b, value, n);
+    fb_mark_field(b, slot);
+}
+
+
+static void fb_add_offset(FbBuilder* b, int slot, size_t pos){
+    fb_push_offset(b, pos);
+    fb_mark_field(b, slot);
+}
+
+
+// Writes the table header and its vtable. Returns the position of the table.
+static size_t fb_end_table(FbBuilder* b){
+    int32_t vtable_offset = 0;
+    size_t table_pos, vtable_pos;
+    uint16_t entry;
+
+    // Placeholder for the offset to the vtable
+    fb_push_scalar(b, &vtable_offset, sizeof(int32_t));
+    table_pos = b->size;
+
+    // Vtable: vtable size, table size, then the offset of each field within the table.
+    for (int slot = b->n_fields - 1; slot >= 0; slot--){
+        entry = b->field_pos[slot] ? (uint16_t) (table_pos - b->field_pos[slot]) : 0;
+        fb_push(b, &entry, sizeof(uint16_t));
+    }
+    entry = (uint16_t) (table_pos - b->table_start);
+    fb_push(b, &entry, sizeof(uint16_t));
+    entry = (uint16_t) ((2 + b->n_fields) * sizeof(uint16_t));
+    fb_push(b, &entry, sizeof(uint16_t));
+    vtable_pos = b->size;
+
+    if (!b->err){
+        vtable_offset = (int32_t) (vtable_pos - table_pos);
+        memcpy(b->buf + b->capacity - table_pos, &vtable_offset, sizeof(int32_t));
+    }
+    return table_pos;
+}
+
+
+// Prepends the reference to the root table. The final buffer has a size multiple of 8.
+static void fb_finish(FbBuilder* b, size_t root_pos){
+    fb_prealign(b, sizeof(uint32_t), sizeof(int64_t));
+    fb_push_offset(b, root_pos);
+}
+
+
+static const unsigned char* fb_data(const FbBuilder* b){
+    return b->buf + b->capacity - b->size;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ARROW METADATA
+// ------------------------------------------------------------------------------------------------
+
+// Builds a Field table with a primitive type (type_pos is the table of the type).
+static size_t build_field(FbBuilder* b, const char* name, uint8_t type_id, size_t type_pos){
+    size_t name_pos = fb_create_string(b, name);
+    size_t children_pos = fb_create_offset_vector(b, NULL, 0);  // Required by readers, even if empty
+    uint8_t nullable = 0;
+
+    fb_start_table(b);
+    fb_add_offset(b, 0, name_pos);
+    fb_add_scalar(b, 1, &nullable, sizeof(uint8_t));
+    fb_add_scalar(b, 2, &type_id, sizeof(uint8_t));
+    fb_add_offset(b, 3, type_pos);
+    fb_add_offset(b, 5, children_pos);
+    return fb_end_table(b);
+}
+
+
+// Builds the Schema table: int32 "chain" (shared files only), int64 "iteration", then one float64
+// field per parameter.
+static size_t build_schema(FbBuilder* b, size_t n_params, char* const* param_names, int with_chain){
+    size_t n_fields = n_params + 1 + (with_chain ? 1 : 0);
+    size_t *field_pos = (size_t*) malloc(n_fields * sizeof(size_t));
+    size_t *pos = field_pos;
+    size_t type_pos, fields_pos;
+    int32_t bit_width = 64;
+    uint8_t is_signed = 1;
+    int16_t precision = ARROW_PRECISION_DOUBLE;
+    int16_t endianness = 0;  // Little
+
+    if (!field_pos){
+        b->err = 1;
+        return 0;
+    }
+
+    if (with_chain){
+        int32_t chain_width = 32;
+
+        fb_start_table(b);
+        fb_add_scalar(b, 0, &chain_width, sizeof(int32_t));
+        fb_add_scalar(b, 1, &is_signed, sizeof(uint8_t));
+        type_pos = fb_end_table(b);
+        *pos++ = build_field(b, "chain", ARROW_TYPE_INT, type_pos);
+    }
+
+    fb_start_table(b);
+    fb_add_scalar(b, 0, &bit_width, sizeof(int32_t));
+    fb_add_scalar(b, 1, &is_signed, sizeof(uint8_t));
+    type_pos = fb_end_table(b);
+    *pos++ = build_field(b, "iteration", ARROW_TYPE_INT, type_pos);
+
+    for (size_t p = 0; p < n_params; p++){
+        fb_start_table(b);
+        fb_add_scalar(b, 0, &precision, sizeof(int16_t));
+        type_pos = fb_end_table(b);
+        *pos++ = build_field(b, param_names[p], ARROW_TYPE_FLOATING_POINT, type_pos);
+    }
+
+    fields_pos = fb_create_offset_vector(b, field_pos, n_fields);
+    free(field_pos);
+
+    fb_start_table(b);
+    fb_add_scalar(b, 0, &endianness, sizeof(int16_t));
+    fb_add_offset(b, 1, fields_pos);
+    return fb_end_table(b);
+}
+
+
+// Builds and finishes a Message table around a header table.
+static void finish_message(FbBuilder* b, uint8_t header_type, size_t header_pos, int64_t body_length){
+    int16_t version = ARROW_METADATA_V5;
+
+    fb_start_table(b);
+    fb_add_scalar(b, 0, &version, sizeof(int16_t));
+    fb_add_scalar(b, 1, &header_type, sizeof(uint8_t));
+    fb_add_offset(b, 2, header_pos);
+    fb_add_scalar(b, 3, &body_length, sizeof(int64_t));
+    fb_finish(b, fb_end_table(b));
+}
+
+
+/*
+Builds a RecordBatch message of n rows, without nulls. Column c takes col_bytes[c] bytes of the
+body, padded to a multiple of 8. Returns the length of the body.
+*/
+static int64_t build_record_batch(FbBuilder* b, size_t n, const size_t* col_bytes, size_t n_cols){
+    int64_t *nodes, *buffers;  // FieldNode {length, null_count}, Buffer {offset, length}
+    size_t nodes_pos, buffers_pos, batch_pos;
+    int64_t length = (int64_t) n;
+    int64_t body_length = 0;
+
+    nodes = (int64_t*) malloc(2 * n_cols * sizeof(int64_t));
+    buffers = (int64_t*) malloc(4 * n_cols * sizeof(int64_t));
+    if (!nodes || !buffers){
+        free(nodes); free(buffers);
+        b->err = 1;
+        return 0;
+    }
+
+    // One data buffer per column, each 8-byte aligned. No validity buffers.
+    for (size_t c = 0; c < n_cols; c++){
+        nodes[2 * c] = length;
+        nodes[2 * c + 1] = 0;
+        buffers[4 * c] = body_length;  // Validity: empty
+        buffers[4 * c + 1] = 0;
+        buffers[4 * c + 2] = body_length;
+        buffers[4 * c + 3] = (int64_t) col_bytes[c];
+        body_length += (int64_t) PAD8(col_bytes[c]);
+    }
+
+    nodes_pos = fb_create_struct_vector(b, nodes, 2 * n_cols * sizeof(int64_t), n_cols);
+    buffers_pos = fb_create_struct_vector(b, buffers, 4 * n_cols * sizeof(int64_t), 2 * n_cols);
+    fb_start_table(b);
+    fb_add_scalar(b, 0, &length, sizeof(int64_t));
+    fb_add_offset(b, 1, nodes_pos);
+    fb_add_offset(b, 2, buffers_pos);
+    batch_pos = fb_end_table(b);
+    finish_message(b, ARROW_HEADER_RECORD_BATCH, batch_pos, body_length);
+
+    free(nodes); free(buffers);
+    return body_length;
+}
+
+
+/*
+Builds the Footer table: schema, record batch blocks and, if meta_key is given, one custom metadata
+entry (key-value pair).
+*/
+static void build_footer(FbBuilder* b, size_t n_params, char* const* param_names, int with_chain,
+    const ChainBlock* blocks, size_t n_blocks, const char* meta_key, const char* meta_value){
+
+    size_t schema_pos, dictionaries_pos, batches_pos, meta_pos = 0;
+    int16_t version = ARROW_METADATA_V5;
+    unsigned char* block_bytes;  // Blocks as flatbuffer structs: int64 offset, int32 length, pad, int64 body.
+    const size_t block_size = 24;
+
+    block_bytes = (unsigned char*) calloc(n_blocks + 1, block_size);
+    if (!block_bytes){
+        b->err = 1;
+        return;
+    }
+    for (size_t i = 0; i < n_blocks; i++){
+        memcpy(block_bytes + i * block_size, &blocks[i].offset, sizeof(int64_t));
+        memcpy(block_bytes + i * block_size + 8, &blocks[i].meta_length, sizeof(int32_t));
+        memcpy(block_bytes + i * block_size + 16, &blocks[i].body_length, sizeof(int64_t));
+    }
+
+    schema_pos = build_schema(b, n_params, param_names, with_chain);
+    dictionaries_pos = fb_create_struct_vector(b, NULL, 0, 0);
+    batches_pos = fb_create_struct_vector(b, block_bytes, n_blocks * block_size, n_blocks);
+    free(block_bytes);
+
+    if (meta_key){
+        size_t key_pos = fb_create_string(b, meta_key);
+        size_t value_pos = fb_create_string(b, meta_value);
+        size_t pair_pos;
+
+        fb_start_table(b);
+        fb_add_offset(b, 0, key_pos);
+        fb_add_offset(b, 1, value_pos);
+        pair_pos = fb_end_table(b);
+        meta_pos = fb_create_offset_vector(b, &pair_pos, 1);
+    }
+
+    fb_start_table(b);
+    fb_add_scalar(b, 0, &version, sizeof(int16_t));
+    fb_add_offset(b, 1, schema_pos);
+    fb_add_offset(b, 2, dictionaries_pos);
+    fb_add_offset(b, 3, batches_pos);
+    if (meta_key) fb_add_offset(b, 4, meta_pos);
+    fb_finish(b, fb_end_table(b));
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+
+static int write_bytes(ChainWriter* w, const void* data, size_t n){
+    if (n && fwrite(data, 1, n, w->fp) != n){
+        fprintf(stderr, "Failed to write to %s: \"%s\"\n", w->fname, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    w->file_pos += (int64_t) n;
+    metrics_add_written(0, n);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Drops a message that could not be written completely: its bytes still in the stream buffer are
+discarded, the stream is moved back to the start of the message and the file truncated there, so
+that the next message overwrites it. If the stream cannot be moved, the partial message stays in
+the file, where the footer does not reference it.
+*/
+static void drop_partial_message(ChainWriter* w, int64_t start_pos){
+    off_t pos;
+
+    __fpurge(w->fp);
+    clearerr(w->fp);
+    if (fseeko(w->fp, (off_t) start_pos, SEEK_SET) == 0){
+        w->file_pos = start_pos;
+        if (ftruncate(fileno(w->fp), (off_t) start_pos))
+            fprintf(stderr, "Failed to truncate %s: \"%s\"\n", w->fname, strerror(errno));
+    }
+    else if ((pos = ftello(w->fp)) >= 0){
+        w->file_pos = (int64_t) pos;
+    }
+}
+
+
+/*
+Writes an encapsulated message: continuation marker, metadata size, metadata and body.
+The body is given as a list of parts, each with a size multiple of 8. The stream is flushed at the
+end, so that the buffer never holds a message once it is referenced by a block. If a write fails,
+the partial message is dropped (see drop_partial_message).
+*/
+static int write_message(ChainWriter* w, FbBuilder* b, const void* const* parts,
+    const size_t* part_sizes, size_t n_parts, ChainBlock* block_p){
+
+    uint32_t continuation = ARROW_CONTINUATION;
+    int32_t meta_size = (int32_t) b->size;  // Already a multiple of 8.
+    int64_t body_length = 0;
+    int64_t start_pos = w->file_pos;
+    TraceSpan span = trace_begin("chain", "write_message");
+
+    if (b->err){
+        fprintf(stderr, "Failed to allocate Arrow metadata for %s.\n", w->fname);
+        trace_end(span);
+        return EXIT_FAILURE;
+    }
+
+    block_p->offset = w->file_pos;
+    if (write_bytes(w, &continuation, sizeof(uint32_t))
+        || write_bytes(w, &meta_size, sizeof(int32_t))
+        || write_bytes(w, fb_data(b), b->size)){
+        drop_partial_message(w, start_pos);
+        trace_end(span);
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < n_parts; i++){
+        if (write_bytes(w, parts[i], part_sizes[i])){
+            drop_partial_message(w, start_pos);
+            trace_end(span);
+            return EXIT_FAILURE;
+        }
+        body_length += (int64_t) part_sizes[i];
+    }
+    if (fflush(w->fp)){
+        fprintf(stderr, "Failed to write to %s: \"%s\"\n", w->fname, strerror(errno));
+        drop_partial_message(w, start_pos);
+        trace_end(span);
+        return EXIT_FAILURE;
+    }
+
+    block_p->meta_length = (int32_t) (2 * sizeof(int32_t)) + meta_size;
+    block_p->body_length = body_length;
+    trace_end_bytes(span, (uint64_t) (w->file_pos - start_pos));
+    return EXIT_SUCCESS;
+}
+
+
+static int write_schema_message(ChainWriter* w){
+    FbBuilder b;
+    ChainBlock block;
+    int status;
+
+    fb_init(&b);
+    finish_message(&b, ARROW_HEADER_SCHEMA, build_schema(&b, w->n_params, w->param_names, 0), 0);
+    status = write_message(w, &b, NULL, NULL, 0, &block);
+    fb_free(&b);
+    return status;
+}
+
+
+static int write_footer(ChainWriter* w){
+    FbBuilder b;
+    int32_t footer_size;
+
+    fb_init(&b);
+    build_footer(&b, w->n_params, w->param_names, 0, w->blocks, w->n_blocks, NULL, NULL);
+    if (b.err){
+        fprintf(stderr, "Failed to allocate Arrow footer for %s.\n", w->fname);
+        fb_free(&b);
+        return EXIT_FAILURE;
+    }
+
+    footer_size = (int32_t) b.size;
+    if (write_bytes(w, fb_data(&b), b.size)
+        || write_bytes(w, &footer_size, sizeof(int32_t))
+        || write_bytes(w, ARROW_MAGIC, strlen(ARROW_MAGIC))){
+        fb_free(&b);
+        return EXIT_FAILURE;
+    }
+
+    fb_free(&b);
+    return EXIT_SUCCESS;
+}
+
+
+static void free_chain_writer(ChainWriter* w){
+    if (w->param_names){
+        for (size_t p = 0; p < w->n_params; p++) free(w->param_names[p]);
+    }
+    free(w->param_names); w->param_names = NULL;
+    untrack_memory(w->iter_buf);
+    untrack_memory(w->sample_buf);
+    untrack_memory(w->blocks);
+    free(w->iter_buf); w->iter_buf = NULL;
+    free(w->sample_buf); w->sample_buf = NULL;
+    free(w->blocks); w->blocks = NULL;
+    free(w->fname); w->fname = NULL;
+    metrics_add_queued(-(int64_t) w->n_buffered);  // Samples lost if a flush failed.
+    if (w->ring.map) close_sample_ring(&w->ring);
+    free_downsample_sidecar(&w->sidecar);
+    w->n_blocks = w->blocks_capacity = w->n_buffered = 0;
+}
+
+
+/*
+Writes a list of buffers at the given file offset (pwritev), resuming after partial writes.
+The list is modified.
+*/
+static int pwrite_all(int fd, const char* fname, struct iovec* iov, int n_iov, int64_t offset){
+    ssize_t n;
+
+    while (n_iov > 0){
+        n = pwritev(fd, iov, (n_iov < IOV_MAX) ? n_iov : IOV_MAX, (off_t) offset);
+        if (n < 0){
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Failed to write to %s: \"%s\"\n", fname, strerror(errno));
+            return EXIT_FAILURE;
+        }
+        offset += n;
+
+        while (n_iov > 0 && (size_t) n >= iov->iov_len){
+            n -= (ssize_t) iov->iov_len;
+            iov++;
+            n_iov--;
+        }
+        if (n_iov > 0){
+            iov->iov_base = (char*) iov->iov_base + n;
+            iov->iov_len -= (size_t) n;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+
+static void free_chunk_list(ChainChunkList* list){
+    ChainChunkList* next;
+
+    for (; list; list = next){
+        next = list->next;
+        untrack_memory(list->chunks);
+        free(list->chunks);
+        free(list);
+    }
+}
+
+
+static void free_shared_chain_file(SharedChainFile* f){
+    if (f->param_names){
+        for (size_t p = 0; p < f->n_params; p++) free(f->param_names[p]);
+    }
+    free(f->param_names); f->param_names = NULL;
+    free(f->fname); f->fname = NULL;
+    free_chunk_list(__atomic_exchange_n(&f->closed_chunks, NULL, __ATOMIC_ACQUIRE));
+}
+
+
+static void free_chain_stream(ChainStream* s){
+    untrack_memory(s->chain_buf);
+    untrack_memory(s->iter_buf);
+    untrack_memory(s->sample_buf);
+    free(s->chain_buf); s->chain_buf = NULL;
+    free(s->iter_buf); s->iter_buf = NULL;
+    free(s->sample_buf); s->sample_buf = NULL;
+    metrics_add_queued(-(int64_t) s->n_buffered);
+    s->n_buffered = 0;
+    free_downsample_sidecar(&s->sidecar);
+}
+
+
+// Orders the chunks by chain, then by iteration.
+static int compare_chunks(const void* a, const void* b){
+    const ChainChunk* x = (const ChainChunk*) a;
+    const ChainChunk* y = (const ChainChunk*) b;
+
+    if (x->chain != y->chain) return (x->chain > y->chain) - (x->chain < y->chain);
+    return (x->first_iter > y->first_iter) - (x->first_iter < y->first_iter);
+}
+
+
+/*
+Writes the end of a shared chain file at its current end: end-of-stream marker, then the footer,
+whose blocks follow the chunks of all the closed streams ordered by chain and iteration. The same
+order is written as the chunk index (CHAIN_INDEX_KEY) in the footer metadata.
+*/
+static int write_shared_footer(SharedChainFile* f){
+    ChainChunkList *list = __atomic_load_n(&f->closed_chunks, __ATOMIC_ACQUIRE);
+    ChainChunkList *node;
+    ChainChunk* chunks;
+    ChainBlock* blocks;
+    char* index_text;
+    size_t n = 0, k = 0, len = 0;
+    uint32_t eos[2] = {ARROW_CONTINUATION, 0};
+    int32_t footer_size;
+    struct iovec iov[4];
+    FbBuilder b;
+    int status;
+
+    for (node = list; node; node = node->next) n += node->n_chunks;
+
+    chunks = (ChainChunk*) malloc((n + 1) * sizeof(ChainChunk));
+    blocks = (ChainBlock*) malloc((n + 1) * sizeof(ChainBlock));
+    index_text = (char*) malloc(n * CHAIN_INDEX_LINE_MAX + 1);
+    if (!chunks || !blocks || !index_text){
+        fprintf(stderr, "Failed to allocate the chunk index of %s.\n", f->fname);
+        free(chunks); free(blocks); free(index_text);
+        return EXIT_FAILURE;
+    }
+
+    for (node = list; node; node = node->next){
+        if (node->n_chunks) memcpy(chunks + k, node->chunks, node->n_chunks * sizeof(ChainChunk));
+        k += node->n_chunks;
+    }
+    qsort(chunks, n, sizeof(ChainChunk), compare_chunks);
+
+    index_text[0] = '\0';
+    for (size_t i = 0; i < n; i++){
+        blocks[i] = chunks[i].block;
+        len += (size_t) snprintf(index_text + len, CHAIN_INDEX_LINE_MAX + 1, "%d %lld %lld\n",
+            (int) chunks[i].chain, (long long) chunks[i].first_iter, (long long) chunks[i].last_iter);
+    }
+    free(chunks);
+
+    fb_init(&b);
+    build_footer(&b, f->n_params, f->param_names, 1, blocks, n, CHAIN_INDEX_KEY, index_text);
+    free(blocks);
+    free(index_text);
+    if (b.err){
+        fprintf(stderr, "Failed to allocate Arrow footer for %s.\n", f->fname);
+        fb_free(&b);
+        return EXIT_FAILURE;
+    }
+
+    footer_size = (int32_t) b.size;
+    iov[0].iov_base = eos;                    iov[0].iov_len = sizeof(eos);
+    iov[1].iov_base = (void*) fb_data(&b);    iov[1].iov_len = b.size;
+    iov[2].iov_base = &footer_size;           iov[2].iov_len = sizeof(int32_t);
+    iov[3].iov_base = (void*) ARROW_MAGIC;    iov[3].iov_len = strlen(ARROW_MAGIC);
+    status = pwrite_all(f->fd, f->fname, iov, 4, __atomic_load_n(&f->file_pos, __ATOMIC_RELAXED));
+
+    fb_free(&b);
+    return status;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Opens an Arrow IPC file for chain output and writes its header and schema.
+
+@param writer_p  Pointer to a ChainWriter struct, which is initialized.
+@param fname  Path for the output file. Must be a null-terminated string.
+@param n_params  Number of parameters in each sample.
+@param param_names  Names of the parameters (column names). Copied.
+@param batch_iters  Number of iterations buffered in each record batch.
+
+@return An integer error code.
+*/
+int open_chain_writer(ChainWriter* writer_p, const char* fname, size_t n_params,
+    const char* const* param_names, size_t batch_iters){
+
+    const char header[8] = ARROW_MAGIC;  // Magic string padded to 8 bytes.
+
+    memset(writer_p, 0, sizeof(ChainWriter));
+    writer_p->n_params = n_params;
+    writer_p->batch_iters = (batch_iters > 0) ? batch_iters : 1;
+
+    writer_p->fname = (char*) malloc(strlen(fname) + 1);
+    writer_p->param_names = (char**) calloc(n_params, sizeof(char*));
+    writer_p->iter_buf = (int64_t*) malloc(writer_p->batch_iters * sizeof(int64_t));
+    writer_p->sample_buf = (double*) malloc(n_params * writer_p->batch_iters * sizeof(double));
+    if (!writer_p->fname || !writer_p->param_names || !writer_p->iter_buf
+        || (n_params && !writer_p->sample_buf)){
+        fprintf(stderr, "Failed to allocate chain writer buffers @ open_chain_writer.\n");
+        free_chain_writer(writer_p);
+        return EXIT_FAILURE;
+    }
+    strcpy(writer_p->fname, fname);
+    track_memory(writer_p->iter_buf, writer_p->batch_iters * sizeof(int64_t), MEMORY_HEAP);
+    track_memory(writer_p->sample_buf, n_params * writer_p->batch_iters * sizeof(double), MEMORY_HEAP);
+
+    for (size_t p = 0; p < n_params; p++){
+        writer_p->param_names[p] = (char*) malloc(strlen(param_names[p]) + 1);
+        if (!writer_p->param_names[p]){
+            fprintf(stderr, "Failed to allocate parameter names @ open_chain_writer.\n");
+            free_chain_writer(writer_p);
+            return EXIT_FAILURE;
+        }
+        strcpy(writer_p->param_names[p], param_names[p]);
+    }
+
+    // --- File opening
+    writer_p->fp = fopen(fname, "wb");
+    if (!writer_p->fp) {
+        fprintf(stderr, "Failed to open %s: \"%s\"\n", fname, strerror(errno));
+        free_chain_writer(writer_p);
+        return EXIT_FAILURE;
+    }
+
+    if (write_bytes(writer_p, header, sizeof(header)) || write_schema_message(writer_p)){
+        fclose(writer_p->fp);
+        writer_p->fp = NULL;
+        free_chain_writer(writer_p);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Mirrors the latest samples written to the chain into a shared-memory ring (see mcmc_ring.h), from
+which monitor processes can read them at any time (attach_sample_ring, read_sample_ring) without
+touching the output file. The ring is removed when the writer is closed.
+
+@param shm_name  Name of the shared memory object, as for shm_open (e.g. "/mcmc_chain0").
+@param n_samples  Number of latest samples held by the ring.
+
+@return An integer error code.
+*/
+int mirror_chain_writer(ChainWriter* writer_p, const char* shm_name, size_t n_samples){
+    if (writer_p->ring.map) close_sample_ring(&writer_p->ring);
+    return create_sample_ring(&writer_p->ring, shm_name, writer_p->n_params,
+        (const char* const*) writer_p->param_names, n_samples);
+}
+
+
+/*
+Keeps a downsample of the chain for trace plots (see mcmc_downsample.h), written to a small CSV
+sidecar at close and, while the chain runs, every update_iters iterations (at the first flush
+after them), so trace plots can be drawn without reading the chain file. Call before writing
+samples: earlier samples are not included. The downsample belongs to this writer and ends with
+it; for a RollingChainWriter, whose segment writer is reopened at each roll, use
+downsample_rolling_chain_writer instead.
+
+@param sidecar_fname  Path of the sidecar. NULL for the chain file name plus ".lttb.csv".
+@param n_points  Number of points of the downsample of each parameter (e.g. 5000).
+@param update_iters  Iterations between rewrites of the sidecar. 0 to write it only at close.
+
+@return An integer error code.
+*/
+int downsample_chain_writer(ChainWriter* writer_p, const char* sidecar_fname, size_t n_points,
+    int64_t update_iters){
+
+    return open_downsample_sidecar(&writer_p->sidecar, sidecar_fname ? sidecar_fname : writer_p->fname,
+        sidecar_fname ? "" : ".lttb.csv", writer_p->n_params, n_points, update_iters, writer_p->next_iter);
+}
+
+
+/*
+Appends one sample (n_params values) to the chain. A record batch is written when the buffer is full.
+If that write failed, the buffer is still full, and is written again before the sample is appended.
+*/
+int write_chain_sample(ChainWriter* writer_p, const double* sample){
+    size_t i;
+
+    if (writer_p->n_buffered == writer_p->batch_iters && flush_chain_writer(writer_p))
+        return EXIT_FAILURE;
+
+    i = writer_p->n_buffered;
+    writer_p->iter_buf[i] = writer_p->next_iter++;
+    for (size_t p = 0; p < writer_p->n_params; p++){
+        writer_p->sample_buf[p * writer_p->batch_iters + i] = sample[p];
+    }
+    if (writer_p->ring.map) push_sample_ring(&writer_p->ring, writer_p->iter_buf[i], sample);
+    if (writer_p->sidecar.fname) add_downsample_sample(&writer_p->sidecar.ds, writer_p->iter_buf[i], sample);
+    metrics_add_queued(1);
+
+    if (++writer_p->n_buffered == writer_p->batch_iters)
+        return flush_chain_writer(writer_p);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Appends n_iter samples, stored by row (sample i at samples[i * n_params]).
+*/
+int write_chain_samples(ChainWriter* writer_p, const double* samples, size_t n_iter){
+    if (writer_p->n_buffered == writer_p->batch_iters && flush_chain_writer(writer_p))
+        return EXIT_FAILURE;
+
+    for (size_t i = 0; i < n_iter; i++){
+        if (write_chain_sample(writer_p, samples + i * writer_p->n_params))
+            return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Writes the buffered samples (if any) as a record batch.
+*/
+int flush_chain_writer(ChainWriter* writer_p){
+    size_t n = writer_p->n_buffered;
+    size_t n_cols = writer_p->n_params + 1;
+    const void* *parts;
+    size_t *part_sizes;
+    FbBuilder b;
+    int status;
+
+    if (n == 0) return EXIT_SUCCESS;
+
+    // Grows the list of blocks for the footer
+    if (writer_p->n_blocks == writer_p->blocks_capacity){
+        size_t new_capacity = writer_p->blocks_capacity ? 2 * writer_p->blocks_capacity : 16;
+        ChainBlock* new_blocks = (ChainBlock*) realloc(writer_p->blocks, new_capacity * sizeof(ChainBlock));
+        if (!new_blocks){
+            fprintf(stderr, "Failed to allocate chain block list @ flush_chain_writer.\n");
+            return EXIT_FAILURE;
+        }
+        retrack_memory(writer_p->blocks, new_blocks, new_capacity * sizeof(ChainBlock));
+        writer_p->blocks = new_blocks;
+        writer_p->blocks_capacity = new_capacity;
+    }
+
+    parts = (const void**) malloc(n_cols * sizeof(void*));
+    part_sizes = (size_t*) malloc(n_cols * sizeof(size_t));
+    if (!parts || !part_sizes){
+        fprintf(stderr, "Failed to allocate record batch metadata @ flush_chain_writer.\n");
+        free(parts); free(part_sizes);
+        return EXIT_FAILURE;
+    }
+
+    for (size_t c = 0; c < n_cols; c++){
+        parts[c] = (c == 0) ? (const void*) writer_p->iter_buf
+                            : (const void*) (writer_p->sample_buf + (c - 1) * writer_p->batch_iters);
+        part_sizes[c] = n * sizeof(double);
+    }
+
+    fb_init(&b);
+    build_record_batch(&b, n, part_sizes, n_cols);
+
+    status = write_message(writer_p, &b, parts, part_sizes, n_cols, &writer_p->blocks[writer_p->n_blocks]);
+    if (status == EXIT_SUCCESS){
+        writer_p->n_blocks++;
+        writer_p->n_buffered = 0;
+        metrics_add_queued(-(int64_t) n);
+        metrics_add_written(n, 0);
+    }
+
+    // Periodic rewrite of the sidecar. A failure is reported, but the chain itself is fine.
+    if (status == EXIT_SUCCESS)
+        update_downsample_sidecar(&writer_p->sidecar, writer_p->next_iter, (const char* const*) writer_p->param_names);
+
+    fb_free(&b);
+    free(parts); free(part_sizes);
+    return status;
+}
+
+
+/*
+Writes the buffered samples and forces the file to storage (fsync), e.g. at checkpoints. The
+record batches written so far survive a crash afterwards (the file then lacks its footer).
+The latency of the fsync is recorded in the metrics page (see mcmc_metrics.h).
+
+@return An integer error code.
+*/
+int sync_chain_writer(ChainWriter* writer_p){
+    TraceSpan span;
+    uint64_t start;
+    int status = EXIT_SUCCESS;
+
+    if (flush_chain_writer(writer_p)) return EXIT_FAILURE;
+
+    span = trace_begin("chain", "sync_chain_writer");
+    start = now_ns();
+    if (fflush(writer_p->fp) || fsync(fileno(writer_p->fp))){
+        fprintf(stderr, "Failed to sync %s: \"%s\"\n", writer_p->fname, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    else{
+        metrics_add_fsync(now_ns() - start);
+    }
+    trace_end(span);
+    return status;
+}
+
+
+/*
+Flushes the remaining samples, writes the file footer and closes the file.
+The writer buffers are freed even if an error occurs.
+
+@return An integer error code.
+*/
+int close_chain_writer(ChainWriter* writer_p){
+    uint32_t eos[2] = {ARROW_CONTINUATION, 0};
+    TraceSpan span = trace_begin("chain", "close_chain_writer");
+    int status = EXIT_SUCCESS;
+
+    if (flush_chain_writer(writer_p)
+        || write_bytes(writer_p, eos, sizeof(eos))
+        || write_footer(writer_p))
+        status = EXIT_FAILURE;
+
+    if (writer_p->sidecar.fname && write_downsample(&writer_p->sidecar.ds, writer_p->sidecar.fname,
+        (const char* const*) writer_p->param_names))
+        status = EXIT_FAILURE;
+
+    if (fclose(writer_p->fp)){
+        fprintf(stderr, "Failed to close %s: \"%s\"\n", writer_p->fname, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    writer_p->fp = NULL;
+
+    free_chain_writer(writer_p);
+    trace_end(span);
+    return status;
+}
+
+
+/*
+Returns the memory held by the buffers of a chain writer (heap). The resident bytes are those of
+the buffered samples and the block list; the capacity includes a full batch.
+*/
+MemoryUsage chain_writer_memory(const ChainWriter* writer_p){
+    size_t iter_bytes = sizeof(int64_t) + writer_p->n_params * sizeof(double);
+    MemoryUsage usage = {0, 0, MEMORY_HEAP};
+
+    if (!writer_p->iter_buf) return usage;
+    usage.resident = writer_p->n_buffered * iter_bytes + writer_p->n_blocks * sizeof(ChainBlock);
+    usage.capacity = writer_p->batch_iters * iter_bytes + writer_p->blocks_capacity * sizeof(ChainBlock);
+    return usage;
+}
+
+
+/*
+Opens an Arrow IPC chain file to be written concurrently by several chains, each through its own
+ChainStream (open_chain_stream), typically one per thread. The header and schema are written here;
+the record batches of the streams are appended as they are flushed, in whatever order the threads
+get to it, and close_shared_chain_file writes the footer ordered by chain and iteration.
+
+@param file_p  Pointer to a SharedChainFile struct, which is initialized. Must not be moved while
+    streams are open.
+@param fname  Path for the output file. Must be a null-terminated string.
+@param n_params  Number of parameters in each sample.
+@param param_names  Names of the parameters (column names). Copied.
+@param batch_iters  Number of iterations buffered by each stream in each record batch.
+
+@return An integer error code.
+*/
+int open_shared_chain_file(SharedChainFile* file_p, const char* fname, size_t n_params,
+    const char* const* param_names, size_t batch_iters){
+
+    const char header[8] = ARROW_MAGIC;  // Magic string padded to 8 bytes.
+    uint32_t prefix[2] = {ARROW_CONTINUATION, 0};
+    struct iovec iov[3];
+    FbBuilder b;
+
+    memset(file_p, 0, sizeof(SharedChainFile));
+    file_p->fd = -1;
+    file_p->n_params = n_params;
+    file_p->batch_iters = (batch_iters > 0) ? batch_iters : 1;
+    file_p->file_pos = 0;
+    file_p->n_streams = 0;
+    file_p->closed_chunks = NULL;
+
+    file_p->fname = (char*) malloc(strlen(fname) + 1);
+    file_p->param_names = (char**) calloc(n_params, sizeof(char*));
+    if (!file_p->fname || !file_p->param_names){
+        fprintf(stderr, "Failed to allocate shared chain file @ open_shared_chain_file.\n");
+        free_shared_chain_file(file_p);
+        return EXIT_FAILURE;
+    }
+    strcpy(file_p->fname, fname);
+
+    for (size_t p = 0; p < n_params; p++){
+        file_p->param_names[p] = (char*) malloc(strlen(param_names[p]) + 1);
+        if (!file_p->param_names[p]){
+            fprintf(stderr, "Failed to allocate parameter names @ open_shared_chain_file.\n");
+            free_shared_chain_file(file_p);
+            return EXIT_FAILURE;
+        }
+        strcpy(file_p->param_names[p], param_names[p]);
+    }
+
+    // --- File opening
+    file_p->fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file_p->fd < 0){
+        fprintf(stderr, "Failed to open %s: \"%s\"\n", fname, strerror(errno));
+        free_shared_chain_file(file_p);
+        return EXIT_FAILURE;
+    }
+
+    fb_init(&b);
+    finish_message(&b, ARROW_HEADER_SCHEMA, build_schema(&b, n_params, file_p->param_names, 1), 0);
+    if (b.err){
+        fprintf(stderr, "Failed to allocate Arrow metadata for %s.\n", fname);
+        fb_free(&b);
+        close(file_p->fd);
+        free_shared_chain_file(file_p);
+        return EXIT_FAILURE;
+    }
+
+    prefix[1] = (uint32_t) b.size;
+    iov[0].iov_base = (void*) header;         iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = prefix;                 iov[1].iov_len = sizeof(prefix);
+    iov[2].iov_base = (void*) fb_data(&b);    iov[2].iov_len = b.size;
+    __atomic_store_n(&file_p->file_pos, (int64_t) (sizeof(header) + sizeof(prefix) + b.size), __ATOMIC_RELAXED);
+
+    if (pwrite_all(file_p->fd, fname, iov, 3, 0)){
+        fb_free(&b);
+        close(file_p->fd);
+        free_shared_chain_file(file_p);
+        return EXIT_FAILURE;
+    }
+
+    fb_free(&b);
+    metrics_add_written(0, (uint64_t) __atomic_load_n(&file_p->file_pos, __ATOMIC_RELAXED));
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Writes the footer of a shared chain file and closes it. All its streams must have been closed
+before; otherwise, an error is returned and the file is left open.
+
+The footer holds one block per record batch, ordered by chain and then by iteration, so that
+readers get each chain contiguous and in order. The same order is written as text under the
+CHAIN_INDEX_KEY key of the footer metadata, one line "<chain> <first_iter> <last_iter>" per
+block, so readers can select the batches of a chain without reading the others.
+
+@return An integer error code.
+*/
+int close_shared_chain_file(SharedChainFile* file_p){
+    TraceSpan span;
+    int n_open = __atomic_load_n(&file_p->n_streams, __ATOMIC_ACQUIRE);
+    int status;
+
+    if (n_open){
+        fprintf(stderr, "Failed to close %s: %d chain streams still open.\n", file_p->fname, n_open);
+        return EXIT_FAILURE;
+    }
+
+    span = trace_begin("chain", "close_shared_chain_file");
+    status = write_shared_footer(file_p);
+
+    if (close(file_p->fd)){
+        fprintf(stderr, "Failed to close %s: \"%s\"\n", file_p->fname, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    file_p->fd = -1;
+
+    free_shared_chain_file(file_p);
+    trace_end(span);
+    return status;
+}
+
+
+/*
+Opens the output of one chain into a shared chain file. Each stream buffers its samples and writes
+them as its own record batches; streams can be used from different threads without any locking.
+
+@param stream_p  Pointer to a ChainStream struct, which is initialized.
+@param file_p  Shared chain file, open.
+@param chain  Identifier of the chain, written in the "chain" column and the chunk index.
+
+@return An integer error code.
+*/
+int open_chain_stream(ChainStream* stream_p, SharedChainFile* file_p, int32_t chain){
+    size_t batch_iters = file_p->batch_iters;
+
+    memset(stream_p, 0, sizeof(ChainStream));
+    stream_p->file_p = file_p;
+    stream_p->chain = chain;
+
+    // The chain column is padded to 8 bytes, hence the extra entry.
+    stream_p->chain_buf = (int32_t*) malloc((batch_iters + 1) * sizeof(int32_t));
+    stream_p->iter_buf = (int64_t*) malloc(batch_iters * sizeof(int64_t));
+    stream_p->sample_buf = (double*) malloc(file_p->n_params * batch_iters * sizeof(double));
+    stream_p->index = (ChainChunkList*) calloc(1, sizeof(ChainChunkList));
+    if (!stream_p->chain_buf || !stream_p->iter_buf || !stream_p->index
+        || (file_p->n_params && !stream_p->sample_buf)){
+        fprintf(stderr, "Failed to allocate chain stream buffers @ open_chain_stream.\n");
+        free_chain_stream(stream_p);
+        free(stream_p->index); stream_p->index = NULL;
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i <= batch_iters; i++) stream_p->chain_buf[i] = chain;
+
+    track_memory(stream_p->chain_buf, (batch_iters + 1) * sizeof(int32_t), MEMORY_HEAP);
+    track_memory(stream_p->iter_buf, batch_iters * sizeof(int64_t), MEMORY_HEAP);
+    track_memory(stream_p->sample_buf, file_p->n_params * batch_iters * sizeof(double), MEMORY_HEAP);
+
+    __atomic_fetch_add(&file_p->n_streams, 1, __ATOMIC_RELAXED);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Keeps a downsample of the chain of a stream for trace plots, as downsample_chain_writer. Each
+stream has its own sidecar, rewritten by the thread of the stream only.
+
+@param sidecar_fname  Path of the sidecar. NULL for the file name plus ".<chain>.lttb.csv".
+@param n_points  Number of points of the downsample of each parameter (e.g. 5000).
+@param update_iters  Iterations between rewrites of the sidecar. 0 to write it only at close.
+
+@return An integer error code.
+*/
+int downsample_chain_stream(ChainStream* stream_p, const char* sidecar_fname, size_t n_points,
+    int64_t update_iters){
+
+    char suffix[32];
+
+    snprintf(suffix, sizeof(suffix), ".%d.lttb.csv", (int) stream_p->chain);
+    return open_downsample_sidecar(&stream_p->sidecar, sidecar_fname ? sidecar_fname : stream_p->file_p->fname,
+        sidecar_fname ? "" : suffix, stream_p->file_p->n_params, n_points, update_iters, stream_p->next_iter);
+}
+
+
+/*
+Appends one sample (n_params values) to the chain. A record batch is written when the buffer is full.
+If that write failed, the buffer is still full, and is written again before the sample is appended.
+*/
+int write_stream_sample(ChainStream* stream_p, const double* sample){
+    size_t batch_iters = stream_p->file_p->batch_iters;
+    size_t i;
+
+    if (stream_p->n_buffered == batch_iters && flush_chain_stream(stream_p))
+        return EXIT_FAILURE;
+
+    i = stream_p->n_buffered;
+    stream_p->iter_buf[i] = stream_p->next_iter++;
+    for (size_t p = 0; p < stream_p->file_p->n_params; p++){
+        stream_p->sample_buf[p * batch_iters + i] = sample[p];
+    }
+    if (stream_p->sidecar.fname) add_downsample_sample(&stream_p->sidecar.ds, stream_p->iter_buf[i], sample);
+    metrics_add_queued(1);
+
+    if (++stream_p->n_buffered == batch_iters)
+        return flush_chain_stream(stream_p);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Appends n_iter samples, stored by row (sample i at samples[i * n_params]).
+*/
+int write_stream_samples(ChainStream* stream_p, const double* samples, size_t n_iter){
+    if (stream_p->n_buffered == stream_p->file_p->batch_iters && flush_chain_stream(stream_p))
+        return EXIT_FAILURE;
+
+    for (size_t i = 0; i < n_iter; i++){
+        if (write_stream_sample(stream_p, samples + i * stream_p->file_p->n_params))
+            return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Writes the buffered samples (if any) as a record batch. Its space in the file is reserved by an
+atomic increment of the file end, then written with pwrite, so concurrent streams do not wait on
+each other. If the write fails, the reserved space is left unreferenced by the footer.
+*/
+int flush_chain_stream(ChainStream* stream_p){
+    SharedChainFile* f = stream_p->file_p;
+    ChainChunkList* index = stream_p->index;
+    size_t n = stream_p->n_buffered;
+    size_t n_cols = f->n_params + 2;
+    uint32_t prefix[2] = {ARROW_CONTINUATION, 0};
+    struct iovec* iov;
+    size_t *col_bytes;
+    int64_t body_length, msg_length, offset;
+    ChainChunk* chunk;
+    TraceSpan span;
+    FbBuilder b;
+    int status;
+
+    if (n == 0) return EXIT_SUCCESS;
+
+    // Grows the chunk index of the stream
+    if (index->n_chunks == index->capacity){
+        size_t new_capacity = index->capacity ? 2 * index->capacity : 16;
+        ChainChunk* new_chunks = (ChainChunk*) realloc(index->chunks, new_capacity * sizeof(ChainChunk));
+        if (!new_chunks){
+            fprintf(stderr, "Failed to allocate chunk index @ flush_chain_stream.\n");
+            return EXIT_FAILURE;
+        }
+        retrack_memory(index->chunks, new_chunks, new_capacity * sizeof(ChainChunk));
+        index->chunks = new_chunks;
+        index->capacity = new_capacity;
+    }
+
+    iov = (struct iovec*) malloc((n_cols + 2) * sizeof(struct iovec));
+    col_bytes = (size_t*) malloc(n_cols * sizeof(size_t));
+    if (!iov || !col_bytes){
+        fprintf(stderr, "Failed to allocate record batch metadata @ flush_chain_stream.\n");
+        free(iov); free(col_bytes);
+        return EXIT_FAILURE;
+    }
+
+    col_bytes[0] = n * sizeof(int32_t);
+    for (size_t c = 1; c < n_cols; c++) col_bytes[c] = n * sizeof(double);
+
+    fb_init(&b);
+    body_length = build_record_batch(&b, n, col_bytes, n_cols);
+    if (b.err){
+        fprintf(stderr, "Failed to allocate Arrow metadata for %s.\n", f->fname);
+        fb_free(&b);
+        free(iov); free(col_bytes);
+        return EXIT_FAILURE;
+    }
+
+    prefix[1] = (uint32_t) b.size;
+    iov[0].iov_base = prefix;                           iov[0].iov_len = sizeof(prefix);
+    iov[1].iov_base = (void*) fb_data(&b);              iov[1].iov_len = b.size;
+    iov[2].iov_base = stream_p->chain_buf;              iov[2].iov_len = PAD8(col_bytes[0]);
+    iov[3].iov_base = stream_p->iter_buf;               iov[3].iov_len = col_bytes[1];
+    for (size_t p = 0; p < f->n_params; p++){
+        iov[4 + p].iov_base = stream_p->sample_buf + p * f->batch_iters;
+        iov[4 + p].iov_len = col_bytes[2 + p];
+    }
+
+    span = trace_begin("chain", "flush_chain_stream");
+    msg_length = (int64_t) (sizeof(prefix) + b.size) + body_length;
+    offset = __atomic_fetch_add(&f->file_pos, msg_length, __ATOMIC_RELAXED);
+    status = pwrite_all(f->fd, f->fname, iov, (int) (n_cols + 2), offset);
+    trace_end_bytes(span, (uint64_t) msg_length);
+
+    if (status == EXIT_SUCCESS){
+        chunk = &index->chunks[index->n_chunks++];
+        chunk->chain = stream_p->chain;
+        chunk->first_iter = stream_p->iter_buf[0];
+        chunk->last_iter = stream_p->iter_buf[n - 1];
+        chunk->block.offset = offset;
+        chunk->block.meta_length = (int32_t) (sizeof(prefix) + b.size);
+        chunk->block.body_length = body_length;
+
+        stream_p->n_buffered = 0;
+        metrics_add_queued(-(int64_t) n);
+        metrics_add_written(n, (uint64_t) msg_length);
+
+        // Periodic rewrite of the sidecar. A failure is reported, but the chain itself is fine.
+        update_downsample_sidecar(&stream_p->sidecar, stream_p->next_iter, (const char* const*) f->param_names);
+    }
+
+    fb_free(&b);
+    free(iov); free(col_bytes);
+    return status;
+}
+
+
+/*
+Flushes the remaining samples, writes the sidecar (if any) and hands the chunk index of the stream
+over to its file. The stream buffers are freed even if an error occurs; the batches written before
+remain indexed. Fails without side effects if the stream is not open (e.g. closed twice).
+
+@return An integer error code.
+*/
+int close_chain_stream(ChainStream* stream_p){
+    SharedChainFile* f = stream_p->file_p;
+    ChainChunkList* index = stream_p->index;
+    int status;
+
+    if (!index){
+        fprintf(stderr, "Chain stream is not open @ close_chain_stream.\n");
+        return EXIT_FAILURE;
+    }
+
+    status = flush_chain_stream(stream_p);
+
+    if (stream_p->sidecar.fname && write_downsample(&stream_p->sidecar.ds, stream_p->sidecar.fname,
+        (const char* const*) f->param_names))
+        status = EXIT_FAILURE;
+
+    // Lock-free push onto the list of closed chunks
+    index->next = __atomic_load_n(&f->closed_chunks, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&f->closed_chunks, &index->next, index, 1,
+        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    stream_p->index = NULL;
+
+    free_chain_stream(stream_p);
+    __atomic_fetch_sub(&f->n_streams, 1, __ATOMIC_RELEASE);
+    return status;
+}
+
+
+/*
+Returns the memory held by the buffers of a chain stream (heap), as chain_writer_memory.
+*/
+MemoryUsage chain_stream_memory(const ChainStream* stream_p){
+    size_t n_params = stream_p->file_p ? stream_p->file_p->n_params : 0;
+    size_t iter_bytes = sizeof(int32_t) + sizeof(int64_t) + n_params * sizeof(double);
+    MemoryUsage usage = {0, 0, MEMORY_HEAP};
+
+    if (!stream_p->iter_buf) return usage;
+    usage.resident = stream_p->n_buffered * iter_bytes + stream_p->index->n_chunks * sizeof(ChainChunk);
+    usage.capacity = stream_p->file_p->batch_iters * iter_bytes
+        + stream_p->index->capacity * sizeof(ChainChunk);
+    return usage;
+}
@@ -0,0 +1,128 @@
+#ifndef MCMC_CHAIN_H
+#define MCMC_CHAIN_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mcmc_memory.h"
+#include "mcmc_ring.h"
+#include "mcmc_downsample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHAIN_INDEX_KEY "mcmc.chunk_index"  // Footer metadata key of the chunk index of shared files.
+#define CHAIN_INDEX_LINE_MAX 64  // Maximum length of a line of the chunk index.
+
+// Location of a record batch in an Arrow IPC file (an entry of the file footer).
+typedef struct {
+    int64_t offset;         // File offset of the message.
+    int32_t meta_length;    // Length of the message metadata, including its prefix.
+    int64_t body_length;    // Length of the message body.
+} ChainBlock;
+
+// Writer of MCMC chain samples in the Arrow IPC file format.
+// Samples are buffered by column and written as record batches of `batch_iters` iterations,
+// with one int64 "iteration" column and one float64 column per parameter.
+typedef struct {
+    FILE* fp;
+    char* fname;
+
+    size_t n_params;      // Number of parameters in each sample.
+    char* *param_names;   // Names of the parameters (copied).
+    size_t batch_iters;   // Number of iterations in each record batch.
+
+    size_t n_buffered;    // Number of iterations currently buffered.
+    int64_t next_iter;    // Iteration index of the next sample to be written.
+    int64_t *iter_buf;    // Buffered iteration indices.
+    double *sample_buf;   // Buffered samples, by column: parameter p at [p * batch_iters + i].
+
+    int64_t file_pos;     // Number of bytes written to the file.
+    ChainBlock* blocks;   // Record batches written so far.
+    size_t n_blocks;
+    size_t blocks_capacity;
+
+    SampleRing ring;      // Shared-memory mirror of the latest samples (see mirror_chain_writer), if ring.map.
+
+    DownsampleSidecar sidecar;  // Trace-plot sidecar (see downsample_chain_writer), if sidecar.fname.
+} ChainWriter;
+
+// Index entry of a record batch of a shared chain file: the chain that wrote it and its iterations.
+typedef struct {
+    int32_t chain;
+    int64_t first_iter;
+    int64_t last_iter;      // Inclusive.
+    ChainBlock block;
+} ChainChunk;
+
+// Chunks written by one chain stream. Handed over to the file when the stream is closed.
+typedef struct ChainChunkList{
+    ChainChunk* chunks;
+    size_t n_chunks;
+    size_t capacity;
+    struct ChainChunkList* next;
+} ChainChunkList;
+
+// Arrow IPC chain file written concurrently by several chains (e.g. one per thread), each through
+// its own ChainStream. The record batches have an int32 "chain" column before the "iteration" one.
+// Space for each batch is reserved by an atomic increment of file_pos and written with pwrite, so
+// the streams never wait on each other.
+typedef struct {
+    int fd;
+    char* fname;
+
+    size_t n_params;
+    char* *param_names;
+    size_t batch_iters;
+
+    // Shared by the streams, only accessed with the __atomic builtins.
+    int64_t file_pos;                 // End of the space reserved so far.
+    int n_streams;                    // Streams currently open.
+    ChainChunkList* closed_chunks;    // Chunks of the closed streams.
+} SharedChainFile;
+
+// Buffered output of one chain into a SharedChainFile. Not thread-safe: one stream per thread.
+typedef struct {
+    SharedChainFile* file_p;
+    int32_t chain;        // Chain identifier, written in the "chain" column and the chunk index.
+
+    size_t n_buffered;
+    int64_t next_iter;
+    int32_t *chain_buf;   // The chain identifier, repeated (constant column).
+    int64_t *iter_buf;
+    double *sample_buf;   // By column, as in ChainWriter.
+
+    ChainChunkList* index;  // Record batches written so far.
+    DownsampleSidecar sidecar;  // Trace-plot sidecar (see downsample_chain_stream), if sidecar.fname.
+} ChainStream;
+
+int open_chain_writer(ChainWriter* writer_p, const char* fname, size_t n_params,
+    const char* const* param_names, size_t batch_iters);
+int mirror_chain_writer(ChainWriter* writer_p, const char* shm_name, size_t n_samples);
+int downsample_chain_writer(ChainWriter* writer_p, const char* sidecar_fname, size_t n_points,
+    int64_t update_iters);
+int write_chain_sample(ChainWriter* writer_p, const double* sample);
+int write_chain_samples(ChainWriter* writer_p, const double* samples, size_t n_iter);
+int flush_chain_writer(ChainWriter* writer_p);
+int sync_chain_writer(ChainWriter* writer_p);
+int close_chain_writer(ChainWriter* writer_p);
+MemoryUsage chain_writer_memory(const ChainWriter* writer_p);
+
+int open_shared_chain_file(SharedChainFile* file_p, const char* fname, size_t n_params,
+    const char* const* param_names, size_t batch_iters);
+int close_shared_chain_file(SharedChainFile* file_p);
+int open_chain_stream(ChainStream* stream_p, SharedChainFile* file_p, int32_t chain);
+int downsample_chain_stream(ChainStream* stream_p, const char* sidecar_fname, size_t n_points,
+    int64_t update_iters);
+int write_stream_sample(ChainStream* stream_p, const double* sample);
+int write_stream_samples(ChainStream* stream_p, const double* samples, size_t n_iter);
+int flush_chain_stream(ChainStream* stream_p);
+int close_chain_stream(ChainStream* stream_p);
+MemoryUsage chain_stream_memory(const ChainStream* stream_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,191 @@
+/*
+CRC32C (Castagnoli) checksums of binary data (e.g. the blocks of a bundle), fast enough to run at
+memory bandwidth, so that integrity checks do not cancel out the speed-up of skipping csv parsing.
+
+On x86-64 CPUs with SSE4.2 (selected at run time with the AVX2 variants, see mcmc_cpu.h), the
+crc32 instruction is used on three interleaved streams, which hides its latency; the three partial
+CRCs are then combined with precomputed shift tables. Otherwise, a portable slicing-by-8 table
+implementation is used. Both give the standard CRC32C (crc32c("123456789") == 0xe3069283).
+*/
+
+#include <string.h>
+#include <pthread.h>
+
+#include "mcmc_cpu.h"
+#include "mcmc_checksum.h"
+
+#if defined(CPU_HAVE_AVX2) && (defined(__x86_64__) || defined(_M_X64))
+#define CRC_HARDWARE
+#include <immintrin.h>
+#endif
+
+#define CRC_POLY 0x82f63b78u  // CRC32C polynomial, reflected.
+#define CRC_LONG 8192         // Length, in bytes, of each stream of the long interleaved steps.
+#define CRC_SHORT 256         // Length, in bytes, of each stream of the short interleaved steps.
+
+typedef uint32_t (*crc_func)(uint32_t reg, const unsigned char* data, size_t n_bytes);
+
+static uint32_t crc_table[8][256];    // Slicing-by-8 tables.
+static uint32_t long_shift[4][256];   // Multiplication of a CRC register by x^(8 CRC_LONG).
+static uint32_t short_shift[4][256];  // Multiplication of a CRC register by x^(8 CRC_SHORT).
+static crc_func crc_kernel;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+static uint64_t load_u64(const unsigned char* p){
+    uint64_t v;
+    memcpy(&v, p, sizeof(uint64_t));  // Unaligned load (the data is little-endian on x86).
+    return v;
+}
+
+
+// Product of two polynomials modulo the CRC polynomial (reflected: bit 31 is x^0).
+static uint32_t multiply_mod(uint32_t a, uint32_t b){
+    uint32_t m = 1u << 31;
+    uint32_t product = 0;
+
+    while (m){
+        if (a & m) product ^= b;
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ CRC_POLY : b >> 1;
+    }
+    return product;
+}
+
+
+// Returns x^(8 n_bytes) modulo the CRC polynomial.
+static uint32_t x_pow_8n(size_t n_bytes){
+    uint32_t power = 1u << 31;  // x^0
+    uint32_t square = 1u << 30; // x^1, then x^2, x^4, ...
+    size_t n = 8 * n_bytes;
+
+    while (n){
+        if (n & 1) power = multiply_mod(square, power);
+        square = multiply_mod(square, square);
+        n >>= 1;
+    }
+    return power;
+}
+
+
+// Tables multiplying a register by x^(8 n_bytes), one byte of the register at a time.
+static void build_shift_table(uint32_t table[4][256], size_t n_bytes){
+    uint32_t op = x_pow_8n(n_bytes);
+
+    for (int k = 0; k < 4; k++){
+        for (uint32_t i = 0; i < 256; i++){
+            table[k][i] = multiply_mod(op, i << (8 * k));
+        }
+    }
+}
+
+
+static uint32_t shift(uint32_t table[4][256], uint32_t reg){
+    return table[0][reg & 0xff] ^ table[1][(reg >> 8) & 0xff]
+        ^ table[2][(reg >> 16) & 0xff] ^ table[3][reg >> 24];
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// KERNELS
+// ------------------------------------------------------------------------------------------------
+
+// The kernels update a raw CRC register (without the initial and final inversions).
+
+static uint32_t crc_software(uint32_t reg, const unsigned char* data, size_t n_bytes){
+    while (n_bytes >= 8){
+        uint64_t word = load_u64(data) ^ reg;
+        reg = crc_table[7][word & 0xff] ^ crc_table[6][(word >> 8) & 0xff]
+            ^ crc_table[5][(word >> 16) & 0xff] ^ crc_table[4][(word >> 24) & 0xff]
+            ^ crc_table[3][(word >> 32) & 0xff] ^ crc_table[2][(word >> 40) & 0xff]
+            ^ crc_table[1][(word >> 48) & 0xff] ^ crc_table[0][word >> 56];
+        data += 8;
+        n_bytes -= 8;
+    }
+    while (n_bytes--){
+        reg = (reg >> 8) ^ crc_table[0][(reg ^ *data++) & 0xff];
+    }
+    return reg;
+}
+
+
+#ifdef CRC_HARDWARE
+
+// Processes 3 streams of stream_size bytes, and combines them. Returns the new data pointer.
+CPU_TARGET_AVX2 static const unsigned char* crc_interleaved(uint32_t* reg_p, const unsigned char* data,
+    size_t stream_size, uint32_t table[4][256]){
+    uint64_t reg0 = *reg_p, reg1 = 0, reg2 = 0;
+    const unsigned char* end = data + stream_size;
+
+    for (; data < end; data += 8){
+        reg0 = _mm_crc32_u64(reg0, load_u64(data));
+        reg1 = _mm_crc32_u64(reg1, load_u64(data + stream_size));
+        reg2 = _mm_crc32_u64(reg2, load_u64(data + 2 * stream_size));
+    }
+    *reg_p = shift(table, shift(table, (uint32_t) reg0) ^ (uint32_t) reg1) ^ (uint32_t) reg2;
+    return data + 2 * stream_size;
+}
+
+
+CPU_TARGET_AVX2 static uint32_t crc_sse42(uint32_t reg, const unsigned char* data, size_t n_bytes){
+    const unsigned char* end = data + n_bytes;
+    uint64_t reg64;
+
+    while ((size_t) (end - data) >= 3 * CRC_LONG)
+        data = crc_interleaved(&reg, data, CRC_LONG, long_shift);
+    while ((size_t) (end - data) >= 3 * CRC_SHORT)
+        data = crc_interleaved(&reg, data, CRC_SHORT, short_shift);
+
+    reg64 = reg;
+    for (; end - data >= 8; data += 8){
+        reg64 = _mm_crc32_u64(reg64, load_u64(data));
+    }
+    reg = (uint32_t) reg64;
+    for (; data < end; data++){
+        reg = _mm_crc32_u8(reg, *data);
+    }
+    return reg;
+}
+
+#endif
+
+
+static void resolve_kernels(void){
+    for (uint32_t i = 0; i < 256; i++){
+        uint32_t reg = i;
+        for (int k = 0; k < 8; k++) reg = (reg & 1) ? (reg >> 1) ^ CRC_POLY : reg >> 1;
+        crc_table[0][i] = reg;
+    }
+    for (uint32_t i = 0; i < 256; i++){
+        for (int k = 1; k < 8; k++){
+            crc_table[k][i] = (crc_table[k-1][i] >> 8) ^ crc_table[0][crc_table[k-1][i] & 0xff];
+        }
+    }
+    crc_kernel = crc_software;
+
+#ifdef CRC_HARDWARE
+    if (cpu_isa() >= CPU_ISA_AVX2){
+        build_shift_table(long_shift, CRC_LONG);
+        build_shift_table(short_shift, CRC_SHORT);
+        crc_kernel = crc_sse42;
+    }
+#endif
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Updates a CRC32C with n_bytes of data. Use crc = 0 to start a new checksum; consecutive calls
+give the checksum of the concatenated data.
+*/
+uint32_t crc32c(const void* data, size_t n_bytes, uint32_t crc){
+    pthread_once(&kernels_once, resolve_kernels);
+    return ~crc_kernel(~crc, (const unsigned char*) data, n_bytes);
+}
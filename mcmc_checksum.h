@@ -0,0 +1,17 @@
+#ifndef MCMC_CHECKSUM_H
+#define MCMC_CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t crc32c(const void* data, size_t n_bytes, uint32_t crc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
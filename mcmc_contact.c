@@ -0,0 +1,221 @@
+/*
+Kernels for the products with contact data that dominate the simulation step (e.g. the force of
+infection lambda = beta * C * (I / N), for a contact matrix C).
+
+Each kernel has a double and a single precision (_f32) version. The single precision versions
+process twice as many elements per instruction and read half the bytes, and are meant for
+contact data loaded with read_csv_float_vector. Their sums are accumulated in single precision.
+
+The dot products have scalar, AVX2 (256-bit, with fused multiply-add) and AVX-512 variants,
+selected at run time (see mcmc_cpu.h). Results may differ in the last bits between variants,
+since they sum in a different order.
+*/
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "mcmc_cpu.h"
+#include "mcmc_contact.h"
+
+#ifdef CPU_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+typedef double (*dot_func)(const double* a, const double* b, size_t n);
+typedef float (*dot_f32_func)(const float* a, const float* b, size_t n);
+
+static dot_func dot_kernel;
+static dot_f32_func dot_f32_kernel;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+
+// ------------------------------------------------------------------------------------------------
+// KERNELS
+// ------------------------------------------------------------------------------------------------
+
+static double dot_scalar(const double* a, const double* b, size_t n){
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++){
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+
+static float dot_f32_scalar(const float* a, const float* b, size_t n){
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++){
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+
+#ifdef CPU_HAVE_AVX2
+
+// Sum of the 4 lanes of a vector of doubles.
+CPU_TARGET_AVX2 static double hsum_pd(__m256d v){
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+// Sum of the 8 lanes of a vector of floats.
+CPU_TARGET_AVX2 static float hsum_ps(__m256 v){
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    return _mm_cvtss_f32(_mm_add_ss(s, _mm_movehdup_ps(s)));
+}
+
+
+CPU_TARGET_AVX2 static double dot_avx2(const double* a, const double* b, size_t n){
+    // Two accumulators hide the latency of the additions.
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), acc1);
+    }
+    for (; i + 4 <= n; i += 4){
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+    }
+    return hsum_pd(_mm256_add_pd(acc0, acc1)) + dot_scalar(a + i, b + i, n - i);
+}
+
+
+CPU_TARGET_AVX2 static float dot_f32_avx2(const float* a, const float* b, size_t n){
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16){
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8){
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    return hsum_ps(_mm256_add_ps(acc0, acc1)) + dot_f32_scalar(a + i, b + i, n - i);
+}
+
+#endif
+
+
+#ifdef CPU_HAVE_AVX512
+
+// The tails (fewer elements than a vector) are handled with masked loads.
+CPU_TARGET_AVX512 static double dot_avx512(const double* a, const double* b, size_t n){
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16){
+        acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc0);
+        acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8){
+        acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc0);
+    }
+    if (i < n){
+        __mmask8 tail = (__mmask8) ((1u << (n - i)) - 1);
+        acc1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tail, a + i), _mm512_maskz_loadu_pd(tail, b + i), acc1);
+    }
+    return _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1));
+}
+
+
+CPU_TARGET_AVX512 static float dot_f32_avx512(const float* a, const float* b, size_t n){
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32){
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i + 16 <= n; i += 16){
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+    }
+    if (i < n){
+        __mmask16 tail = (__mmask16) ((1u << (n - i)) - 1);
+        acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, a + i), _mm512_maskz_loadu_ps(tail, b + i), acc1);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+#endif
+
+
+static void resolve_kernels(void){
+    dot_kernel = dot_scalar;
+    dot_f32_kernel = dot_f32_scalar;
+
+    switch (cpu_isa()){
+    case CPU_ISA_AVX512:
+#ifdef CPU_HAVE_AVX512
+        dot_kernel = dot_avx512;
+        dot_f32_kernel = dot_f32_avx512;
+        break;
+#endif
+    case CPU_ISA_AVX2:
+#ifdef CPU_HAVE_AVX2
+        dot_kernel = dot_avx2;
+        dot_f32_kernel = dot_f32_avx2;
+#endif
+        break;
+    case CPU_ISA_SCALAR:
+        break;
+    }
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Returns the dot product of two vectors of doubles of size n.
+*/
+double contact_dot(const double* a, const double* b, size_t n){
+    pthread_once(&kernels_once, resolve_kernels);
+    return dot_kernel(a, b, n);
+}
+
+
+/*
+Returns the dot product of two vectors of floats of size n.
+*/
+float contact_dot_f32(const float* a, const float* b, size_t n){
+    pthread_once(&kernels_once, resolve_kernels);
+    return dot_f32_kernel(a, b, n);
+}
+
+
+/*
+Computes y = scale * C x, for a contact matrix C stored in row-major order.
+
+@param contacts  Matrix C, with n_rows x n_cols elements.
+@param x  Vector with n_cols elements (e.g. the prevalence I / N of each group).
+@param scale  Factor applied to the product (e.g. the transmission rate beta).
+@param y  Output vector with n_rows elements. Must not overlap the inputs.
+*/
+void contact_matvec(const double* contacts, size_t n_rows, size_t n_cols, const double* x,
+    double scale, double* y){
+    pthread_once(&kernels_once, resolve_kernels);
+    for (size_t i = 0; i < n_rows; i++){
+        y[i] = scale * dot_kernel(contacts + i * n_cols, x, n_cols);
+    }
+}
+
+
+/*
+Single precision version of contact_matvec.
+*/
+void contact_matvec_f32(const float* contacts, size_t n_rows, size_t n_cols, const float* x,
+    float scale, float* y){
+    pthread_once(&kernels_once, resolve_kernels);
+    for (size_t i = 0; i < n_rows; i++){
+        y[i] = scale * dot_f32_kernel(contacts + i * n_cols, x, n_cols);
+    }
+}
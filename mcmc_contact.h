@@ -0,0 +1,22 @@
+#ifndef MCMC_CONTACT_H
+#define MCMC_CONTACT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+double contact_dot(const double* a, const double* b, size_t n);
+float contact_dot_f32(const float* a, const float* b, size_t n);
+
+void contact_matvec(const double* contacts, size_t n_rows, size_t n_cols, const double* x,
+    double scale, double* y);
+void contact_matvec_f32(const float* contacts, size_t n_rows, size_t n_cols, const float* x,
+    float scale, float* y);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,100 @@
+/*
+Run-time selection of the SIMD kernel variants, so that a single binary uses the best path on
+each node (e.g. AVX-512 or AVX2) without recompiling.
+
+The instruction set is detected once, with cpuid (through __builtin_cpu_supports, which also
+checks that the OS saves the vector registers). The modules with vector kernels resolve function
+pointers from cpu_isa() on first use. For testing, the variant can be forced with the MCMC_ISA
+environment variable (scalar, avx2 or avx512); variants not supported by the CPU are refused.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "mcmc_cpu.h"
+
+static CpuIsa supported_isa = CPU_ISA_SCALAR;
+static CpuIsa selected_isa = CPU_ISA_SCALAR;
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+
+static const char* isa_names[] = {"scalar", "avx2", "avx512"};
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+// Most capable variant that is both compiled in and supported by the CPU.
+static CpuIsa detect_isa(void){
+#ifdef CPU_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2")
+        && __builtin_cpu_supports("fma"))
+        return CPU_ISA_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return CPU_ISA_AVX2;
+    return CPU_ISA_SCALAR;
+#elif defined(CPU_HAVE_AVX512)
+    return CPU_ISA_AVX512;
+#elif defined(CPU_HAVE_AVX2)
+    return CPU_ISA_AVX2;
+#else
+    return CPU_ISA_SCALAR;
+#endif
+}
+
+
+static void detect(void){
+    const char* forced = getenv(CPU_ISA_ENV);
+
+    supported_isa = selected_isa = detect_isa();
+    if (!forced || !*forced) return;
+
+    for (int isa = CPU_ISA_SCALAR; isa <= CPU_ISA_AVX512; isa++){
+        if (strcmp(forced, isa_names[isa]) == 0){
+            if ((CpuIsa) isa > supported_isa)
+                fprintf(stderr, "%s=%s is not supported by this CPU, using %s.\n",
+                    CPU_ISA_ENV, forced, isa_names[supported_isa]);
+            else
+                selected_isa = (CpuIsa) isa;
+            return;
+        }
+    }
+    fprintf(stderr, "Unknown %s=%s (expected scalar, avx2 or avx512), using %s.\n",
+        CPU_ISA_ENV, forced, isa_names[supported_isa]);
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Returns the kernel variant to use: the most capable one supported, unless forced (to a supported
+one) by the MCMC_ISA environment variable. Detected on the first call; the variable is only read
+then.
+*/
+CpuIsa cpu_isa(void){
+    pthread_once(&detect_once, detect);
+    return selected_isa;
+}
+
+
+/*
+Returns the most capable kernel variant supported by the CPU (and compiled in).
+*/
+CpuIsa cpu_isa_supported(void){
+    pthread_once(&detect_once, detect);
+    return supported_isa;
+}
+
+
+/*
+Returns the name of a kernel variant, as accepted by MCMC_ISA.
+*/
+const char* cpu_isa_name(CpuIsa isa){
+    if (isa < CPU_ISA_SCALAR || isa > CPU_ISA_AVX512) return "unknown";
+    return isa_names[isa];
+}
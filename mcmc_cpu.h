@@ -0,0 +1,47 @@
+#ifndef MCMC_CPU_H
+#define MCMC_CPU_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CPU_ISA_ENV "MCMC_ISA"  // Environment variable forcing a kernel variant (scalar, avx2, avx512).
+
+// Instruction set of the kernel variants, from least to most capable.
+typedef enum {
+    CPU_ISA_SCALAR = 0,  // Portable C.
+    CPU_ISA_AVX2 = 1,    // AVX2 and FMA.
+    CPU_ISA_AVX512 = 2   // AVX-512F (with AVX2 and FMA).
+} CpuIsa;
+
+/*
+Kernel variants. With GCC or Clang on x86, every variant is compiled (with target attributes,
+so no -m flags are needed) and selected at run time. Elsewhere, only the variants enabled by
+the compiler flags are available.
+*/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_DISPATCH
+#define CPU_HAVE_AVX2
+#define CPU_HAVE_AVX512
+#define CPU_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define CPU_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#else
+#if defined(__AVX2__) && defined(__FMA__)
+#define CPU_HAVE_AVX2
+#endif
+#if defined(__AVX512F__) && defined(CPU_HAVE_AVX2)
+#define CPU_HAVE_AVX512
+#endif
+#define CPU_TARGET_AVX2
+#define CPU_TARGET_AVX512
+#endif
+
+CpuIsa cpu_isa(void);
+CpuIsa cpu_isa_supported(void);
+const char* cpu_isa_name(CpuIsa isa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
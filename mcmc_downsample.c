@@ -0,0 +1,422 @@
+/*
+Streaming downsample of MCMC chains for trace plots, written to a small sidecar file.
+
+The chain is split into blocks of consecutive iterations, for which the minimum, maximum and mean
+of each parameter are kept. When the number of blocks reaches max_blocks (twice the number of
+points), adjacent blocks are merged in pairs and the block length doubles, so the memory is fixed
+and the blocks always cover the whole chain, whatever its length.
+
+The downsample of each parameter is then computed as in MinMaxLTTB (Van Der Donckt et al., 2023):
+the Largest-Triangle-Three-Buckets algorithm is run over the minimum and maximum points of the
+blocks, plus the first and last samples, instead of over all the samples. With 2-4 candidates per
+output point, the result is very close to LTTB over the full chain.
+
+The sidecar is a CSV file with one row per point of the downsample and per block envelope:
+
+    kind,param,first_iter,last_iter,value,min,max
+    lttb,beta,1024,1024,0.4132,0.4132,0.4132
+    envelope,beta,0,2047,0.4518,0.3902,0.5127
+
+where value is the sample (lttb rows) or the block mean (envelope rows).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "mcmc_downsample.h"
+#include "mcmc_trace.h"
+
+#define DOWNSAMPLE_MIN_POINTS 3  // LTTB keeps the first and last points, plus one per bucket.
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+static void reset_block(BlockStats* s){
+    s->min = INFINITY;
+    s->max = -INFINITY;
+    s->sum = 0;
+    s->min_iter = s->max_iter = 0;
+}
+
+
+static void merge_block(BlockStats* dst, const BlockStats* a, const BlockStats* b){
+    BlockStats merged = *a;
+
+    if (b->min < merged.min){
+        merged.min = b->min;
+        merged.min_iter = b->min_iter;
+    }
+    if (b->max > merged.max){
+        merged.max = b->max;
+        merged.max_iter = b->max_iter;
+    }
+    merged.sum += b->sum;
+    *dst = merged;
+}
+
+
+// Merges the complete blocks in pairs (max_blocks is even), doubling the block length.
+static void merge_blocks(Downsample* ds){
+    size_t n = ds->n_blocks / 2;
+
+    for (size_t p = 0; p < ds->n_params; p++){
+        BlockStats* blocks = ds->blocks + p * ds->max_blocks;
+        for (size_t b = 0; b < n; b++) merge_block(blocks + b, blocks + 2 * b, blocks + 2 * b + 1);
+    }
+    for (size_t b = 0; b < n; b++){
+        ds->first_iter[b] = ds->first_iter[2 * b];
+        ds->last_iter[b] = ds->last_iter[2 * b + 1];
+    }
+    ds->n_blocks = n;
+    ds->block_iters *= 2;
+}
+
+
+// Appends a point to the candidates, unless it repeats the last one.
+static void push_candidate(int64_t* x, double* y, size_t* n_p, int64_t iter, double value){
+    if (*n_p > 0 && x[*n_p - 1] == iter) return;
+    x[*n_p] = iter;
+    y[*n_p] = value;
+    (*n_p)++;
+}
+
+
+/*
+Collects the LTTB candidates of parameter p, in iteration order: the first sample, the minimum and
+maximum of each block (including the current one), and the last sample. Blocks with no extremes
+(all their values are NaN) give no candidates.
+*/
+static size_t collect_candidates(const Downsample* ds, size_t p, int64_t* x, double* y){
+    const BlockStats* blocks = ds->blocks + p * ds->max_blocks;
+    const BlockStats* s;
+    size_t n = 0;
+
+    push_candidate(x, y, &n, ds->start_iter, ds->start[p]);
+    for (size_t b = 0; b <= ds->n_blocks; b++){
+        if (b == ds->n_blocks && ds->n_current == 0) break;
+        s = (b < ds->n_blocks) ? blocks + b : ds->current + p;
+
+        if (s->min > s->max) continue;
+        if (s->min_iter <= s->max_iter){
+            push_candidate(x, y, &n, s->min_iter, s->min);
+            push_candidate(x, y, &n, s->max_iter, s->max);
+        }
+        else{
+            push_candidate(x, y, &n, s->max_iter, s->max);
+            push_candidate(x, y, &n, s->min_iter, s->min);
+        }
+    }
+    push_candidate(x, y, &n, ds->end_iter, ds->end[p]);
+    return n;
+}
+
+
+/*
+Largest-Triangle-Three-Buckets: selects n_out of the n points (n > n_out >= 3), keeping the first
+and last. The other points are split into n_out - 2 buckets, and from each bucket the point
+forming the largest triangle with the previous selected point and the mean of the next bucket is
+selected. The indices of the selected points are written to out.
+*/
+static void lttb(const int64_t* x, const double* y, size_t n, size_t n_out, size_t* out){
+    double every = (double) (n - 2) / (double) (n_out - 2);
+    double avg_x, avg_y, area, max_area;
+    size_t a = 0;  // Previous selected point
+    size_t start, end, next_end;
+
+    out[0] = 0;
+    for (size_t i = 0; i < n_out - 2; i++){
+        start = (size_t) (i * every) + 1;
+        end = (size_t) ((i + 1) * every) + 1;
+        next_end = (size_t) ((i + 2) * every) + 1;
+        if (next_end > n) next_end = n;
+
+        avg_x = avg_y = 0;
+        for (size_t j = end; j < next_end; j++){
+            avg_x += (double) x[j];
+            avg_y += y[j];
+        }
+        avg_x /= (double) (next_end - end);
+        avg_y /= (double) (next_end - end);
+
+        max_area = -1;
+        out[i + 1] = start;
+        for (size_t j = start; j < end; j++){
+            area = fabs(((double) x[a] - avg_x) * (y[j] - y[a]) - ((double) x[a] - (double) x[j]) * (avg_y - y[a]));
+            if (area > max_area){
+                max_area = area;
+                out[i + 1] = j;
+            }
+        }
+        a = out[i + 1];
+    }
+    out[n_out - 1] = n - 1;
+}
+
+
+// Writes the rows of parameter p: the downsample, then the block envelopes (except all-NaN blocks).
+static void write_param_rows(FILE* fp, const Downsample* ds, size_t p, const char* name,
+    int64_t* x, double* y, size_t* selected){
+
+    const BlockStats* blocks = ds->blocks + p * ds->max_blocks;
+    size_t n = collect_candidates(ds, p, x, y);
+    size_t n_out = (n > ds->n_points) ? ds->n_points : n;
+    size_t k;
+
+    if (n > ds->n_points) lttb(x, y, n, n_out, selected);
+    for (size_t i = 0; i < n_out; i++){
+        k = (n > ds->n_points) ? selected[i] : i;
+        fprintf(fp, "lttb,%s,%lld,%lld,%.10g,%.10g,%.10g\n", name, (long long) x[k], (long long) x[k],
+            y[k], y[k], y[k]);
+    }
+
+    for (size_t b = 0; b < ds->n_blocks; b++){
+        if (blocks[b].min > blocks[b].max) continue;
+        fprintf(fp, "envelope,%s,%lld,%lld,%.10g,%.10g,%.10g\n", name, (long long) ds->first_iter[b],
+            (long long) ds->last_iter[b], blocks[b].sum / (double) ds->block_iters, blocks[b].min, blocks[b].max);
+    }
+    if (ds->n_current > 0 && ds->current[p].min <= ds->current[p].max){
+        const BlockStats* s = ds->current + p;
+        fprintf(fp, "envelope,%s,%lld,%lld,%.10g,%.10g,%.10g\n", name,
+            (long long) (ds->end_iter - ds->n_current + 1), (long long) ds->end_iter,
+            s->sum / (double) ds->n_current, s->min, s->max);
+    }
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Initializes an empty downsample.
+
+@param ds_p  Pointer to a Downsample struct, which is initialized.
+@param n_params  Number of parameters in each sample.
+@param n_points  Number of points of the downsample of each parameter (at least 3). The
+    envelopes have between n_points and 2 * n_points blocks.
+
+@return An integer error code.
+*/
+int init_downsample(Downsample* ds_p, size_t n_params, size_t n_points){
+    memset(ds_p, 0, sizeof(Downsample));
+    if (n_points < DOWNSAMPLE_MIN_POINTS){
+        fprintf(stderr, "Invalid number of downsample points (%zu) @ init_downsample.\n", n_points);
+        return EXIT_FAILURE;
+    }
+
+    ds_p->n_params = n_params;
+    ds_p->n_points = n_points;
+    ds_p->max_blocks = 2 * n_points;
+    ds_p->block_iters = 1;
+
+    ds_p->first_iter = (int64_t*) malloc(ds_p->max_blocks * sizeof(int64_t));
+    ds_p->last_iter = (int64_t*) malloc(ds_p->max_blocks * sizeof(int64_t));
+    ds_p->blocks = (BlockStats*) malloc(n_params * ds_p->max_blocks * sizeof(BlockStats));
+    ds_p->current = (BlockStats*) malloc(n_params * sizeof(BlockStats));
+    ds_p->start = (double*) malloc(n_params * sizeof(double));
+    ds_p->end = (double*) malloc(n_params * sizeof(double));
+    if (!ds_p->first_iter || !ds_p->last_iter
+        || (n_params && (!ds_p->blocks || !ds_p->current || !ds_p->start || !ds_p->end))){
+        fprintf(stderr, "Failed to allocate downsample buffers @ init_downsample.\n");
+        free_downsample(ds_p);
+        return EXIT_FAILURE;
+    }
+    track_memory(ds_p->first_iter, ds_p->max_blocks * sizeof(int64_t), MEMORY_HEAP);
+    track_memory(ds_p->last_iter, ds_p->max_blocks * sizeof(int64_t), MEMORY_HEAP);
+    track_memory(ds_p->blocks, n_params * ds_p->max_blocks * sizeof(BlockStats), MEMORY_HEAP);
+
+    for (size_t p = 0; p < n_params; p++) reset_block(ds_p->current + p);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Adds one sample (n_params values), with a constant cost per parameter. Iterations must increase.
+*/
+void add_downsample_sample(Downsample* ds_p, int64_t iter, const double* sample){
+    BlockStats* s;
+
+    if (ds_p->n_iter++ == 0){
+        ds_p->start_iter = iter;
+        memcpy(ds_p->start, sample, ds_p->n_params * sizeof(double));
+    }
+    ds_p->end_iter = iter;
+    memcpy(ds_p->end, sample, ds_p->n_params * sizeof(double));
+
+    for (size_t p = 0; p < ds_p->n_params; p++){
+        s = ds_p->current + p;
+        if (sample[p] < s->min){
+            s->min = sample[p];
+            s->min_iter = iter;
+        }
+        if (sample[p] > s->max){
+            s->max = sample[p];
+            s->max_iter = iter;
+        }
+        s->sum += sample[p];
+    }
+
+    if (ds_p->n_current++ == 0) ds_p->first_iter[ds_p->n_blocks] = iter;
+    if (ds_p->n_current < ds_p->block_iters) return;
+
+    // Completes the block
+    ds_p->last_iter[ds_p->n_blocks] = iter;
+    for (size_t p = 0; p < ds_p->n_params; p++){
+        ds_p->blocks[p * ds_p->max_blocks + ds_p->n_blocks] = ds_p->current[p];
+        reset_block(ds_p->current + p);
+    }
+    ds_p->n_current = 0;
+    if (++ds_p->n_blocks == ds_p->max_blocks) merge_blocks(ds_p);
+}
+
+
+/*
+Writes the downsample and block envelopes of all parameters to a CSV sidecar (see the format at
+the top of this file). The file is written under a temporary name, synced and renamed, so that
+readers never see a partial file, even when it is rewritten while the chain runs or after a crash.
+
+@param param_names  Names of the parameters, as in the chain file.
+
+@return An integer error code.
+*/
+int write_downsample(const Downsample* ds_p, const char* fname, const char* const* param_names){
+    size_t max_candidates = 2 * (ds_p->n_blocks + 1) + 2;
+    int64_t* x = (int64_t*) malloc(max_candidates * sizeof(int64_t));
+    double* y = (double*) malloc(max_candidates * sizeof(double));
+    size_t* selected = (size_t*) malloc(ds_p->n_points * sizeof(size_t));
+    char* tmp_fname = (char*) malloc(strlen(fname) + 5);
+    TraceSpan span;
+    FILE* fp;
+    int status = EXIT_SUCCESS;
+
+    if (!x || !y || !selected || !tmp_fname){
+        fprintf(stderr, "Failed to allocate downsample buffers @ write_downsample.\n");
+        free(x); free(y); free(selected); free(tmp_fname);
+        return EXIT_FAILURE;
+    }
+    strcpy(tmp_fname, fname);
+    strcat(tmp_fname, ".tmp");
+
+    fp = fopen(tmp_fname, "w");
+    if (!fp){
+        fprintf(stderr, "Failed to open %s: \"%s\"\n", tmp_fname, strerror(errno));
+        free(x); free(y); free(selected); free(tmp_fname);
+        return EXIT_FAILURE;
+    }
+
+    span = trace_begin("downsample", "write_downsample");
+    fprintf(fp, "kind,param,first_iter,last_iter,value,min,max\n");
+    for (size_t p = 0; ds_p->n_iter > 0 && p < ds_p->n_params; p++){
+        write_param_rows(fp, ds_p, p, param_names[p], x, y, selected);
+    }
+
+    if (fflush(fp) || ferror(fp) || fsync(fileno(fp))){
+        fprintf(stderr, "Failed to write to %s: \"%s\"\n", tmp_fname, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    if (fclose(fp) && status == EXIT_SUCCESS){
+        fprintf(stderr, "Failed to close %s: \"%s\"\n", tmp_fname, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    if (status == EXIT_SUCCESS && rename(tmp_fname, fname)){
+        fprintf(stderr, "Failed to rename %s: \"%s\"\n", tmp_fname, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    if (status != EXIT_SUCCESS) unlink(tmp_fname);
+    trace_end(span);
+
+    free(x); free(y); free(selected); free(tmp_fname);
+    return status;
+}
+
+
+void free_downsample(Downsample* ds_p){
+    untrack_memory(ds_p->first_iter);
+    untrack_memory(ds_p->last_iter);
+    untrack_memory(ds_p->blocks);
+    free(ds_p->first_iter); ds_p->first_iter = NULL;
+    free(ds_p->last_iter); ds_p->last_iter = NULL;
+    free(ds_p->blocks); ds_p->blocks = NULL;
+    free(ds_p->current); ds_p->current = NULL;
+    free(ds_p->start); ds_p->start = NULL;
+    free(ds_p->end); ds_p->end = NULL;
+    ds_p->n_blocks = 0;
+    ds_p->n_current = ds_p->n_iter = 0;
+}
+
+
+/*
+Starts keeping a downsample for a sidecar, replacing the previous one of sidecar_p, if any.
+
+@param sidecar_p  Pointer to a DownsampleSidecar struct, zero-initialized or previously opened.
+@param fname, suffix  Path of the sidecar, as the concatenation of both (copied).
+@param n_points  Number of points of the downsample of each parameter.
+@param update_iters  Iterations between rewrites of the sidecar. 0 to write it only at close.
+@param next_iter  Iteration of the next sample of the chain.
+
+@return An integer error code. On failure, no sidecar is kept.
+*/
+int open_downsample_sidecar(DownsampleSidecar* sidecar_p, const char* fname, const char* suffix,
+    size_t n_params, size_t n_points, int64_t update_iters, int64_t next_iter){
+
+    free_downsample_sidecar(sidecar_p);
+
+    sidecar_p->fname = (char*) malloc(strlen(fname) + strlen(suffix) + 1);
+    if (!sidecar_p->fname){
+        fprintf(stderr, "Failed to allocate sidecar name @ open_downsample_sidecar.\n");
+        return EXIT_FAILURE;
+    }
+    strcpy(sidecar_p->fname, fname);
+    strcat(sidecar_p->fname, suffix);
+
+    if (init_downsample(&sidecar_p->ds, n_params, n_points)){
+        free(sidecar_p->fname); sidecar_p->fname = NULL;
+        return EXIT_FAILURE;
+    }
+    sidecar_p->update_iters = (update_iters > 0) ? update_iters : 0;
+    sidecar_p->due = next_iter + sidecar_p->update_iters;
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Rewrites the sidecar if update_iters iterations have passed since the last rewrite. Meant to be
+called once the samples up to next_iter are written, so the sidecar is never ahead of the chain.
+
+@return An integer error code (EXIT_SUCCESS if the sidecar is not due).
+*/
+int update_downsample_sidecar(DownsampleSidecar* sidecar_p, int64_t next_iter,
+    const char* const* param_names){
+
+    if (!sidecar_p->fname || sidecar_p->update_iters == 0 || next_iter < sidecar_p->due)
+        return EXIT_SUCCESS;
+    sidecar_p->due = next_iter + sidecar_p->update_iters;
+    return write_downsample(&sidecar_p->ds, sidecar_p->fname, param_names);
+}
+
+
+void free_downsample_sidecar(DownsampleSidecar* sidecar_p){
+    if (sidecar_p->fname) free_downsample(&sidecar_p->ds);
+    free(sidecar_p->fname); sidecar_p->fname = NULL;
+}
+
+
+/*
+Returns the memory held by a downsample (heap). It is fixed by the number of points: the resident
+bytes are those of the blocks filled so far.
+*/
+MemoryUsage downsample_memory(const Downsample* ds_p){
+    size_t block_bytes = 2 * sizeof(int64_t) + ds_p->n_params * sizeof(BlockStats);
+    MemoryUsage usage = {0, 0, MEMORY_HEAP};
+
+    if (!ds_p->blocks) return usage;
+    usage.resident = ds_p->n_blocks * block_bytes;
+    usage.capacity = ds_p->max_blocks * block_bytes;
+    return usage;
+}
@@ -0,0 +1,64 @@
+#ifndef MCMC_DOWNSAMPLE_H
+#define MCMC_DOWNSAMPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "mcmc_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Extremes and sum of one parameter over a block of iterations.
+typedef struct {
+    double min, max, sum;
+    int64_t min_iter, max_iter;
+} BlockStats;
+
+// Streaming summary of a chain for trace plots: block min/max envelopes, from which a
+// Largest-Triangle-Three-Buckets downsample of each parameter is computed (see mcmc_downsample.c).
+typedef struct {
+    size_t n_params;
+    size_t n_points;        // Number of points of the downsample of each parameter.
+    size_t max_blocks;      // Blocks are merged in pairs when this number is reached.
+    int64_t block_iters;    // Iterations per block (doubles at each merge).
+
+    size_t n_blocks;        // Complete blocks.
+    int64_t *first_iter;    // First and last iteration of each block.
+    int64_t *last_iter;
+    BlockStats *blocks;     // Parameter p, block b at [p * max_blocks + b].
+
+    int64_t n_current;      // Iterations in the current (incomplete) block.
+    BlockStats *current;    // Current block, one per parameter.
+
+    int64_t n_iter;         // Samples added.
+    int64_t start_iter, end_iter;  // First and last iteration added.
+    double *start, *end;    // First and last sample (kept by LTTB).
+} Downsample;
+
+// Downsample of a running chain, kept by a chain writer and rewritten to a CSV sidecar (see
+// downsample_chain_writer, downsample_chain_stream and downsample_rolling_chain_writer).
+typedef struct {
+    Downsample ds;
+    char* fname;            // Path of the sidecar, or NULL if none is kept.
+    int64_t update_iters;   // Iterations between rewrites of the sidecar (0: only at close).
+    int64_t due;            // Iteration after which the sidecar is rewritten next.
+} DownsampleSidecar;
+
+int init_downsample(Downsample* ds_p, size_t n_params, size_t n_points);
+void add_downsample_sample(Downsample* ds_p, int64_t iter, const double* sample);
+int write_downsample(const Downsample* ds_p, const char* fname, const char* const* param_names);
+void free_downsample(Downsample* ds_p);
+MemoryUsage downsample_memory(const Downsample* ds_p);
+
+int open_downsample_sidecar(DownsampleSidecar* sidecar_p, const char* fname, const char* suffix,
+    size_t n_params, size_t n_points, int64_t update_iters, int64_t next_iter);
+int update_downsample_sidecar(DownsampleSidecar* sidecar_p, int64_t next_iter,
+    const char* const* param_names);
+void free_downsample_sidecar(DownsampleSidecar* sidecar_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,64 @@
+/*
+Access to datasets compiled into the binary.
+
+Sources with embedded datasets are generated at build time by mcmc_embed_gen, e.g.:
+    ./mcmc_embed_gen embedded_data.c vector:contacts=contacts.csv ili:ili=ILI.csv
+The generated file defines one EmbeddedDataset per input (embedded_<name>) and the NULL-terminated
+table `embedded_datasets`. The data is exposed through the same view types as loaded data, with
+no file access or parsing at run time.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcmc_embed.h"
+
+
+/*
+Finds a dataset by name in a NULL-terminated table of embedded datasets.
+
+@return Pointer to the dataset, or NULL if there is no dataset with the given name.
+*/
+const EmbeddedDataset* find_embedded_dataset(const EmbeddedDataset* const* table, const char* name){
+    for (; *table; table++){
+        if (strcmp((*table)->name, name) == 0) return *table;
+    }
+    return NULL;
+}
+
+
+/*
+Gives a read-only view of an embedded ILI dataset.
+
+@return An integer error code. Fails if the dataset does not hold ILI data.
+*/
+int embedded_ili_view(const EmbeddedDataset* dataset_p, ILIview* view_p){
+    if (dataset_p->kind != EMBED_ILI){
+        fprintf(stderr, "Embedded dataset \"%s\" does not hold ILI data.\n", dataset_p->name);
+        return EXIT_FAILURE;
+    }
+
+    view_p->size = dataset_p->size;
+    view_p->year = dataset_p->year;
+    view_p->week = dataset_p->week;
+    view_p->estInc = dataset_p->estInc;
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Gives a read-only view of an embedded vector of doubles.
+
+@return An integer error code. Fails if the dataset does not hold a vector of doubles.
+*/
+int embedded_double_view(const EmbeddedDataset* dataset_p, DoubleView* view_p){
+    if (dataset_p->kind != EMBED_DOUBLE_VECTOR){
+        fprintf(stderr, "Embedded dataset \"%s\" does not hold a double vector.\n", dataset_p->name);
+        return EXIT_FAILURE;
+    }
+
+    view_p->size = dataset_p->size;
+    view_p->data = dataset_p->values;
+    return EXIT_SUCCESS;
+}
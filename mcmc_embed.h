@@ -0,0 +1,43 @@
+#ifndef MCMC_EMBED_H
+#define MCMC_EMBED_H
+
+#include <stddef.h>
+#include "mcmc_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EMBED_ALIGNMENT 64  // Alignment, in bytes, of the embedded arrays.
+
+// Kind of data held by an embedded dataset.
+typedef enum {
+    EMBED_ILI = 1,            // ILI data, as read with read_ili_csv.
+    EMBED_DOUBLE_VECTOR = 2   // Vector of doubles, as read with read_csv_double_vector.
+} EmbeddedKind;
+
+// Dataset compiled into the binary, as generated by mcmc_embed_gen from a csv file.
+typedef struct {
+    const char* name;     // Name given to the dataset at generation.
+    const char* source;   // Path of the csv file it was generated from.
+    EmbeddedKind kind;
+    size_t size;          // Number of rows.
+
+    const int *year;      // ILI columns (EMBED_ILI only).
+    const int *week;
+    const int *estInc;
+    const double *values; // Vector data (EMBED_DOUBLE_VECTOR only).
+} EmbeddedDataset;
+
+// NULL-terminated table of the datasets defined by a source generated with mcmc_embed_gen.
+extern const EmbeddedDataset* const embedded_datasets[];
+
+const EmbeddedDataset* find_embedded_dataset(const EmbeddedDataset* const* table, const char* name);
+int embedded_ili_view(const EmbeddedDataset* dataset_p, ILIview* view_p);
+int embedded_double_view(const EmbeddedDataset* dataset_p, DoubleView* view_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
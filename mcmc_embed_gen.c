@@ -0,0 +1,181 @@
+/*
+Build-time tool that converts csv inputs into a C source with embedded datasets (see mcmc_embed.h).
+
+Usage:
+    mcmc_embed_gen <output.c> <kind>:<name>=<file.csv> [<kind>:<name>=<file.csv> ...]
+
+where <kind> is "ili" (read with read_ili_csv) or "vector" (read with read_csv_double_vector), and
+<name> is a valid C identifier. Each input becomes a dataset `embedded_<name>`, and all of them are
+listed in the NULL-terminated table `embedded_datasets`.
+The csv files are parsed with the same readers (and the same error checks) used at run time.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "mcmc_io.h"
+#include "mcmc_embed.h"
+
+#define VALUES_PER_LINE 8  // Number of array elements written in each line of the generated source.
+
+
+// Checks that a dataset name can be used as part of a C identifier.
+static int is_identifier(const char* s){
+    if (!*s || isdigit((unsigned char) *s)) return 0;
+    for (; *s; s++){
+        if (!isalnum((unsigned char) *s) && *s != '_') return 0;
+    }
+    return 1;
+}
+
+
+// Writes a string literal, escaping quotes and backslashes.
+static void write_string_literal(FILE* out, const char* s){
+    fputc('"', out);
+    for (; *s; s++){
+        if (*s == '"' || *s == '\\') fputc('\\', out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+
+static void write_int_array(FILE* out, const char* name, const char* column, const int* data, size_t size){
+    fprintf(out, "static _Alignas(EMBED_ALIGNMENT) const int embedded_%s_%s[] = {", name, column);
+    for (size_t i = 0; i < size; i++){
+        fprintf(out, "%s%d,", (i % VALUES_PER_LINE) ? " " : "\n    ", data[i]);
+    }
+    fprintf(out, "%s};\n\n", size ? "\n" : "0");  // Empty initializers are not valid C.
+}
+
+
+static void write_double_array(FILE* out, const char* name, const double* data, size_t size){
+    fprintf(out, "static _Alignas(EMBED_ALIGNMENT) const double embedded_%s_values[] = {", name);
+    for (size_t i = 0; i < size; i++){
+        fputs((i % VALUES_PER_LINE) ? " " : "\n    ", out);
+        if (isnan(data[i])) fputs("NAN,", out);
+        else if (isinf(data[i])) fputs(data[i] > 0 ? "INFINITY," : "-INFINITY,", out);
+        else fprintf(out, "%.17g,", data[i]);  // 17 significant digits reproduce the double exactly.
+    }
+    fprintf(out, "%s};\n\n", size ? "\n" : "0");
+}
+
+
+// Reads one csv input and writes its arrays and dataset struct.
+static int write_dataset(FILE* out, const char* kind, const char* name, const char* fname){
+    fprintf(out, "// %s:%s, from %s\n", kind, name, fname);
+
+    if (strcmp(kind, "ili") == 0){
+        ILIinput data = {};
+
+        if (read_ili_csv(fname, &data)){
+            free_ili_input(&data);
+            return EXIT_FAILURE;
+        }
+        write_int_array(out, name, "year", data.year, data.size);
+        write_int_array(out, name, "week", data.week, data.size);
+        write_int_array(out, name, "estInc", data.estInc, data.size);
+
+        fprintf(out, "const EmbeddedDataset embedded_%s = {\"%s\", ", name, name);
+        write_string_literal(out, fname);
+        fprintf(out, ", EMBED_ILI, %zu,\n    embedded_%s_year, embedded_%s_week, embedded_%s_estInc, NULL};\n\n",
+            data.size, name, name, name);
+        free_ili_input(&data);
+    }
+    else if (strcmp(kind, "vector") == 0){
+        double* vec = NULL;
+        size_t size = 0;
+
+        if (read_csv_double_vector(fname, &vec, &size)){
+            free_csv_vector(vec);
+            return EXIT_FAILURE;
+        }
+        write_double_array(out, name, vec, size);
+
+        fprintf(out, "const EmbeddedDataset embedded_%s = {\"%s\", ", name, name);
+        write_string_literal(out, fname);
+        fprintf(out, ", EMBED_DOUBLE_VECTOR, %zu,\n    NULL, NULL, NULL, embedded_%s_values};\n\n", size, name);
+        free_csv_vector(vec);
+    }
+    else{
+        fprintf(stderr, "Unknown dataset kind \"%s\" (expected \"ili\" or \"vector\").\n", kind);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+int main(int argc, char *argv[])
+{
+    FILE* out;
+    char* *names;
+    int n_inputs = argc - 2;
+    int status = EXIT_SUCCESS;
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <output.c> <kind>:<name>=<file.csv> [...]\n"
+            "  kind: \"ili\" or \"vector\"\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    names = (char**) calloc(n_inputs, sizeof(char*));
+    if (!names){
+        fprintf(stderr, "Failed to allocate dataset names.\n");
+        return EXIT_FAILURE;
+    }
+
+    out = fopen(argv[1], "w");
+    if (!out) {
+        fprintf(stderr, "Failed to open %s for writing.\n", argv[1]);
+        free(names);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(out, "// Generated by mcmc_embed_gen. Do not edit.\n\n");
+    fprintf(out, "#include <stddef.h>\n#include <math.h>\n#include \"mcmc_embed.h\"\n\n");
+
+    // Datasets. Each argument has the form kind:name=path, and is split in place.
+    for (int i = 0; i < n_inputs && status == EXIT_SUCCESS; i++){
+        char* kind = argv[i + 2];
+        char* name = strchr(kind, ':');
+        char* fname = name ? strchr(name, '=') : NULL;
+
+        if (!name || !fname){
+            fprintf(stderr, "Invalid input \"%s\" (expected <kind>:<name>=<file.csv>).\n", kind);
+            status = EXIT_FAILURE;
+            break;
+        }
+        *name++ = '\0';
+        *fname++ = '\0';
+
+        if (!is_identifier(name)){
+            fprintf(stderr, "Dataset name \"%s\" is not a valid C identifier.\n", name);
+            status = EXIT_FAILURE;
+            break;
+        }
+        names[i] = name;
+        status = write_dataset(out, kind, name, fname);
+    }
+
+    // Table of datasets
+    if (status == EXIT_SUCCESS){
+        fprintf(out, "const EmbeddedDataset* const embedded_datasets[] = {\n");
+        for (int i = 0; i < n_inputs; i++){
+            fprintf(out, "    &embedded_%s,\n", names[i]);
+        }
+        fprintf(out, "    NULL\n};\n");
+    }
+
+    if (fclose(out) || status){
+        fprintf(stderr, "Failed to generate %s.\n", argv[1]);
+        remove(argv[1]);
+        status = EXIT_FAILURE;
+    }
+
+    free(names);
+    return status;
+}
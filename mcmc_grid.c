@@ -0,0 +1,151 @@
+/*
+Epiweek arithmetic and gap filling for dense weekly grids of ILI data (see read_ili_csv_dense).
+
+Epiweeks follow the MMWR convention: weeks run from Sunday to Saturday, and week 1 of a year is
+the first week with at least four days in that year (i.e., the week of January 4th). Years have
+52 or 53 weeks accordingly.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "mcmc_grid.h"
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+// Number of days from 1970-01-01 to a date of the proleptic Gregorian calendar.
+static long days_from_civil(int year, int month, int day){
+    long y = (month <= 2) ? (long) year - 1 : year;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+
+// Ordinal (see epiweek_ordinal) of week 1 of the year whose January 4th is the given day.
+static long week1_ordinal(long jan4){
+    long dow = ((jan4 + 4) % 7 + 7) % 7;  // Day of the week (0 = Sunday). 1970-01-01 was a Thursday.
+    long week1_start = jan4 - dow;         // Sunday that starts week 1.
+
+    return (week1_start + 4) / 7;  // Exact division, as week1_start + 4 is a multiple of 7.
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Returns the ordinal of an epiweek: consecutive epiweeks have consecutive ordinals, across years.
+The epiweek starting on Sunday 1969-12-28 (1969-W53) has ordinal 0.
+*/
+long epiweek_ordinal(int year, int week){
+    return week1_ordinal(days_from_civil(year, 1, 4)) + (long) week - 1;
+}
+
+
+/*
+Returns the ordinal (see epiweek_ordinal) of the epiweek that contains a date.
+*/
+long epiweek_ordinal_of_date(int year, int month, int day){
+    long days = days_from_civil(year, month, day) + 4;  // Days since Sunday 1969-12-28.
+    return (days >= 0) ? days / 7 : -((-days + 6) / 7);  // Rounds down.
+}
+
+
+/*
+Converts an epiweek ordinal (see epiweek_ordinal) back to (year, week). The year of an epiweek
+is the year of its Wednesday, which holds the majority of its days.
+*/
+void epiweek_of_ordinal(long ordinal, int* year_p, int* week_p){
+    long wednesday = ordinal * 7 - 1;  // Days since 1970-01-01 (ordinal 0 starts on day -4).
+    int year = 1970 + (int) (wednesday / 365);
+
+    while (days_from_civil(year, 1, 1) > wednesday) year--;
+    while (days_from_civil(year + 1, 1, 1) <= wednesday) year++;
+
+    *year_p = year;
+    *week_p = (int) (ordinal - epiweek_ordinal(year, 1)) + 1;
+}
+
+
+/*
+Returns the number of epiweeks (52 or 53) of a year. Valid for any int year (year + 1 is not
+computed, so INT_MAX does not overflow).
+*/
+int epiweeks_in_year(int year){
+    long jan4 = days_from_civil(year, 1, 4);
+    int leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+
+    return (int) (week1_ordinal(jan4 + (leap ? 366 : 365)) - week1_ordinal(jan4));
+}
+
+
+/*
+Advances (year, week) to the following epiweek.
+*/
+void next_epiweek(int* year_p, int* week_p){
+    if (++(*week_p) > epiweeks_in_year(*year_p)){
+        (*year_p)++;
+        *week_p = 1;
+    }
+}
+
+
+/*
+Fills n missing weeks of dense ILI data, at rows pos ... pos + n - 1, starting at epiweek
+(year, week). left_p and right_p point to the estInc of the observed neighbours, and are NULL
+at the edges of the grid. The filled rows are marked as invalid, with no source row.
+*/
+void fill_ili_gap(ILIinput* data_p, ILIgrid* grid_p, size_t pos, size_t n, int year, int week,
+    const int* left_p, const int* right_p, GapPolicy policy){
+
+    for (size_t k = 0; k < n; k++){
+        size_t i = pos + k;
+        int value = 0;
+
+        switch (policy){
+        case GAP_FILL_ZERO:
+            break;
+
+        case GAP_FILL_PREVIOUS:
+            if (left_p) value = *left_p;
+            else if (right_p) value = *right_p;
+            break;
+
+        case GAP_FILL_LINEAR:
+            if (left_p && right_p)
+                value = (int) lround((double) *left_p
+                    + ((double) *right_p - (double) *left_p) * (double) (k + 1) / (double) (n + 1));
+            else if (left_p) value = *left_p;
+            else if (right_p) value = *right_p;
+            break;
+        }
+
+        data_p->year[i] = year;
+        data_p->week[i] = week;
+        data_p->estInc[i] = value;
+        grid_p->valid[i] = 0;
+        grid_p->source[i] = ILI_NO_SOURCE;
+        next_epiweek(&year, &week);
+    }
+    grid_p->n_missing += n;
+}
+
+
+/*
+Frees the arrays of an ILIgrid struct. Sets its pointers to NULL.
+*/
+void free_ili_grid(ILIgrid* grid_p){
+    untrack_memory(grid_p->valid);
+    untrack_memory(grid_p->source);
+    free(grid_p->valid); grid_p->valid = NULL;
+    free(grid_p->source); grid_p->source = NULL;
+    grid_p->n_missing = 0;
+}
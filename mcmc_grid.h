@@ -0,0 +1,24 @@
+#ifndef MCMC_GRID_H
+#define MCMC_GRID_H
+
+#include <stddef.h>
+#include "mcmc_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int epiweeks_in_year(int year);
+long epiweek_ordinal(int year, int week);
+long epiweek_ordinal_of_date(int year, int month, int day);
+void epiweek_of_ordinal(long ordinal, int* year_p, int* week_p);
+void next_epiweek(int* year_p, int* week_p);
+
+void fill_ili_gap(ILIinput* data_p, ILIgrid* grid_p, size_t pos, size_t n, int year, int week,
+    const int* left_p, const int* right_p, GapPolicy policy);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
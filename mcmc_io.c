@@ -1,9 +1,30 @@
 /* 
 Toolset for data input/output (io) for the Influenza MCMC project.
 
-v1.01 (2022-06-07) – Removes the requirement for exactly 4 columns. Columns to the right are ignored.
+v1.09 (2026-10-18) – Vectors returned by the csv vector readers are registered in the memory registry;
+   adds free_csv_vector, which releases them. Adds read_ili_csv_crc and read_csv_double_vector_crc,
+   which also return the CRC32C of the file, computed on each chunk as it is read.
 
 Version history
+v1.08 (2026-10-18) – Loads (count, failures, bytes, duration) are recorded in the live metrics page,
+   if one is open (see mcmc_metrics.h).
+v1.07 (2026-10-18) – Loaded ILI data and dense grids are registered in the memory registry (see
+   mcmc_memory.h) until freed. Adds ili_input_memory.
+v1.06 (2026-10-18) – Adds read_ili_csv_dense, which fills the weeks missing from the file as the rows are
+   parsed, returning a dense weekly grid with a validity mask and the mapping to the source rows.
+v1.05 (2026-10-18) – Adds read_ili_csv_checked, which checks ranges and the continuity of the epiweeks
+   as the rows are parsed (see mcmc_validate.h), reporting invalid rows individually.
+v1.04 (2026-10-18) – Adds read_csv_double_vector_tf and read_csv_float_vector_tf, which apply transform
+   steps (affine, log, log1p, clamp, user function; see mcmc_transform.h) to the values as they are parsed.
+v1.03 (2026-10-18) – 64-bit clean: vector sizes are size_t (read_csv_double_vector now takes a size_t*),
+   so inputs beyond 2^31 rows are supported. Output columns grow on the heap (large arrays are moved
+   without copies) and are trimmed in place, instead of being copied out of the arena. Stale errno
+   values no longer cause false overflow errors.
+v1.02 (2026-10-18) – Transient parsing state (libcsv buffer, growing columns, error fields) is served by
+   a per-load arena, released at once; output arrays are allocated once with their exact size. The last
+   row is parsed even without a final line terminator. Outputs are left empty if reading fails.
+   Adds read_csv_float_vector, which stores single-column data in single precision.
+v1.01 (2022-06-07) – Removes the requirement for exactly 4 columns. Columns to the right are ignored.
 v1.00 (2022-06-01) – First release. Dynamically expands the vector as data is read. Checks for data 
    integrity while parsing (overflow, number of fields, conversion to integer).
 
@@ -18,9 +39,17 @@ v0.01 (2022-05-26) – Development version. Performs the basic reading without c
 #include "libcsv/csv.h"
 
 #include "mcmc_io.h"
+#include "mcmc_arena.h"
+#include "mcmc_checksum.h"
+#include "mcmc_transform.h"
+#include "mcmc_validate.h"
+#include "mcmc_grid.h"
+#include "mcmc_trace.h"
+#include "mcmc_metrics.h"
 
 #define FILE_NUM_COLS 4  // Expected number of columns in the file.
-#define FILE_BUF_SIZE 1024  // Size, in bytes, of the chunks of the file that are read at each input operation.
+#define FILE_BUF_SIZE 65536  // Size, in bytes, of the chunks of the file that are read at each input operation.
+#define LOAD_ARENA_SIZE 16384  // Size, in bytes, of the stack buffer used as first block of the load arena.
 
 
 // ------------------------------------------------------------------------------------------------
@@ -29,40 +58,69 @@ v0.01 (2022-05-26) – Development version. Performs the basic reading without c
 
 // Auxiliary struct with extra variables to help on the file parsing.
 typedef struct ILIinputAux{
-    ILIinput* data_p;
+    ILIinput* data_p;  // Columns being parsed, moved to the output if reading succeeds.
+    Arena* arena_p;    // Arena of the load, for all transient allocations.
 
     size_t capacity;  // Assured number of allocated positions in each vector.
     size_t curr_row;  // Row index (1-based) currently being read.
     size_t curr_col;  // Column index (1-based) currently being read.
     
     int err_status;   // Error code for inner parsing errors (i.e., during callback)
-    char* err_field;  // Stores the value of the faulty field.
+    const char* err_field;  // Stores the value of the faulty field.
+
+    const ILIvalidation* rules_p;  // Checks applied to the parsed rows (may be NULL).
+    size_t n_validated;  // Number of leading rows already checked.
+    size_t n_invalid;    // Number of rows that failed the checks.
+    size_t n_reported;   // Number of invalid rows reported so far.
+
+    ILIgrid* grid_p;     // Dense grid being built, or NULL if not requested.
+    GapPolicy gap_policy;
+    size_t n_source;     // Number of data rows read from the file.
+    long prev_ordinal;   // Epiweek ordinal of the last row placed on the grid.
+    long start_ordinal, end_ordinal;  // Bounds of the grid (LONG_MIN/LONG_MAX if taken from the file).
+    int start_year, start_week;       // First epiweek of the grid, if given.
+    size_t max_gap;      // Longest run of missing weeks filled between two rows.
 
 } ILIinputAux;
 
 
+// Storage type of a vector read from file.
+typedef enum {
+    COLUMN_DOUBLE,
+    COLUMN_FLOAT   // Single precision, converted directly from the text with correct rounding.
+} ColumnType;
+
 typedef struct ColumnInputAux{
     // Data
-    int *size_p;  // Pointer to the size of the data.
-    double* *vec_p;  // Pointer to the data vector.
+    size_t *size_p;  // Pointer to the size of the data.
+    void* *vec_p;  // Pointer to the data vector.
+    ColumnType type;  // Type of the elements of the vector.
+    const ColumnTransform* transforms;  // Transform steps applied to the values (may be NULL).
+    size_t n_transforms;
+    size_t n_transformed;  // Number of leading values already transformed.
 
     // Aux variables
+    Arena* arena_p;   // Arena of the load, for all transient allocations.
     size_t capacity;  // Assured number of allocated positions in the vector.
     size_t curr_row;  // Row index (1-based) currently being read.
     size_t curr_col;  // Column index (1-based) currently being read.
     
     int err_status;   // Error code for inner parsing errors (i.e., during callback)
-    char* err_field;  // Stores the value of the faulty field.
+    const char* err_field;  // Stores the value of the faulty field.
 } ColumnInputAux;
 
 
-#define PARSE_EINVALID 4  // Update this number when new error codes are included.
+#define PARSE_EINVALID 9  // Update this number when new error codes are included.
 static char *parse_errors[] = 
     /* 0 */{"success",
     /* 1 */ "could not convert string to int",
     /* 2 */ "value is out of range for int",
     /* 3 */ "line has too many fields",
     /* 4 */ "previous line has not enough fields",
+    /* 5 */ "could not allocate memory",
+    /* 6 */ "rows are not in increasing epiweek order",
+    /* 7 */ "week does not exist in its year",
+    /* 8 */ "too many weeks missing before this row (see ILIgridOptions.max_gap)",
     /*...*/ "invalid status code"};
 
 char* cb_err_str(int err_status){
@@ -74,13 +132,14 @@ char* cb_err_str(int err_status){
     }
 }
 
-#define PARSE_EINVALID_DOUBLE 4  // Update this number when new error codes are included.
+#define PARSE_EINVALID_DOUBLE 5  // Update this number when new error codes are included.
 static char *parse_errors_double[] = 
     /* 0 */{"success",
     /* 1 */ "could not convert string to double",
     /* 2 */ "value is out of range for double",
     /* 3 */ "line has too many fields",
     /* 4 */ "previous line has not enough fields",
+    /* 5 */ "could not allocate memory",
     /*...*/ "invalid status code"};
 
 char* cb_err_str_double(int err_status){
@@ -92,8 +151,98 @@ char* cb_err_str_double(int err_status){
     }
 }
 
+#define PARSE_EINVALID_FLOAT 5  // Update this number when new error codes are included.
+static char *parse_errors_float[] = 
+    /* 0 */{"success",
+    /* 1 */ "could not convert string to float",
+    /* 2 */ "value is out of range for float",
+    /* 3 */ "line has too many fields",
+    /* 4 */ "previous line has not enough fields",
+    /* 5 */ "could not allocate memory",
+    /*...*/ "invalid status code"};
+
+char* cb_err_str_float(int err_status){
+    if (err_status >= PARSE_EINVALID_FLOAT || err_status < 0){
+        return parse_errors_float[PARSE_EINVALID_FLOAT];
+    }
+    else{
+        return parse_errors_float[err_status];
+    }
+}
+
 // --------------
 
+// Thread-local arena used by the libcsv allocation hooks, which have no user data argument.
+static _Thread_local Arena* csv_arena = NULL;
+
+static void* csv_arena_realloc(void* ptr, size_t n_bytes){
+    return arena_realloc(csv_arena, ptr, n_bytes);
+}
+
+static void csv_arena_free(void* ptr){
+    (void) ptr;  // Released at once with the arena.
+}
+
+
+// Size, in bytes, of an element of a vector of the given type.
+static size_t column_elem_size(ColumnType type){
+    return (type == COLUMN_FLOAT) ? sizeof(float) : sizeof(double);
+}
+
+
+// Checks the ILI rows parsed since the last call, while still in cache.
+static void validate_parsed(ILIinputAux* aux_p){
+    size_t end = aux_p->data_p->size;
+
+    TraceSpan span;
+
+    if (!aux_p->rules_p || end == aux_p->n_validated) return;
+
+    span = trace_begin("io", "validate");
+    aux_p->n_invalid += validate_ili_rows(aux_p->data_p, aux_p->n_validated, end, aux_p->rules_p,
+        &aux_p->n_reported);
+    aux_p->n_validated = end;
+    trace_end(span);
+}
+
+
+// Applies the column transforms to the values parsed since the last call, while still in cache.
+static void transform_parsed(ColumnInputAux* aux_p){
+    size_t start = aux_p->n_transformed;
+    size_t n = *(aux_p->size_p) - start;
+    TraceSpan span;
+
+    if (!aux_p->n_transforms || !n) return;
+
+    span = trace_begin("io", "transform");
+    if (aux_p->type == COLUMN_FLOAT)
+        apply_transforms_f32((float*) *(aux_p->vec_p) + start, n, aux_p->transforms, aux_p->n_transforms);
+    else
+        apply_transforms((double*) *(aux_p->vec_p) + start, n, aux_p->transforms, aux_p->n_transforms);
+    aux_p->n_transformed += n;
+    trace_end_bytes(span, n * column_elem_size(aux_p->type));
+}
+
+
+// Reads the next chunk of a file into buf (traced), updating the CRC32C of the file if crc_p is
+// not NULL. Returns the number of bytes read.
+static size_t read_chunk(char* buf, FILE* fp, uint32_t* crc_p){
+    TraceSpan span = trace_begin("io", "read");
+    size_t bytes_read = fread(buf, 1, FILE_BUF_SIZE, fp);
+    if (crc_p) *crc_p = crc32c(buf, bytes_read, *crc_p);
+    trace_end_bytes(span, bytes_read);
+    return bytes_read;
+}
+
+
+// Copies a string into the arena (used to store faulty fields for error reporting).
+static char* arena_strdup(Arena* arena_p, const char* s){
+    char* copy = (char*) arena_alloc(arena_p, strlen(s) + 1);
+    if (copy) strcpy(copy, s);
+    return copy;
+}
+
+
 int alloc_ili_input(ILIinput* data_p, size_t reserve_size){
     data_p->year =   (int*) malloc(reserve_size * sizeof(int));
     data_p->week =   (int*) malloc(reserve_size * sizeof(int));
@@ -102,21 +251,27 @@ int alloc_ili_input(ILIinput* data_p, size_t reserve_size){
 
     if (!data_p->year || !data_p->week || !data_p->estInc){
         fprintf(stderr, "Failed to allocate ILIinput struct data.");
+        free_ili_input(data_p);
         return 1;
     }
     return 0;
 }
 
 
+/*
+Resizes the arrays of an ILIinput struct. On failure, the previous arrays are kept (and must
+still be freed). Large arrays are moved by the system allocator without copying (e.g. mremap).
+*/
 int realloc_ili_input(ILIinput* data_p, size_t new_capacity){
+    int* *columns[3] = {&data_p->year, &data_p->week, &data_p->estInc};
 
-    data_p->year =   (int*) realloc(data_p->year, new_capacity * sizeof(int));
-    data_p->week =   (int*) realloc(data_p->week, new_capacity * sizeof(int));
-    data_p->estInc = (int*) realloc(data_p->estInc, new_capacity * sizeof(int));
-
-    if (!data_p->year || !data_p->week || !data_p->estInc){
-        fprintf(stderr, "Failed to reallocate ILIinput struct data.");
-        return 1;
+    for (int i = 0; i < 3; i++){
+        int* tmp = (int*) realloc(*columns[i], new_capacity * sizeof(int));
+        if (!tmp){
+            fprintf(stderr, "Failed to reallocate ILIinput struct data.");
+            return 1;
+        }
+        *columns[i] = tmp;
     }
     return 0;
 }
@@ -127,6 +282,9 @@ Frees the dynamically allocated arrays for the ILIinput struct.
 Sets its pointers to NULL and its size to 0.
 */
 void free_ili_input(ILIinput* data_p){
+    untrack_memory(data_p->year);
+    untrack_memory(data_p->week);
+    untrack_memory(data_p->estInc);
     free(data_p->year); data_p->year = NULL;
     free(data_p->week); data_p->week = NULL;
     free(data_p->estInc); data_p->estInc = NULL;
@@ -134,6 +292,14 @@ void free_ili_input(ILIinput* data_p){
 }
 
 
+// Registers the arrays of a loaded ILIinput in the memory registry (see mcmc_memory.h).
+static void track_ili_input(const ILIinput* data_p){
+    track_memory(data_p->year, data_p->size * sizeof(int), MEMORY_HEAP);
+    track_memory(data_p->week, data_p->size * sizeof(int), MEMORY_HEAP);
+    track_memory(data_p->estInc, data_p->size * sizeof(int), MEMORY_HEAP);
+}
+
+
 static int is_space(unsigned char c) {
     if (c == CSV_SPACE || c == CSV_TAB) return 1;
     return 0;
@@ -156,13 +322,14 @@ int parse_int_error_check(const char* str, int *err_p, size_t len){
 
     char *cursor;
     long tmp;
-    long pdif;
+    size_t pdif;
 
-    // Parse to long int (10 = base)
+    // Parse to long int (10 = base). errno is only set on failure, so it is reset before.
+    errno = 0;
     tmp = strtol(str, &cursor, 10);
 
     // Check if reading succeeded and if it ended at expected size
-    pdif = cursor - str;  // Number of characters effectively parsed.
+    pdif = (size_t) (cursor - str);  // Number of characters effectively parsed.
     if (pdif != len){
         *err_p = 1;  // Could not convert string to int
         return 0;
@@ -189,11 +356,12 @@ double parse_double_error_check(const char* str, int *err_p, size_t len){
     char *cursor;
     double out;
 
-    // Parsing command
+    // Parsing command. errno is only set on failure, so it is reset before.
+    errno = 0;
     out = strtod(str, &cursor);
 
     // Error checking
-    if ((cursor - str) != len){  // Number of parsed character was not the expected
+    if ((size_t) (cursor - str) != len){  // Number of parsed character was not the expected
         *err_p = 1; 
         return 0.0;
     }
@@ -207,11 +375,172 @@ double parse_double_error_check(const char* str, int *err_p, size_t len){
 }
 
 
+float parse_float_error_check(const char* str, int *err_p, size_t len){
+    /* 
+    Parses a string into a float with the same error checks as parse_double_error_check.
+    The conversion is made directly from the text by strtof, so the result is correctly rounded
+    (converting through a double could round twice).
+    */
+    char *cursor;
+    float out;
+
+    // Parsing command. errno is only set on failure, so it is reset before.
+    errno = 0;
+    out = strtof(str, &cursor);
+
+    // Error checking
+    if ((size_t) (cursor - str) != len){  // Number of parsed character was not the expected
+        *err_p = 1; 
+        return 0.0f;
+    }
+
+    if (errno == ERANGE){  // Parsed number is out of range for float
+        *err_p = 2;
+        return 0.0f;
+    }
+
+    return out;
+}
+
+
 
 // ------------------------------------------------------------------------------------------------
 // PARSING CALLBACK FUNCTIONS – ILI INPUT
 // ------------------------------------------------------------------------------------------------
 
+// Grows the columns being parsed (and the grid arrays, if any) to new_capacity rows.
+static int grow_ili_aux(ILIinputAux* aux_p, size_t new_capacity){
+    ILIgrid* grid_p = aux_p->grid_p;
+
+    if (realloc_ili_input(aux_p->data_p, new_capacity)) return 1;
+
+    if (grid_p){
+        unsigned char* valid = (unsigned char*) realloc(grid_p->valid, new_capacity);
+        if (valid) grid_p->valid = valid;
+        size_t* source = (size_t*) realloc(grid_p->source, new_capacity * sizeof(size_t));
+        if (source) grid_p->source = source;
+        if (!valid || !source) return 1;
+    }
+
+    aux_p->capacity = new_capacity;
+    return 0;
+}
+
+
+// Registers an error of the dense grid at the current row, reported as an error of the week field.
+static void set_grid_error(ILIinputAux* aux_p, int err_status, int year, int week){
+    char field[32];
+
+    snprintf(field, sizeof(field), "%d-W%02d", year, week);
+    aux_p->err_status = err_status;
+    aux_p->err_field = arena_strdup(aux_p->arena_p, field);
+    aux_p->curr_col = 3;
+}
+
+
+/*
+Places the row just parsed (at index size) on the dense grid, filling the weeks missing between
+it and the previous row (or the start of the grid). Returns 1 if the row is outside the bounds
+of the grid and must be dropped.
+*/
+static int place_grid_row(ILIinputAux* aux_p){
+    ILIinput* data_p = aux_p->data_p;
+    ILIgrid* grid_p = aux_p->grid_p;
+    size_t pos = data_p->size;
+    size_t source = aux_p->n_source++;
+    int year = data_p->year[pos], week = data_p->week[pos];
+    int gap_year, gap_week;  // First missing epiweek.
+    long ordinal;
+    size_t gap;
+
+    if (week < 1 || week > epiweeks_in_year(year)){
+        set_grid_error(aux_p, 7, year, week);  // week does not exist in its year
+        return 0;
+    }
+
+    ordinal = epiweek_ordinal(year, week);
+    if (ordinal < aux_p->start_ordinal || ordinal > aux_p->end_ordinal) return 1;
+
+    if (pos == 0){
+        // Leading gap, if the grid starts before the first row.
+        gap = (aux_p->start_ordinal == LONG_MIN) ? 0 : (size_t) (ordinal - aux_p->start_ordinal);
+        gap_year = aux_p->start_year;
+        gap_week = aux_p->start_week;
+    }
+    else {
+        if (ordinal <= aux_p->prev_ordinal){
+            set_grid_error(aux_p, 6, year, week);  // rows are not in increasing epiweek order
+            return 0;
+        }
+        gap = (size_t) (ordinal - aux_p->prev_ordinal - 1);
+        gap_year = data_p->year[pos - 1];
+        gap_week = data_p->week[pos - 1];
+        next_epiweek(&gap_year, &gap_week);
+    }
+
+    if (gap > aux_p->max_gap){
+        set_grid_error(aux_p, 8, year, week);  // too many weeks missing (e.g. a wrong year)
+        return 0;
+    }
+
+    if (gap){
+        // Move the row after the gap, then fill the gap.
+        if (pos + gap >= aux_p->capacity
+            && grow_ili_aux(aux_p, (2 * aux_p->capacity > pos + gap) ? 2 * aux_p->capacity : pos + gap + 1)){
+            set_grid_error(aux_p, 5, year, week);  // could not allocate memory
+            return 0;
+        }
+        data_p->year[pos + gap] = year;
+        data_p->week[pos + gap] = week;
+        data_p->estInc[pos + gap] = data_p->estInc[pos];
+
+        fill_ili_gap(data_p, grid_p, pos, gap, gap_year, gap_week,
+            pos ? &data_p->estInc[pos - 1] : NULL, &data_p->estInc[pos + gap], aux_p->gap_policy);
+        pos += gap;
+        data_p->size = pos;
+    }
+
+    grid_p->valid[pos] = 1;
+    grid_p->source[pos] = source;
+    aux_p->prev_ordinal = ordinal;
+    return 0;
+}
+
+
+// Fills the trailing gap, if the grid ends after the last row.
+static void finish_grid(ILIinputAux* aux_p){
+    ILIinput* data_p = aux_p->data_p;
+    size_t pos = data_p->size;
+    int gap_year, gap_week;
+    size_t gap;
+
+    if (aux_p->end_ordinal == LONG_MAX) return;
+
+    if (pos){
+        gap = (size_t) (aux_p->end_ordinal - aux_p->prev_ordinal);
+        gap_year = data_p->year[pos - 1];
+        gap_week = data_p->week[pos - 1];
+        next_epiweek(&gap_year, &gap_week);
+    }
+    else if (aux_p->start_ordinal != LONG_MIN){  // No rows in the grid: all weeks are missing.
+        gap = (size_t) (aux_p->end_ordinal - aux_p->start_ordinal + 1);
+        gap_year = aux_p->start_year;
+        gap_week = aux_p->start_week;
+    }
+    else return;
+
+    if (!gap) return;
+    if (pos + gap >= aux_p->capacity && grow_ili_aux(aux_p, pos + gap + 1)){
+        aux_p->err_status = 5;  // could not allocate memory
+        aux_p->err_field = "";
+        return;
+    }
+    fill_ili_gap(data_p, aux_p->grid_p, pos, gap, gap_year, gap_week,
+        pos ? &data_p->estInc[pos - 1] : NULL, NULL, aux_p->gap_policy);
+    data_p->size += gap;
+}
+
+
 /* 
 Callback function for each field that is read from file.
 */
@@ -251,8 +580,7 @@ void cb1 (void *s_v, size_t len, void *aux_vp) {
 
     // If there was an error, registers the field for later reporting.
     if (aux_p->err_status){
-        aux_p->err_field = (char*) malloc(len + 1 * sizeof(char));
-        strcpy(aux_p->err_field, s);
+        aux_p->err_field = arena_strdup(aux_p->arena_p, s);
         return;  // Prevents curr_col from being updated.
     }
     
@@ -267,25 +595,35 @@ void cb2 (int c, void *aux_vp) {
     ILIinputAux* aux_p = (ILIinputAux*) aux_vp;
     ILIinput* data_p = aux_p->data_p;
 
+    int drop = 0;
+
     if (aux_p->err_status) return;  // Do not operate if there was a parsing error.
 
     // Check for the number of fields
     if (aux_p->curr_col - 1 < FILE_NUM_COLS && aux_p->curr_row > 1){  // -1 as it was previously incremented
         aux_p->err_status = 4;  // previous line has not enough fields
-        aux_p->err_field = (char*) malloc(2 * sizeof(char));
-        strcpy(aux_p->err_field, "");
+        aux_p->err_field = "";
+    }
+
+    // Place the row on the dense grid, if requested (may fill missing weeks before it).
+    if (aux_p->grid_p && aux_p->curr_row > 1 && !aux_p->err_status){
+        drop = place_grid_row(aux_p);
+        if (aux_p->err_status) return;  // Cursors stay at the faulty row, for reporting.
     }
 
     // Update cursors
     aux_p->curr_col = 1;
     if (aux_p->curr_row++ == 1) return;  // Update current row AND ignore if it's the first one.
+    if (drop) return;  // Row outside the bounds of the grid.
 
     data_p->size++;  // If line was valid, increments the size of data containers.
 
     // Dynamical vector reallocation (doubles capacity if needed).
     if (data_p->size >= aux_p->capacity){
-        aux_p->capacity *= 2;
-        realloc_ili_input(data_p, aux_p->capacity);
+        if (grow_ili_aux(aux_p, 2 * aux_p->capacity)){
+            aux_p->err_status = 5;  // could not allocate memory
+            aux_p->err_field = "";
+        }
     }
 }
 
@@ -299,8 +637,8 @@ void contacts_cb1(void *s_v, size_t len, void *aux_vp){
     // Convert void pointers to meaningful types
     char* s = (char*) s_v;
     ColumnInputAux* aux_p = (ColumnInputAux*) aux_vp;
-    double* *vec_p = aux_p->vec_p;
-    int size = *(aux_p->size_p);
+    void* vec = *(aux_p->vec_p);
+    size_t size = *(aux_p->size_p);
 
     if (aux_p->curr_row == 1) return;  // Ignore first row of the file
     if (aux_p->err_status) return;  // Do not parse if an error occurred before
@@ -313,7 +651,10 @@ void contacts_cb1(void *s_v, size_t len, void *aux_vp){
         break;
 
     case 2:
-        (*vec_p)[size] = parse_double_error_check(s, &aux_p->err_status, len);
+        if (aux_p->type == COLUMN_FLOAT)
+            ((float*) vec)[size] = parse_float_error_check(s, &aux_p->err_status, len);
+        else
+            ((double*) vec)[size] = parse_double_error_check(s, &aux_p->err_status, len);
         break;
     
     default:
@@ -323,8 +664,7 @@ void contacts_cb1(void *s_v, size_t len, void *aux_vp){
 
     // If there was an error, registers the field for later reporting.
     if (aux_p->err_status){
-        aux_p->err_field = (char*) malloc(len + 1 * sizeof(char));
-        strcpy(aux_p->err_field, s);
+        aux_p->err_field = arena_strdup(aux_p->arena_p, s);
         return;  // Prevents curr_col from being updated.
     }
     
@@ -335,16 +675,15 @@ void contacts_cb1(void *s_v, size_t len, void *aux_vp){
 void contacts_cb2(int c, void *aux_vp){
     // Convert void pointers to meaningful types
     ColumnInputAux* aux_p = (ColumnInputAux*) aux_vp;
-    double* *vec_p = aux_p->vec_p;
-    int *size_p = aux_p->size_p;
+    void* *vec_p = aux_p->vec_p;
+    size_t *size_p = aux_p->size_p;
 
     if (aux_p->err_status) return;  // Do not operate if there was a parsing error.
 
     // Check for the number of fields
     if (aux_p->curr_col - 1 < 2 && aux_p->curr_row > 1){  // -1 as it was previously incremented
         aux_p->err_status = 4;  // previous line has not enough fields
-        aux_p->err_field = (char*) malloc(2 * sizeof(char));
-        strcpy(aux_p->err_field, "");
+        aux_p->err_field = "";
     }
 
     // Update cursors
@@ -356,7 +695,12 @@ void contacts_cb2(int c, void *aux_vp){
     // Dynamical vector reallocation (doubles capacity if needed).
     if (*size_p >= aux_p->capacity){
         aux_p->capacity *= 2;
-        *vec_p = (double*) realloc(*vec_p, aux_p->capacity * sizeof(double));
+        void* tmp = realloc(*vec_p, aux_p->capacity * column_elem_size(aux_p->type));
+        if (tmp) *vec_p = tmp;
+        else {
+            aux_p->err_status = 5;  // could not allocate memory
+            aux_p->err_field = "";
+        }
     }
 }
 
@@ -367,52 +711,109 @@ void contacts_cb2(int c, void *aux_vp){
 
 
 /* 
-Reads a csv file with ILI data. 
-
-Assumes that the file has the following 4 columns:
-"index", "year","week","est_Inc"
-
-Where the first column ("index") is ignored. 
-The first row of the file is assumed as header and is also ignored.
-
-
-@param fname  Path for the csv file. Must be a null-terminated string.
-@param data_p   Pointer to an ILIinput struct, to which the data is written.
-
-@return An integer error code.
+Reads a csv file with ILI data, optionally checking each chunk of parsed rows against rules_p
+and placing the rows on a dense weekly grid (if grid_p is given). The CRC32C of the file is
+written to crc_p, if not NULL. Common implementation of the ILI readers; func_name is the name
+of the caller, for error messages.
 */
-int read_ili_csv(const char* fname, ILIinput* data_p){
+static int read_ili(const char* fname, ILIinput* data_p, const ILIvalidation* rules_p,
+    ILIgrid* grid_p, const ILIgridOptions* grid_opts_p, uint32_t* crc_p, const char* func_name){
 
     // Declarations
     // ------------
-    FILE *fp;
+    FILE *fp = NULL;
     struct csv_parser parser;
+    int parser_ready = 0;
     char buf[FILE_BUF_SIZE];
     size_t bytes_read;
     unsigned char options = 0;
     const size_t reserve_size = 53;  // Initial size of the ILI vectors.
     ILIinputAux aux = {};
+    ILIinput parsed = {};  // Columns being parsed.
+    ILIgrid grid = {};     // Dense grid being built, if requested.
+    Arena arena;
+    _Alignas(ARENA_ALIGNMENT) unsigned char arena_buf[LOAD_ARENA_SIZE];
+    Arena* prev_arena = csv_arena;
+    TraceSpan load_span = trace_begin("io", func_name), span;
+    uint64_t load_start = metrics_load_begin();
+    size_t total_bytes = 0;
+    int status = EXIT_FAILURE;
 
     // Initialization
     // --------------
+
+    // Output is empty unless the reading succeeds.
+    data_p->year = data_p->week = data_p->estInc = NULL;
+    data_p->size = 0;
+    if (grid_p) *grid_p = grid;
+    if (crc_p) *crc_p = 0;
+
+    // All transient allocations of the load are served by the arena, released at the end.
+    init_arena(&arena, arena_buf, sizeof(arena_buf));
   
     // Initialization of the auxiliary parser structure.
-    aux.data_p = data_p;
+    aux.data_p = &parsed;
+    aux.arena_p = &arena;
     aux.capacity = reserve_size;
     aux.curr_row = aux.curr_col = 1;
     aux.err_status = 0;
     aux.err_field = NULL;
+    aux.rules_p = rules_p;
+
+    // Bounds and policy of the dense grid
+    if (grid_p){
+        ILIgridOptions opts = {};
+        if (grid_opts_p) opts = *grid_opts_p;
+
+        aux.grid_p = &grid;
+        aux.gap_policy = opts.policy;
+        aux.start_ordinal = LONG_MIN;
+        aux.end_ordinal = LONG_MAX;
+        aux.start_year = opts.start_year;
+        aux.start_week = opts.start_week;
+        aux.max_gap = opts.max_gap ? opts.max_gap : ILI_DEFAULT_MAX_GAP;
+
+        if (opts.start_year || opts.start_week){
+            if (opts.start_week < 1 || opts.start_week > epiweeks_in_year(opts.start_year)){
+                fprintf(stderr, "Invalid grid start %d-W%02d @ %s.\n", opts.start_year, opts.start_week, func_name);
+                goto end_load;
+            }
+            aux.start_ordinal = epiweek_ordinal(opts.start_year, opts.start_week);
+        }
+        if (opts.end_year || opts.end_week){
+            if (opts.end_week < 1 || opts.end_week > epiweeks_in_year(opts.end_year)){
+                fprintf(stderr, "Invalid grid end %d-W%02d @ %s.\n", opts.end_year, opts.end_week, func_name);
+                goto end_load;
+            }
+            aux.end_ordinal = epiweek_ordinal(opts.end_year, opts.end_week);
+        }
+        if (aux.end_ordinal < aux.start_ordinal){
+            fprintf(stderr, "Invalid grid bounds %d-W%02d to %d-W%02d (end before start) @ %s.\n",
+                opts.start_year, opts.start_week, opts.end_year, opts.end_week, func_name);
+            goto end_load;
+        }
+    }
 
     // Initial allocation of the struct pointers
-    if (alloc_ili_input(data_p, reserve_size)){
-        return EXIT_FAILURE;
-    };
+    if (alloc_ili_input(&parsed, reserve_size)) goto end_load;
+    if (grid_p){
+        grid.valid = (unsigned char*) malloc(reserve_size);
+        grid.source = (size_t*) malloc(reserve_size * sizeof(size_t));
+        if (!grid.valid || !grid.source){
+            fprintf(stderr, "Failed to allocate ILIgrid struct data @ %s.\n", func_name);
+            goto end_load;
+        }
+    }
 
     // Initialiation of the parser
     if (csv_init(&parser, options) != 0) {
-        fprintf(stderr, "Failed to initialize csv parser @ read_ili_csv.\n");
-        return EXIT_FAILURE;
+        fprintf(stderr, "Failed to initialize csv parser @ %s.\n", func_name);
+        goto end_load;
     }
+    parser_ready = 1;
+    csv_arena = &arena;
+    csv_set_realloc_func(&parser, csv_arena_realloc);
+    csv_set_free_func(&parser, csv_arena_free);
 
     // This can be ignored/commented, csvlib defines default functions for space/term inside the parser.
     csv_set_space_func(&parser, is_space);
@@ -427,92 +828,239 @@ int read_ili_csv(const char* fname, ILIinput* data_p){
     // ---------
 
     // --- File opening
+    span = trace_begin("io", "open");
     fp = fopen(fname, "rb");
+    trace_end(span);
     if (!fp) {
         fprintf(stderr, "Failed to open %s: \"%s\"\n", fname, strerror(errno));
-        return(EXIT_FAILURE);
+        goto end_load;
     }
 
     // --- Main loop for reading and parsing the file
-    while ((bytes_read=fread(buf, 1, FILE_BUF_SIZE, fp)) > 0) {
-        if (csv_parse(&parser, buf, bytes_read, cb1, cb2, &aux) != bytes_read) {
+    while ((bytes_read=read_chunk(buf, fp, crc_p)) > 0) {
+        size_t bytes_parsed;
+
+        // Tokenizing (libcsv) and conversion (callbacks) run in a single pass, traced as "parse".
+        span = trace_begin("io", "parse");
+        bytes_parsed = csv_parse(&parser, buf, bytes_read, cb1, cb2, &aux);
+        trace_end_bytes(span, bytes_read);
+        total_bytes += bytes_read;
+
+        if (bytes_parsed != bytes_read) {
             fprintf(stderr, "Error while parsing file: \"%s\"\n", csv_strerror(csv_error(&parser)));
             break;
         }
+        if (aux.err_status) break;  // Inner parsing error, reported below.
+        validate_parsed(&aux);
+    }
 
-        // Handle inner parsing error
-        if (aux.err_status){
-            fprintf(stderr, "Error parsing field %lu (\"%s\") of line %lu: %s\n", aux.curr_col, 
-                aux.err_field, aux.curr_row, cb_err_str(aux.err_status));
-            free(aux.err_field);
-            break;
+    // Parses the last row, if the file does not end with a line terminator.
+    if (!aux.err_status && !parser.status){
+        span = trace_begin("io", "parse");
+        csv_fini(&parser, cb1, cb2, &aux);
+        trace_end(span);
+        if (aux.grid_p && !aux.err_status){
+            span = trace_begin("io", "grid");
+            finish_grid(&aux);
+            trace_end(span);
         }
+        validate_parsed(&aux);
+    }
+
+    // Handle inner parsing error
+    if (aux.err_status){
+        fprintf(stderr, "Error parsing field %zu (\"%s\") of line %zu: %s\n", aux.curr_col, 
+            aux.err_field, aux.curr_row, cb_err_str(aux.err_status));
+    }
+
+    // Handle rows that failed the checks (reported individually by validate_ili_rows)
+    if (aux.n_invalid){
+        fprintf(stderr, "%zu invalid ILI rows (%zu reported)\n", aux.n_invalid,
+            (aux.n_reported < VALIDATION_MAX_REPORTS) ? aux.n_reported : (size_t) VALIDATION_MAX_REPORTS);
     }
 
     // Final operations
     // ----------------
 
-    // Shrink to fit the actual vector size
-    if (aux.capacity > data_p->size)
-        realloc_ili_input(data_p, data_p->size);
-
-    if (ferror(fp) || aux.err_status || parser.status) {
+    if (ferror(fp) || aux.err_status || parser.status || aux.n_invalid) {
         fprintf(stderr, "Error while reading file \"%s\"\n", fname);
-        fclose(fp);
-        csv_free(&parser);  // Frees the csv parser.
-        return(EXIT_FAILURE);
+    }
+    else {
+        // Trim the columns to their exact size (in place) and move them to the output.
+        span = trace_begin("io", "shrink");
+        if (parsed.size) grow_ili_aux(&aux, parsed.size);
+        trace_end(span);
+        track_ili_input(&parsed);
+        if (grid_p){
+            track_memory(grid.valid, parsed.size, MEMORY_HEAP);
+            track_memory(grid.source, parsed.size * sizeof(size_t), MEMORY_HEAP);
+        }
+        *data_p = parsed;
+        if (grid_p) *grid_p = grid;
+        status = EXIT_SUCCESS;
     }
 
-    fclose(fp);
-    csv_fini(&parser, cb1, cb2, &aux);  // Closes the csv parser.
-    csv_free(&parser);  // Frees the csv parser.
-
-    return EXIT_SUCCESS;
+    // Every exit goes through here, so that failed loads are also traced and counted.
+end_load:
+    if (status != EXIT_SUCCESS){
+        free_ili_grid(&grid);
+        free_ili_input(&parsed);
+    }
+    if (fp) fclose(fp);
+    if (parser_ready) csv_free(&parser);  // Frees the csv parser.
+    csv_arena = prev_arena;
+    release_arena(&arena);  // Frees all transient allocations at once.
+
+    trace_end_bytes(load_span, total_bytes);
+    metrics_load_end(load_start, total_bytes, status);
+    return status;
 }
 
 
 /* 
-Reads a csv file with double data (one ignored index column and one data column).
+Reads a csv file with ILI data. 
 
-The first column ("index") is ignored. 
+Assumes that the file has the following 4 columns:
+"index", "year","week","est_Inc"
+
+Where the first column ("index") is ignored. 
 The first row of the file is assumed as header and is also ignored.
 
 
 @param fname  Path for the csv file. Must be a null-terminated string.
-@param vec_p   Pointer to a vector of doubles, where data will be stored. Does not need
-     to be preallocated.
-@param vsize_p   Pointer to the size of the vector. Does not need to be preset.
+@param data_p   Pointer to an ILIinput struct, to which the data is written. Left empty if
+     reading fails.
 
 @return An integer error code.
 */
-int read_csv_double_vector(const char* fname, double* *vec_p, int* vsize_p){
+int read_ili_csv(const char* fname, ILIinput* data_p){
+    return read_ili(fname, data_p, NULL, NULL, NULL, NULL, "read_ili_csv");
+}
+
+
+/* 
+Reads a csv file with ILI data as read_ili_csv, checking the rows as they are parsed (e.g.
+week and year ranges, estInc >= 0, consecutive epiweeks; see default_ili_validation).
+This replaces a separate pass over the loaded data.
+
+Every invalid row is counted, and the first VALIDATION_MAX_REPORTS are reported by row to
+stderr. Reading fails if any row is invalid.
+
+@param fname  Path for the csv file. Must be a null-terminated string.
+@param data_p   Pointer to an ILIinput struct, to which the data is written. Left empty if
+     reading fails.
+@param rules_p   Checks to apply. If NULL, no checks are made.
+
+@return An integer error code.
+*/
+int read_ili_csv_checked(const char* fname, ILIinput* data_p, const ILIvalidation* rules_p){
+    return read_ili(fname, data_p, rules_p, NULL, NULL, NULL, "read_ili_csv_checked");
+}
+
+
+/* 
+Reads a csv file with ILI data as read_ili_csv, producing a dense weekly grid: the weeks missing
+from the file are detected as the rows are parsed (including 53-week years, see mcmc_grid.h)
+and inserted in place, filled according to the gap policy. The sampler can then index weeks
+directly, with no gap handling.
+
+The rows must be in increasing epiweek order. Rows outside the bounds of the grid are dropped.
+More than options_p->max_gap (default ILI_DEFAULT_MAX_GAP) consecutive missing weeks is an
+error, as it usually comes from a wrong year in the file.
+
+@param fname  Path for the csv file. Must be a null-terminated string.
+@param data_p   Pointer to an ILIinput struct, to which the dense data is written. Left empty
+     if reading fails.
+@param grid_p   Pointer to an ILIgrid struct, to which the validity mask and the mapping from
+     dense to source rows are written. Must be freed with free_ili_grid.
+@param options_p   Bounds of the grid and gap policy. If NULL, the grid spans from the first to
+     the last row of the file, and missing weeks are filled with zeros.
+
+@return An integer error code.
+*/
+int read_ili_csv_dense(const char* fname, ILIinput* data_p, ILIgrid* grid_p,
+    const ILIgridOptions* options_p){
+    return read_ili(fname, data_p, NULL, grid_p, options_p, NULL, "read_ili_csv_dense");
+}
+
+
+/* 
+Reads a csv file with ILI data as read_ili_csv, also computing the CRC32C of the file content
+on each chunk as it is read. Used by the parse cache (mcmc_cache.h) to recognize unchanged files
+without reading them a second time.
+
+@param crc_p   Pointer to the CRC32C of the file. Only meaningful if reading succeeds.
+
+@return An integer error code.
+*/
+int read_ili_csv_crc(const char* fname, ILIinput* data_p, uint32_t* crc_p){
+    return read_ili(fname, data_p, NULL, NULL, NULL, crc_p, "read_ili_csv_crc");
+}
+
+
+/* 
+Reads a csv file with a single data column (one ignored index column and one data column),
+storing it as a vector of the given type, with optional transform steps applied as it is parsed.
+The CRC32C of the file is written to crc_p, if not NULL. Common implementation of the vector
+readers; func_name is the name of the caller, for error messages.
+*/
+static int read_csv_column(const char* fname, ColumnType type, void* *vec_p, size_t* vsize_p,
+    const ColumnTransform* transforms, size_t n_transforms, uint32_t* crc_p, const char* func_name){
 
     // Declarations
     // ------------
-    FILE *fp;
+    FILE *fp = NULL;
     struct csv_parser parser;
+    int parser_ready = 0;
     char buf[FILE_BUF_SIZE];
     size_t bytes_read;
     unsigned char options = 0;
     const size_t reserve_size = 25;  // Initial size of the ILI vectors.
     ColumnInputAux aux;
+    void* parsed = NULL;  // Vector being parsed.
+    size_t elem_size = column_elem_size(type);
+    size_t parsed_size = 0;
+    Arena arena;
+    _Alignas(ARENA_ALIGNMENT) unsigned char arena_buf[LOAD_ARENA_SIZE];
+    Arena* prev_arena = csv_arena;
+    TraceSpan load_span = trace_begin("io", func_name), span;
+    uint64_t load_start = metrics_load_begin();
+    size_t total_bytes = 0;
+    int status = EXIT_FAILURE;
 
     // Initializations
     // ---------------
 
+    // Output is empty unless the reading succeeds.
+    *vec_p = NULL;
+    *vsize_p = 0;
+    if (crc_p) *crc_p = 0;
+
+    // All transient allocations of the load are served by the arena, released at the end.
+    init_arena(&arena, arena_buf, sizeof(arena_buf));
+
     // Initialiation of the parser
     if (csv_init(&parser, options) != 0) {
-        fprintf(stderr, "Failed to initialize csv parser @ read_csv_double_vector.\n");
-        return EXIT_FAILURE;
+        fprintf(stderr, "Failed to initialize csv parser @ %s.\n", func_name);
+        goto end_load;
     }
+    parser_ready = 1;
+    csv_arena = &arena;
+    csv_set_realloc_func(&parser, csv_arena_realloc);
+    csv_set_free_func(&parser, csv_arena_free);
 
     // Set option to append null string terminator to each field
     options += CSV_APPEND_NULL;  
     csv_set_opts(&parser, options); 
 
     // Initialization of the auxiliary parser structure.
-    aux.vec_p = vec_p;
-    aux.size_p = vsize_p;
+    aux.vec_p = &parsed;
+    aux.type = type;
+    aux.transforms = transforms;
+    aux.n_transforms = n_transforms;
+    aux.n_transformed = 0;
+    aux.size_p = &parsed_size;
+    aux.arena_p = &arena;
     aux.capacity = reserve_size;
     aux.curr_row = aux.curr_col = 1;
     aux.err_status = 0;
@@ -520,59 +1068,243 @@ int read_csv_double_vector(const char* fname, double* *vec_p, int* vsize_p){
 
 
     // First allocation of the data vector
-    *vec_p = (double*) malloc(reserve_size * sizeof(double));
-    if (! *vec_p){
-        fprintf(stderr, "Failed to allocate double vector @ read_csv_double_vector.\n");
-        return EXIT_FAILURE;
+    parsed = malloc(reserve_size * elem_size);
+    if (!parsed){
+        fprintf(stderr, "Failed to allocate data vector @ %s.\n", func_name);
+        goto end_load;
     }
 
-    *vsize_p = 0;
-
 
     // Execution
     // ---------
     
     // --- File opening
+    span = trace_begin("io", "open");
     fp = fopen(fname, "rb");
+    trace_end(span);
     if (!fp) {
         fprintf(stderr, "Failed to open %s: \"%s\"\n", fname, strerror(errno));
-        return(EXIT_FAILURE);
+        goto end_load;
     }
 
     // --- Main loop for reading and parsing the file
-    while ((bytes_read=fread(buf, 1, FILE_BUF_SIZE, fp)) > 0) {
-        if (csv_parse(&parser, buf, bytes_read, contacts_cb1, contacts_cb2, &aux) != bytes_read) {
+    while ((bytes_read=read_chunk(buf, fp, crc_p)) > 0) {
+        size_t bytes_parsed;
+
+        span = trace_begin("io", "parse");
+        bytes_parsed = csv_parse(&parser, buf, bytes_read, contacts_cb1, contacts_cb2, &aux);
+        trace_end_bytes(span, bytes_read);
+        total_bytes += bytes_read;
+
+        if (bytes_parsed != bytes_read) {
             fprintf(stderr, "Error while parsing file: \"%s\"\n", csv_strerror(csv_error(&parser)));
             break;
         }
+        if (aux.err_status) break;  // Inner parsing error, reported below.
+        transform_parsed(&aux);
+    }
 
-        // Handle inner parsing error
-        if (aux.err_status){
-            fprintf(stderr, "Error parsing field (\"%s\") at line %lu: %s\n",
-                aux.err_field, aux.curr_row, cb_err_str_double(aux.err_status));
-            free(aux.err_field);
-            break;
-        }
+    // Parses the last row, if the file does not end with a line terminator.
+    if (!aux.err_status && !parser.status){
+        span = trace_begin("io", "parse");
+        csv_fini(&parser, contacts_cb1, contacts_cb2, &aux);
+        trace_end(span);
+        transform_parsed(&aux);
     }
 
-    // Shrink to fit the actual vector size
-    if (aux.capacity > *vsize_p)
-        *vec_p = (double*) realloc(*vec_p, *vsize_p * sizeof(double));
+    // Handle inner parsing error
+    if (aux.err_status){
+        fprintf(stderr, "Error parsing field (\"%s\") at line %zu: %s\n",
+            aux.err_field, aux.curr_row,
+            (type == COLUMN_FLOAT) ? cb_err_str_float(aux.err_status) : cb_err_str_double(aux.err_status));
+    }
+
+    // Final operations
+    // ----------------
 
     if (ferror(fp) || aux.err_status || parser.status) {
         fprintf(stderr, "Error while reading file \"%s\"\n", fname);
-        fclose(fp);
-        csv_free(&parser);  // Frees the csv parser.
-        return(EXIT_FAILURE);
+    }
+    else {
+        // Trim the vector to its exact size (in place) and move it to the output.
+        span = trace_begin("io", "shrink");
+        if (parsed_size){
+            void* tmp = realloc(parsed, parsed_size * elem_size);
+            if (tmp) parsed = tmp;
+        }
+        trace_end(span);
+        track_memory(parsed, parsed_size * elem_size, MEMORY_HEAP);  // Until free_csv_vector.
+        *vec_p = parsed;
+        *vsize_p = parsed_size;
+        status = EXIT_SUCCESS;
     }
 
-    // Final operations
-    // ----------------
+    // Every exit goes through here, so that failed loads are also traced and counted.
+end_load:
+    if (status != EXIT_SUCCESS) free(parsed);
+    if (fp) fclose(fp);
+    if (parser_ready) csv_free(&parser);  // Frees the csv parser.
+    csv_arena = prev_arena;
+    release_arena(&arena);  // Frees all transient allocations at once.
+
+    trace_end_bytes(load_span, total_bytes);
+    metrics_load_end(load_start, total_bytes, status);
+    return status;
+}
 
-    fclose(fp);
 
-    csv_fini(&parser, contacts_cb1, contacts_cb2, &aux);  // Closes the csv parser.
-    csv_free(&parser);  // Frees the csv parser.
+/* 
+Reads a csv file with double data (one ignored index column and one data column).
 
-    return EXIT_SUCCESS;
+The first column ("index") is ignored. 
+The first row of the file is assumed as header and is also ignored.
+
+
+@param fname  Path for the csv file. Must be a null-terminated string.
+@param vec_p   Pointer to a vector of doubles, where data will be stored. Does not need
+     to be preallocated.
+@param vsize_p   Pointer to the size of the vector. Does not need to be preset.
+     On failure, the vector is set to NULL and its size to 0.
+
+The vector is registered in the memory registry; it must be released with free_csv_vector.
+
+@return An integer error code.
+*/
+int read_csv_double_vector(const char* fname, double* *vec_p, size_t* vsize_p){
+    void* vec;
+    int status = read_csv_column(fname, COLUMN_DOUBLE, &vec, vsize_p, NULL, 0, NULL,
+        "read_csv_double_vector");
+    *vec_p = (double*) vec;
+    return status;
+}
+
+
+/* 
+Reads a csv file with the same layout as read_csv_double_vector, storing the data in single
+precision. Each value is converted directly from its text with correct rounding.
+
+Meant for data with few significant digits (e.g. contact rates), for which halving the size
+of the vector speeds up the products that use it (see mcmc_contact.h).
+
+@param fname  Path for the csv file. Must be a null-terminated string.
+@param vec_p   Pointer to a vector of floats, where data will be stored. Does not need
+     to be preallocated.
+@param vsize_p   Pointer to the size of the vector. Does not need to be preset.
+     On failure, the vector is set to NULL and its size to 0.
+
+@return An integer error code.
+*/
+int read_csv_float_vector(const char* fname, float* *vec_p, size_t* vsize_p){
+    void* vec;
+    int status = read_csv_column(fname, COLUMN_FLOAT, &vec, vsize_p, NULL, 0, NULL,
+        "read_csv_float_vector");
+    *vec_p = (float*) vec;
+    return status;
+}
+
+
+/* 
+Reads a csv file as read_csv_double_vector, applying a sequence of transform steps (see
+mcmc_transform.h) to the values as they are parsed. This replaces a separate pass over the
+loaded vector, e.g. to convert counts to rates per 100k or to take logs.
+
+@param fname  Path for the csv file. Must be a null-terminated string.
+@param vec_p   Pointer to a vector of doubles, where the transformed data will be stored.
+@param vsize_p   Pointer to the size of the vector.
+@param transforms   Transform steps, applied in order. May be NULL if n_transforms is 0.
+@param n_transforms   Number of transform steps.
+
+@return An integer error code.
+*/
+int read_csv_double_vector_tf(const char* fname, double* *vec_p, size_t* vsize_p,
+    const ColumnTransform* transforms, size_t n_transforms){
+    void* vec;
+    int status;
+
+    *vec_p = NULL;
+    *vsize_p = 0;
+    if (check_transforms(transforms, n_transforms)) return EXIT_FAILURE;
+
+    status = read_csv_column(fname, COLUMN_DOUBLE, &vec, vsize_p, transforms, n_transforms, NULL,
+        "read_csv_double_vector_tf");
+    *vec_p = (double*) vec;
+    return status;
+}
+
+
+/* 
+Single precision version of read_csv_double_vector_tf (see read_csv_float_vector).
+*/
+int read_csv_float_vector_tf(const char* fname, float* *vec_p, size_t* vsize_p,
+    const ColumnTransform* transforms, size_t n_transforms){
+    void* vec;
+    int status;
+
+    *vec_p = NULL;
+    *vsize_p = 0;
+    if (check_transforms(transforms, n_transforms)) return EXIT_FAILURE;
+
+    status = read_csv_column(fname, COLUMN_FLOAT, &vec, vsize_p, transforms, n_transforms, NULL,
+        "read_csv_float_vector_tf");
+    *vec_p = (float*) vec;
+    return status;
+}
+
+
+/* 
+Reads a csv file of doubles as read_csv_double_vector, also computing the CRC32C of the file
+content (see read_ili_csv_crc).
+*/
+int read_csv_double_vector_crc(const char* fname, double* *vec_p, size_t* vsize_p, uint32_t* crc_p){
+    void* vec;
+    int status = read_csv_column(fname, COLUMN_DOUBLE, &vec, vsize_p, NULL, 0, crc_p,
+        "read_csv_double_vector_crc");
+    *vec_p = (double*) vec;
+    return status;
+}
+
+
+/*
+Releases a vector returned by one of the csv vector readers (read_csv_double_vector,
+read_csv_float_vector and their _tf versions), removing it from the memory registry.
+NULL is ignored.
+*/
+void free_csv_vector(void* vec){
+    untrack_memory(vec);
+    free(vec);
+}
+
+
+/*
+Returns a read-only view of loaded ILI data. The view is valid while data_p is not freed.
+*/
+ILIview ili_view(const ILIinput* data_p){
+    ILIview view = {data_p->size, data_p->year, data_p->week, data_p->estInc};
+    return view;
+}
+
+
+/*
+Returns a read-only view of a vector of doubles (e.g. as read with read_csv_double_vector).
+*/
+DoubleView double_view(const double* vec, size_t size){
+    DoubleView view = {size, vec};
+    return view;
+}
+
+
+/*
+Returns a read-only view of a vector of floats (e.g. as read with read_csv_float_vector).
+*/
+FloatView float_view(const float* vec, size_t size){
+    FloatView view = {size, vec};
+    return view;
+}
+
+
+/*
+Returns the memory held by the arrays of an ILIinput (heap; trimmed to their size by the readers).
+*/
+MemoryUsage ili_input_memory(const ILIinput* data_p){
+    return region_memory(data_p->year, 3 * data_p->size * sizeof(int), MEMORY_HEAP);
 }
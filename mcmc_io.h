@@ -1,6 +1,15 @@
 #ifndef MCMC_IO_H
 #define MCMC_IO_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include "mcmc_transform.h"
+#include "mcmc_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Struct that stores ILI data read from file.
 typedef struct {
     size_t size;  // Number of elements in each array.
@@ -8,12 +17,93 @@ typedef struct {
     int *week;    // Week of the year data was collected
     int *estInc;  // Estimated incidence for H1pdm
     int *fluSeason; // Pointer for beginning of the influenza season
-    int fluDuration; // Number of weeks during flu season
+    size_t fluDuration; // Number of weeks during flu season
 } ILIinput;
 
+// Checks applied to ILI data as it is read (see read_ili_csv_checked).
+#define ILI_CHECK_WEEK 0x1        // min_week <= week <= max_week
+#define ILI_CHECK_YEAR 0x2        // min_year <= year <= max_year
+#define ILI_CHECK_ESTINC 0x4      // estInc >= min_estInc
+#define ILI_CHECK_CONTINUITY 0x8  // Each row is the epiweek after the previous one.
+#define ILI_CHECK_ALL 0xf
+
+typedef struct {
+    unsigned checks;  // Bitwise OR of ILI_CHECK_* flags.
+    int min_week, max_week;
+    int min_year, max_year;
+    int min_estInc;
+} ILIvalidation;
+
+// Policy used to fill the weeks missing from an ILI file on a dense grid (see read_ili_csv_dense).
+typedef enum {
+    GAP_FILL_ZERO = 0,      // estInc = 0
+    GAP_FILL_PREVIOUS = 1,  // estInc of the previous observed week (the next one for leading gaps).
+    GAP_FILL_LINEAR = 2     // Linear interpolation between the observed neighbours.
+} GapPolicy;
+
+#define ILI_NO_SOURCE ((size_t) -1)  // Source row of the weeks missing from the file.
+#define ILI_DEFAULT_MAX_GAP 260      // Longest run of missing weeks (5 years) filled between two rows.
+
+// Options of the dense weekly grid. Bounds left as 0 are taken from the first/last rows of the file.
+typedef struct {
+    GapPolicy policy;
+    int start_year, start_week;
+    int end_year, end_week;
+    size_t max_gap;  // Longest run of missing weeks between two rows (0 for ILI_DEFAULT_MAX_GAP).
+} ILIgridOptions;
+
+// Dense grid information of ILI data read with read_ili_csv_dense.
+typedef struct {
+    unsigned char *valid;  // 1 for weeks present in the file, 0 for filled weeks.
+    size_t *source;        // Row of the file (0-based, header excluded) of each week, or ILI_NO_SOURCE.
+    size_t n_missing;      // Number of filled weeks.
+} ILIgrid;
+
+// Read-only view of ILI data, which does not own its memory (e.g. loaded, mapped or embedded data).
+typedef struct {
+    size_t size;
+    const int *year;
+    const int *week;
+    const int *estInc;
+} ILIview;
+
+// Read-only view of a vector of doubles, which does not own its memory.
+typedef struct {
+    size_t size;
+    const double *data;
+} DoubleView;
+
+// Read-only view of a vector of floats, which does not own its memory.
+typedef struct {
+    size_t size;
+    const float *data;
+} FloatView;
+
 int read_ili_csv(const char* fname, ILIinput* data_p);
+int read_ili_csv_checked(const char* fname, ILIinput* data_p, const ILIvalidation* rules_p);
+ILIvalidation default_ili_validation(void);
+int read_ili_csv_crc(const char* fname, ILIinput* data_p, uint32_t* crc_p);
+int read_ili_csv_dense(const char* fname, ILIinput* data_p, ILIgrid* grid_p,
+    const ILIgridOptions* options_p);
+void free_ili_grid(ILIgrid* grid_p);
 void free_ili_input(ILIinput* data_p);
 
-int read_csv_double_vector(const char* fname, double* *vec_p, int* vsize_p);
+int read_csv_double_vector(const char* fname, double* *vec_p, size_t* vsize_p);
+int read_csv_float_vector(const char* fname, float* *vec_p, size_t* vsize_p);
+int read_csv_double_vector_tf(const char* fname, double* *vec_p, size_t* vsize_p,
+    const ColumnTransform* transforms, size_t n_transforms);
+int read_csv_float_vector_tf(const char* fname, float* *vec_p, size_t* vsize_p,
+    const ColumnTransform* transforms, size_t n_transforms);
+int read_csv_double_vector_crc(const char* fname, double* *vec_p, size_t* vsize_p, uint32_t* crc_p);
+void free_csv_vector(void* vec);
+
+ILIview ili_view(const ILIinput* data_p);
+MemoryUsage ili_input_memory(const ILIinput* data_p);
+DoubleView double_view(const double* vec, size_t size);
+FloatView float_view(const float* vec, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -0,0 +1,367 @@
+/*
+Header-only C++ layer over the mcmc_io C interface (C++17 or later).
+
+Provides owning, move-only dataset types whose memory is released automatically according to
+its allocation backend:
+    IliData       ILI data (year, week, estInc columns).
+    DoubleColumn  Vector of doubles (e.g. contacts).
+    BundleFile    Memory-mapped bundle (see mcmc_bundle.h). Datasets taken from it share the mapping.
+
+Moving is noexcept and never copies the data, so datasets can be handed between pipeline stages
+without allocations. Copies are disabled to prevent accidental deep copies.
+Data is exposed as read-only spans (std::span in C++20, an equivalent minimal type in C++17).
+Each type reports the memory it holds with memory() (see mcmc_memory.h).
+Errors are reported by throwing mcmc::io_error.
+
+ArenaResource adapts the load arena (mcmc_arena.h) as a std::pmr::memory_resource.
+*/
+
+#ifndef MCMC_IO_HPP
+#define MCMC_IO_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+
+#if defined(__cpp_lib_span)
+#include <span>
+#endif
+
+#if defined(__cpp_lib_memory_resource)
+#include <memory_resource>
+#endif
+
+#include "mcmc_io.h"
+#include "mcmc_bundle.h"
+#include "mcmc_arena.h"
+#include "mcmc_memory.h"
+
+namespace mcmc {
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY TYPES
+// ------------------------------------------------------------------------------------------------
+
+#if defined(__cpp_lib_span)
+template <class T>
+using span = std::span<T>;
+#else
+// Minimal read-only replacement for std::span before C++20.
+template <class T>
+class span {
+public:
+    constexpr span() noexcept = default;
+    constexpr span(T* data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    constexpr T* data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T& operator[](std::size_t i) const noexcept { return data_[i]; }
+    constexpr T* begin() const noexcept { return data_; }
+    constexpr T* end() const noexcept { return data_ + size_; }
+
+private:
+    T* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+#endif
+
+// Error raised when reading or mapping data fails. Details are printed by the C layer.
+class io_error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Where the memory of a column comes from.
+enum class Backend {
+    heap,  // malloc/realloc, as allocated by the csv readers.
+    mmap,  // Mapped file (e.g. a bundle).
+    shm    // Shared memory mapping.
+};
+
+static_assert(static_cast<int>(Backend::heap) == MEMORY_HEAP && static_cast<int>(Backend::mmap) == MEMORY_MMAP
+    && static_cast<int>(Backend::shm) == MEMORY_SHM, "Backend must match MemoryBacking");
+
+// Memory held by the n_bytes of a column at p (see region_memory in mcmc_memory.h).
+inline MemoryUsage column_memory(const void* p, std::size_t n_bytes, Backend backend) noexcept {
+    return region_memory(p, n_bytes, static_cast<MemoryBacking>(backend));
+}
+
+/*
+Deleter of a column, matching its backend. Heap columns are freed individually. Mapped columns
+(mmap, shm) are released with their mapping, which is kept alive by a shared owner for as long
+as any column taken from it exists.
+*/
+class ColumnDeleter {
+public:
+    ColumnDeleter() noexcept = default;
+    ColumnDeleter(Backend backend, std::shared_ptr<const void> owner) noexcept
+        : backend_(backend), owner_(std::move(owner)) {}
+
+    void operator()(const void* p) const noexcept {
+        if (backend_ == Backend::heap) {
+            untrack_memory(p);
+            std::free(const_cast<void*>(p));
+        }
+    }
+
+    Backend backend() const noexcept { return backend_; }
+
+private:
+    Backend backend_ = Backend::heap;
+    std::shared_ptr<const void> owner_;  // Owner of the mapping (mmap, shm). Empty for heap.
+};
+
+template <class T>
+using ColumnPtr = std::unique_ptr<const T[], ColumnDeleter>;
+
+
+// ------------------------------------------------------------------------------------------------
+// DATASET TYPES
+// ------------------------------------------------------------------------------------------------
+
+// Owning, move-only ILI dataset.
+class IliData {
+public:
+    IliData() noexcept = default;
+
+    // Takes ownership of the arrays of a loaded ILIinput, which is left as after free_ili_input.
+    explicit IliData(ILIinput&& data) noexcept
+        : year_(data.year), week_(data.week), estInc_(data.estInc), size_(data.size) {
+        data.year = data.week = data.estInc = nullptr;
+        data.size = 0;
+    }
+
+    // Columns from a mapping (e.g. a bundle), kept alive by owner.
+    IliData(const ILIview& view, Backend backend, std::shared_ptr<const void> owner) noexcept
+        : year_(view.year, ColumnDeleter(backend, owner)),
+          week_(view.week, ColumnDeleter(backend, owner)),
+          estInc_(view.estInc, ColumnDeleter(backend, std::move(owner))),
+          size_(view.size) {}
+
+    // Reads an ILI csv file with read_ili_csv.
+    static IliData read_csv(const char* fname) {
+        ILIinput data = {};
+        if (read_ili_csv(fname, &data)) {
+            free_ili_input(&data);
+            throw io_error(std::string("failed to read ILI file ") + fname);
+        }
+        return IliData(std::move(data));
+    }
+
+    IliData(IliData&& other) noexcept
+        : year_(std::move(other.year_)), week_(std::move(other.week_)),
+          estInc_(std::move(other.estInc_)), size_(std::exchange(other.size_, 0)) {}
+
+    IliData& operator=(IliData&& other) noexcept {
+        year_ = std::move(other.year_);
+        week_ = std::move(other.week_);
+        estInc_ = std::move(other.estInc_);
+        size_ = std::exchange(other.size_, 0);
+        return *this;
+    }
+
+    IliData(const IliData&) = delete;
+    IliData& operator=(const IliData&) = delete;
+
+    std::size_t size() const noexcept { return size_; }
+    Backend backend() const noexcept { return year_.get_deleter().backend(); }
+
+    span<const int> year() const noexcept { return {year_.get(), size_}; }
+    span<const int> week() const noexcept { return {week_.get(), size_}; }
+    span<const int> estInc() const noexcept { return {estInc_.get(), size_}; }
+
+    // Memory held by the columns (resident pages only, for mapped columns).
+    MemoryUsage memory() const noexcept {
+        MemoryUsage usage = column_memory(year_.get(), size_ * sizeof(int), backend());
+        for (const int* column : {week_.get(), estInc_.get()}) {
+            MemoryUsage c = column_memory(column, size_ * sizeof(int), backend());
+            usage.resident += c.resident;
+            usage.capacity += c.capacity;
+        }
+        return usage;
+    }
+
+    // View for the C interface.
+    ILIview view() const noexcept { return {size_, year_.get(), week_.get(), estInc_.get()}; }
+
+private:
+    ColumnPtr<int> year_;
+    ColumnPtr<int> week_;
+    ColumnPtr<int> estInc_;
+    std::size_t size_ = 0;
+};
+
+
+// Owning, move-only vector of doubles.
+class DoubleColumn {
+public:
+    DoubleColumn() noexcept = default;
+
+    // Takes ownership of a malloc'd vector (e.g. from read_csv_double_vector), registering it in
+    // the memory registry (if not already) until it is freed.
+    DoubleColumn(double* data, std::size_t size) noexcept : data_(data), size_(size) {
+        track_memory(data, size * sizeof(double), MEMORY_HEAP);
+    }
+
+    // Column from a mapping (e.g. a bundle), kept alive by owner.
+    DoubleColumn(const DoubleView& view, Backend backend, std::shared_ptr<const void> owner) noexcept
+        : data_(view.data, ColumnDeleter(backend, std::move(owner))), size_(view.size) {}
+
+    // Reads a csv file of doubles with read_csv_double_vector.
+    static DoubleColumn read_csv(const char* fname) {
+        double* vec = nullptr;
+        std::size_t size = 0;
+        if (read_csv_double_vector(fname, &vec, &size)) {
+            free_csv_vector(vec);
+            throw io_error(std::string("failed to read double vector file ") + fname);
+        }
+        return DoubleColumn(vec, size);
+    }
+
+    DoubleColumn(DoubleColumn&& other) noexcept
+        : data_(std::move(other.data_)), size_(std::exchange(other.size_, 0)) {}
+
+    DoubleColumn& operator=(DoubleColumn&& other) noexcept {
+        data_ = std::move(other.data_);
+        size_ = std::exchange(other.size_, 0);
+        return *this;
+    }
+
+    DoubleColumn(const DoubleColumn&) = delete;
+    DoubleColumn& operator=(const DoubleColumn&) = delete;
+
+    std::size_t size() const noexcept { return size_; }
+    Backend backend() const noexcept { return data_.get_deleter().backend(); }
+
+    span<const double> values() const noexcept { return {data_.get(), size_}; }
+    const double& operator[](std::size_t i) const noexcept { return data_[i]; }
+
+    // Memory held by the column (resident pages only, for a mapped column).
+    MemoryUsage memory() const noexcept { return column_memory(data_.get(), size_ * sizeof(double), backend()); }
+
+    // View for the C interface.
+    DoubleView view() const noexcept { return {size_, data_.get()}; }
+
+private:
+    ColumnPtr<double> data_;
+    std::size_t size_ = 0;
+};
+
+
+// Memory-mapped bundle. Datasets taken from it point into the mapping and keep it alive.
+class BundleFile {
+public:
+    // verify: whether all block checksums are checked on opening (BUNDLE_VERIFY_EAGER). Otherwise,
+    // each block is checked the first time rows it holds are taken (BUNDLE_VERIFY_LAZY).
+    explicit BundleFile(const char* fname, bool verify = false)
+        : BundleFile(fname, verify ? BUNDLE_VERIFY_EAGER : BUNDLE_VERIFY_LAZY) {}
+
+    // verify: when block checksums are checked (see BundleVerify in mcmc_bundle.h).
+    BundleFile(const char* fname, BundleVerify verify) {
+        auto bundle_p = std::make_unique<Bundle>();
+        if (open_bundle(fname, bundle_p.get(), verify))
+            throw io_error(std::string("failed to open bundle ") + fname);
+
+        bundle_ = std::shared_ptr<const Bundle>(bundle_p.release(), [](const Bundle* b) {
+            close_bundle(const_cast<Bundle*>(b));
+            delete b;
+        });
+    }
+
+    // Whole dataset (all its blocks are verified, with BUNDLE_VERIFY_LAZY).
+    IliData ili(const char* name) const {
+        ILIview view;
+        if (bundle_ili_view(bundle_.get(), name, &view))
+            throw io_error(std::string("no ILI dataset named ") + name);
+        return ili(name, 0, view.size);
+    }
+
+    // Rows [first_row, first_row + n_rows) of a dataset (only their blocks are verified).
+    IliData ili(const char* name, std::size_t first_row, std::size_t n_rows) const {
+        ILIview view;
+        if (bundle_ili_rows(bundle_.get(), name, first_row, n_rows, &view))
+            throw io_error(std::string("failed to take rows of ILI dataset ") + name);
+        return IliData(view, Backend::mmap, bundle_);
+    }
+
+    DoubleColumn column(const char* name) const {
+        DoubleView view;
+        if (bundle_double_view(bundle_.get(), name, &view))
+            throw io_error(std::string("no double vector dataset named ") + name);
+        return column(name, 0, view.size);
+    }
+
+    DoubleColumn column(const char* name, std::size_t first_row, std::size_t n_rows) const {
+        DoubleView view;
+        if (bundle_double_rows(bundle_.get(), name, first_row, n_rows, &view))
+            throw io_error(std::string("failed to take rows of double vector dataset ") + name);
+        return DoubleColumn(view, Backend::mmap, bundle_);
+    }
+
+    const char* provenance() const noexcept { return bundle_provenance(bundle_.get()); }
+
+    // Memory held by the whole mapping.
+    MemoryUsage memory() const noexcept { return bundle_memory(bundle_.get()); }
+
+private:
+    std::shared_ptr<const Bundle> bundle_;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// ALLOCATORS
+// ------------------------------------------------------------------------------------------------
+
+#if defined(__cpp_lib_memory_resource)
+/*
+std::pmr::memory_resource over a monotonic arena (see mcmc_arena.h), for transient containers
+during a load. Deallocation is a no-op; all memory is released at once when the resource is
+destroyed or release() is called.
+*/
+class ArenaResource : public std::pmr::memory_resource {
+public:
+    ArenaResource() noexcept { init_arena(&arena_, nullptr, 0); }
+
+    // Uses buf (aligned to ARENA_ALIGNMENT) as first block, e.g. a buffer on the stack.
+    ArenaResource(void* buf, std::size_t buf_size) noexcept { init_arena(&arena_, buf, buf_size); }
+
+    ArenaResource(const ArenaResource&) = delete;
+    ArenaResource& operator=(const ArenaResource&) = delete;
+    ~ArenaResource() override { release_arena(&arena_); }
+
+    void release() noexcept { release_arena(&arena_); }
+    std::size_t total_bytes() const noexcept { return arena_.total; }
+
+protected:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        void* p = arena_alloc_aligned(&arena_, bytes, alignment);
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+private:
+    Arena arena_;
+};
+#endif
+
+}  // namespace mcmc
+
+#endif
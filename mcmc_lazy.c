@@ -0,0 +1,239 @@
+/*
+Lazy loading of secondary inputs.
+
+A LazyDataset records where its data comes from, and only loads it on first access (through
+lazy_ili_view or lazy_double_view), so that inputs which are never used cost nothing.
+The load happens exactly once, even if the dataset is accessed concurrently from several threads.
+prefetch_lazy hints that the data will be needed, and starts the load on a background thread.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcmc_lazy.h"
+#include "mcmc_trace.h"
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+static char* copy_string(const char* s){
+    char* copy = (char*) malloc(strlen(s) + 1);
+    if (copy) strcpy(copy, s);
+    return copy;
+}
+
+
+static int init_lazy(LazyDataset* lazy_p, LoadKind kind, const char* fname){
+    memset(lazy_p, 0, sizeof(LazyDataset));
+    lazy_p->kind = kind;
+    atomic_init(&lazy_p->state, LAZY_PENDING);
+
+    lazy_p->fname = copy_string(fname);
+    if (!lazy_p->fname){
+        fprintf(stderr, "Failed to allocate lazy dataset for %s.\n", fname);
+        return EXIT_FAILURE;
+    }
+    if (pthread_mutex_init(&lazy_p->mutex, NULL)){
+        fprintf(stderr, "Failed to initialize lazy dataset mutex for %s.\n", fname);
+        free(lazy_p->fname); lazy_p->fname = NULL;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+// Performs the actual load and sets the views. Called once, with the mutex held. Bundle datasets are
+// handed out whole, so all their blocks are checked against their checksums here.
+static int load_now(LazyDataset* lazy_p){
+    if (lazy_p->bundle_fname){
+        Bundle* b = &lazy_p->bundle;
+        const char* name = lazy_p->bundle_name;
+
+        if (open_bundle(lazy_p->bundle_fname, b, BUNDLE_VERIFY_LAZY)) return EXIT_FAILURE;
+
+        if (lazy_p->kind == LOAD_ILI_CSV)
+            return bundle_ili_view(b, name, &lazy_p->ili_view)
+                || bundle_ili_rows(b, name, 0, lazy_p->ili_view.size, &lazy_p->ili_view);
+        return bundle_double_view(b, name, &lazy_p->double_view)
+            || bundle_double_rows(b, name, 0, lazy_p->double_view.size, &lazy_p->double_view);
+    }
+
+    if (lazy_p->kind == LOAD_ILI_CSV){
+        if (read_ili_csv(lazy_p->fname, &lazy_p->ili)) return EXIT_FAILURE;
+        lazy_p->ili_view = ili_view(&lazy_p->ili);
+    }
+    else{
+        if (read_csv_double_vector(lazy_p->fname, &lazy_p->vec, &lazy_p->vsize)) return EXIT_FAILURE;
+        lazy_p->double_view = double_view(lazy_p->vec, lazy_p->vsize);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+// Loads the data if not done yet. Cheap (one atomic load) once the data is loaded.
+static int ensure_loaded(LazyDataset* lazy_p){
+    if (atomic_load_explicit(&lazy_p->state, memory_order_acquire) != LAZY_PENDING)
+        return lazy_p->status;
+
+    pthread_mutex_lock(&lazy_p->mutex);
+    if (atomic_load_explicit(&lazy_p->state, memory_order_relaxed) == LAZY_PENDING){
+        lazy_p->status = load_now(lazy_p);
+        atomic_store_explicit(&lazy_p->state, lazy_p->status ? LAZY_FAILED : LAZY_LOADED,
+            memory_order_release);
+    }
+    pthread_mutex_unlock(&lazy_p->mutex);
+
+    return lazy_p->status;
+}
+
+
+static void* prefetch_thread(void* lazy_vp){
+    trace_set_thread_name("lazy prefetch");
+    ensure_loaded((LazyDataset*) lazy_vp);
+    return NULL;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Initializes a lazy ILI dataset, to be read with read_ili_csv on first access. Does not open the file.
+
+@return An integer error code.
+*/
+int init_lazy_ili(LazyDataset* lazy_p, const char* fname){
+    return init_lazy(lazy_p, LOAD_ILI_CSV, fname);
+}
+
+
+/*
+Initializes a lazy double vector dataset, to be read with read_csv_double_vector on first access.
+
+@return An integer error code.
+*/
+int init_lazy_double_vector(LazyDataset* lazy_p, const char* fname){
+    return init_lazy(lazy_p, LOAD_DOUBLE_VECTOR, fname);
+}
+
+
+/*
+Makes the dataset be mapped from a bundle (see mcmc_bundle.h) instead of parsed from its csv file.
+Must be called before the first access.
+
+@param bundle_fname  Path of the bundle file.
+@param name  Name of the dataset in the bundle.
+
+@return An integer error code.
+*/
+int set_lazy_bundle_source(LazyDataset* lazy_p, const char* bundle_fname, const char* name){
+    free(lazy_p->bundle_fname);
+    free(lazy_p->bundle_name);
+    lazy_p->bundle_fname = copy_string(bundle_fname);
+    lazy_p->bundle_name = copy_string(name);
+
+    if (!lazy_p->bundle_fname || !lazy_p->bundle_name){
+        fprintf(stderr, "Failed to allocate bundle source for %s.\n", lazy_p->fname);
+        free(lazy_p->bundle_fname); lazy_p->bundle_fname = NULL;
+        free(lazy_p->bundle_name); lazy_p->bundle_name = NULL;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Hints that the dataset will be needed: starts loading it on a background thread, if it is not
+loaded or being loaded yet. A later access waits for this load instead of starting another one.
+
+@return An integer error code (failure to start the thread; the data is then loaded on access).
+*/
+int prefetch_lazy(LazyDataset* lazy_p){
+    int status = EXIT_SUCCESS;
+
+    if (atomic_load_explicit(&lazy_p->state, memory_order_acquire) != LAZY_PENDING)
+        return EXIT_SUCCESS;
+
+    pthread_mutex_lock(&lazy_p->mutex);
+    if (!lazy_p->prefetching){
+        if (pthread_create(&lazy_p->prefetch_thread, NULL, prefetch_thread, lazy_p)){
+            fprintf(stderr, "Failed to start prefetch thread for %s.\n", lazy_p->fname);
+            status = EXIT_FAILURE;
+        }
+        else{
+            lazy_p->prefetching = 1;
+        }
+    }
+    pthread_mutex_unlock(&lazy_p->mutex);
+
+    return status;
+}
+
+
+/*
+Gives a read-only view of a lazy ILI dataset, loading it if needed. Valid until free_lazy.
+
+@return An integer error code (also if the load failed).
+*/
+int lazy_ili_view(LazyDataset* lazy_p, ILIview* view_p){
+    if (lazy_p->kind != LOAD_ILI_CSV){
+        fprintf(stderr, "Lazy dataset %s does not hold ILI data.\n", lazy_p->fname);
+        return EXIT_FAILURE;
+    }
+    if (ensure_loaded(lazy_p)) return EXIT_FAILURE;
+
+    *view_p = lazy_p->ili_view;
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Gives a read-only view of a lazy double vector dataset, loading it if needed. Valid until free_lazy.
+
+@return An integer error code (also if the load failed).
+*/
+int lazy_double_view(LazyDataset* lazy_p, DoubleView* view_p){
+    if (lazy_p->kind != LOAD_DOUBLE_VECTOR){
+        fprintf(stderr, "Lazy dataset %s does not hold a double vector.\n", lazy_p->fname);
+        return EXIT_FAILURE;
+    }
+    if (ensure_loaded(lazy_p)) return EXIT_FAILURE;
+
+    *view_p = lazy_p->double_view;
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Returns the memory held by a lazy dataset: nothing until it is loaded, then the parsed data (heap)
+or the bundle mapping (mmap).
+*/
+MemoryUsage lazy_memory(const LazyDataset* lazy_p){
+    MemoryUsage usage = {0, 0, MEMORY_HEAP};
+
+    if (atomic_load_explicit(&lazy_p->state, memory_order_acquire) != LAZY_LOADED) return usage;
+    if (lazy_p->bundle_fname) return bundle_memory(&lazy_p->bundle);
+    if (lazy_p->kind == LOAD_ILI_CSV) return ili_input_memory(&lazy_p->ili);
+    return region_memory(lazy_p->vec, lazy_p->vsize * sizeof(double), MEMORY_HEAP);
+}
+
+
+/*
+Frees a lazy dataset, waiting for its prefetch thread if one was started.
+*/
+void free_lazy(LazyDataset* lazy_p){
+    if (lazy_p->prefetching) pthread_join(lazy_p->prefetch_thread, NULL);
+
+    free_ili_input(&lazy_p->ili);
+    free_csv_vector(lazy_p->vec);
+    if (lazy_p->bundle.map) close_bundle(&lazy_p->bundle);
+    free(lazy_p->fname);
+    free(lazy_p->bundle_fname);
+    free(lazy_p->bundle_name);
+    pthread_mutex_destroy(&lazy_p->mutex);
+    memset(lazy_p, 0, sizeof(LazyDataset));
+}
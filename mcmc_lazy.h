@@ -0,0 +1,48 @@
+#ifndef MCMC_LAZY_H
+#define MCMC_LAZY_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "mcmc_io.h"
+#include "mcmc_async.h"
+#include "mcmc_bundle.h"
+
+// Loading state of a lazy dataset.
+enum {
+    LAZY_PENDING = 0,
+    LAZY_LOADED = 1,
+    LAZY_FAILED = 2
+};
+
+// Input that is only loaded (parsed, or mapped from a bundle) on first access.
+typedef struct {
+    LoadKind kind;
+    char* fname;         // Path of the csv file.
+    char* bundle_fname;  // Path of a bundle holding the same data (optional), used instead of the csv.
+    char* bundle_name;   // Name of the dataset in the bundle.
+
+    pthread_mutex_t mutex;
+    atomic_int state;    // LAZY_PENDING, LAZY_LOADED or LAZY_FAILED.
+    int status;          // Error code of the load. Valid once not pending.
+    int prefetching;     // Whether a prefetch thread was started (protected by mutex).
+    pthread_t prefetch_thread;
+
+    // Storage and views. Views point either to the owned data or into the bundle mapping.
+    ILIinput ili;
+    double* vec;
+    size_t vsize;
+    Bundle bundle;
+    ILIview ili_view;
+    DoubleView double_view;
+} LazyDataset;
+
+int init_lazy_ili(LazyDataset* lazy_p, const char* fname);
+int init_lazy_double_vector(LazyDataset* lazy_p, const char* fname);
+int set_lazy_bundle_source(LazyDataset* lazy_p, const char* bundle_fname, const char* name);
+int prefetch_lazy(LazyDataset* lazy_p);
+int lazy_ili_view(LazyDataset* lazy_p, ILIview* view_p);
+int lazy_double_view(LazyDataset* lazy_p, DoubleView* view_p);
+MemoryUsage lazy_memory(const LazyDataset* lazy_p);
+void free_lazy(LazyDataset* lazy_p);
+
+#endif
@@ -0,0 +1,699 @@
+/*
+Ingestion of case line lists (one record per case, with its onset date and optionally the age and
+region of the case), aggregated into weekly counts per region and age group.
+
+The file is mapped into memory and split into one chunk per thread, at line boundaries (so records
+must not have line breaks inside quoted fields). Each thread parses its chunk with its own csv
+parser and counts the records in a private histogram, indexed by stratum and epiweek, so threads
+never write to shared memory. The histograms are merged once all threads are done, with regions
+sorted by name, so that the result does not depend on the number of threads.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "libcsv/csv.h"
+
+#include "mcmc_linelist.h"
+#include "mcmc_grid.h"
+#include "mcmc_trace.h"
+#include "mcmc_metrics.h"
+
+#define LINE_LIST_MAX_THREADS 64        // Maximum number of threads used by a load.
+#define LINE_LIST_MIN_CHUNK (1 << 20)   // Minimum size, in bytes, of the chunk parsed by each thread.
+#define LINE_LIST_MIN_WEEKS 64          // Initial number of weeks of a histogram.
+#define LINE_LIST_FIELD_SIZE 64         // Size of the copy of a faulty field, for error reporting.
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY STRUCTS AND FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+// Parsing state and histogram of one thread.
+typedef struct {
+    const LineListOptions* opts_p;
+    size_t n_age_groups;
+    size_t n_fields;      // Minimum number of fields of a record.
+    const char* begin;    // Chunk of the file parsed by the thread.
+    size_t length;
+    pthread_t thread;
+    int started;          // Whether the thread was started (and must be joined).
+
+    // Current record
+    size_t curr_col;      // Column index (1-based) currently being read.
+    long ordinal;         // Epiweek ordinal of the onset date.
+    size_t age_group;
+    size_t region;        // Index into regions.
+    int rec_err;          // Error code of the current record, 0 if valid.
+    char rec_field[LINE_LIST_FIELD_SIZE];
+
+    // Regions found in the chunk, in order of appearance.
+    char **regions;
+    size_t n_regions;
+    size_t regions_capacity;
+    size_t last_region;   // Region of the previous record, checked first.
+
+    // Histogram: counts[stratum * n_weeks + (ordinal - base)], stratum = region * n_age_groups + age_group.
+    uint32_t *counts;
+    long base;
+    size_t n_weeks;
+    size_t strata_capacity;
+    long min_ordinal, max_ordinal;
+
+    // Results
+    size_t n_lines;          // Number of records read (valid or not).
+    size_t n_records;        // Number of records counted.
+    size_t n_invalid;
+    int first_err;           // Error code of the first invalid record.
+    size_t first_err_line;   // Index, within the chunk, of the first invalid record.
+    char first_err_field[LINE_LIST_FIELD_SIZE];
+    int status;              // EXIT_FAILURE on fatal errors (allocation or csv errors).
+} LineListWorker;
+
+
+#define LINE_LIST_EINVALID 5  // Update this number when new error codes are included.
+static char *line_list_errors[] =
+    /* 0 */{"success",
+    /* 1 */ "invalid date (expected YYYY-MM-DD)",
+    /* 2 */ "invalid age",
+    /* 3 */ "age is below the first age group",
+    /* 4 */ "record has not enough fields",
+    /*...*/ "invalid status code"};
+
+static char* line_list_err_str(int err_status){
+    if (err_status >= LINE_LIST_EINVALID || err_status < 0){
+        return line_list_errors[LINE_LIST_EINVALID];
+    }
+    else{
+        return line_list_errors[err_status];
+    }
+}
+
+
+// Parses a date as YYYY-MM-DD. Returns nonzero if it is not a valid date.
+static int parse_date(const char* s, size_t len, int* year_p, int* month_p, int* day_p){
+    static const int days_in_month[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int year, month, day, leap;
+
+    if (len != 10 || s[4] != '-' || s[7] != '-') return 1;
+    for (int i = 0; i < 10; i++){
+        if (i != 4 && i != 7 && (s[i] < '0' || s[i] > '9')) return 1;
+    }
+
+    year = (s[0] - '0') * 1000 + (s[1] - '0') * 100 + (s[2] - '0') * 10 + (s[3] - '0');
+    month = (s[5] - '0') * 10 + (s[6] - '0');
+    day = (s[8] - '0') * 10 + (s[9] - '0');
+    if (month < 1 || month > 12) return 1;
+
+    leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    if (day < 1 || day > days_in_month[month - 1] + (month == 2 && leap)) return 1;
+
+    *year_p = year;
+    *month_p = month;
+    *day_p = day;
+    return 0;
+}
+
+
+// Returns the age group of an age (the last edge not above it), or -1 if below the first edge.
+static long age_group_of(const LineListOptions* opts_p, double age){
+    size_t lo = 0, hi = opts_p->n_age_edges;  // Number of edges <= age is in [lo, hi].
+
+    if (!opts_p->age_edges) return 0;
+    while (lo < hi){
+        size_t mid = (lo + hi) / 2;
+        if (opts_p->age_edges[mid] <= age) lo = mid + 1;
+        else hi = mid;
+    }
+    return (long) lo - 1;
+}
+
+
+// Returns the index of a region of the worker, adding it if new. Returns -1 if allocation fails.
+static long find_or_add_region(LineListWorker* w, const char* name){
+    char* copy;
+
+    if (w->n_regions && strcmp(w->regions[w->last_region], name) == 0) return (long) w->last_region;
+    for (size_t r = 0; r < w->n_regions; r++){
+        if (strcmp(w->regions[r], name) == 0){
+            w->last_region = r;
+            return (long) r;
+        }
+    }
+
+    if (w->n_regions == w->regions_capacity){
+        size_t capacity = w->regions_capacity ? 2 * w->regions_capacity : 16;
+        char** regions = (char**) realloc(w->regions, capacity * sizeof(char*));
+        if (!regions) return -1;
+        w->regions = regions;
+        w->regions_capacity = capacity;
+    }
+    copy = (char*) malloc(strlen(name) + 1);
+    if (!copy) return -1;
+    strcpy(copy, name);
+
+    w->regions[w->n_regions] = copy;
+    w->last_region = w->n_regions;
+    return (long) w->n_regions++;
+}
+
+
+// Grows the histogram of a worker to hold at least n_strata strata. New strata have zero counts.
+static int grow_strata(LineListWorker* w, size_t n_strata){
+    size_t capacity = 2 * w->strata_capacity;
+    uint32_t* counts;
+
+    if (capacity < n_strata) capacity = n_strata;
+    if (w->n_weeks){
+        counts = (uint32_t*) realloc(w->counts, capacity * w->n_weeks * sizeof(uint32_t));
+        if (!counts) return EXIT_FAILURE;
+        memset(counts + w->strata_capacity * w->n_weeks, 0,
+            (capacity - w->strata_capacity) * w->n_weeks * sizeof(uint32_t));
+        w->counts = counts;
+    }
+    w->strata_capacity = capacity;
+    return EXIT_SUCCESS;
+}
+
+
+// Grows the range of weeks of the histogram of a worker to include an epiweek ordinal.
+static int grow_weeks(LineListWorker* w, long ordinal){
+    long lo, hi;
+    size_t n_weeks;
+    uint32_t* counts;
+
+    if (!w->n_weeks){
+        n_weeks = LINE_LIST_MIN_WEEKS;
+        lo = ordinal - LINE_LIST_MIN_WEEKS / 2;
+    }
+    else {
+        lo = (ordinal < w->base) ? ordinal : w->base;
+        hi = (ordinal >= w->base + (long) w->n_weeks) ? ordinal + 1 : w->base + (long) w->n_weeks;
+        n_weeks = 2 * w->n_weeks;
+        if (n_weeks < (size_t) (hi - lo)) n_weeks = (size_t) (hi - lo);
+        if (ordinal < w->base) lo = hi - (long) n_weeks;  // Extend on the side that grew.
+    }
+
+    counts = (uint32_t*) calloc(w->strata_capacity * n_weeks, sizeof(uint32_t));
+    if (!counts) return EXIT_FAILURE;
+    for (size_t s = 0; s < w->strata_capacity && w->n_weeks; s++){
+        memcpy(counts + s * n_weeks + (w->base - lo), w->counts + s * w->n_weeks,
+            w->n_weeks * sizeof(uint32_t));
+    }
+
+    free(w->counts);
+    w->counts = counts;
+    w->base = lo;
+    w->n_weeks = n_weeks;
+    return EXIT_SUCCESS;
+}
+
+
+// Adds the current (valid) record to the histogram of the worker.
+static int count_record(LineListWorker* w){
+    size_t stratum = w->region * w->n_age_groups + w->age_group;
+
+    if (stratum >= w->strata_capacity && grow_strata(w, stratum + 1)) return EXIT_FAILURE;
+    if ((!w->n_weeks || w->ordinal < w->base || w->ordinal >= w->base + (long) w->n_weeks)
+        && grow_weeks(w, w->ordinal)) return EXIT_FAILURE;
+
+    w->counts[stratum * w->n_weeks + (size_t) (w->ordinal - w->base)]++;
+    if (!w->n_records || w->ordinal < w->min_ordinal) w->min_ordinal = w->ordinal;
+    if (!w->n_records || w->ordinal > w->max_ordinal) w->max_ordinal = w->ordinal;
+    w->n_records++;
+    return EXIT_SUCCESS;
+}
+
+
+// Marks the current record as invalid, keeping a copy of the faulty field.
+static void set_record_error(LineListWorker* w, int err, const char* field){
+    w->rec_err = err;
+    snprintf(w->rec_field, sizeof(w->rec_field), "%s", field);
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// PARSING CALLBACK FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Callback function for each field that is read from file.
+*/
+static void line_list_cb1(void *s_v, size_t len, void *w_vp){
+    char* s = (char*) s_v;
+    LineListWorker* w = (LineListWorker*) w_vp;
+    const LineListOptions* opts_p = w->opts_p;
+    size_t col = w->curr_col++;
+
+    if (w->rec_err || w->status) return;  // Do not parse if the record is already invalid.
+
+    if (col == opts_p->date_col){
+        int year, month, day;
+        if (parse_date(s, len, &year, &month, &day)) set_record_error(w, 1, s);
+        else w->ordinal = epiweek_ordinal_of_date(year, month, day);
+    }
+    else if (col == opts_p->age_col){
+        char* cursor;
+        double age;
+        long group;
+
+        age = strtod(s, &cursor);
+        if (!len || (size_t) (cursor - s) != len || !(age >= 0.0)){
+            set_record_error(w, 2, s);
+            return;
+        }
+        group = age_group_of(opts_p, age);
+        if (group < 0) set_record_error(w, 3, s);
+        else w->age_group = (size_t) group;
+    }
+    else if (col == opts_p->region_col){
+        long region = find_or_add_region(w, s);
+        if (region < 0) w->status = EXIT_FAILURE;
+        else w->region = (size_t) region;
+    }
+}
+
+
+/*
+Callback function for the end of each record.
+*/
+static void line_list_cb2(int c, void *w_vp){
+    LineListWorker* w = (LineListWorker*) w_vp;
+    (void) c;
+
+    if (w->status) return;
+
+    if (!w->rec_err && w->curr_col - 1 < w->n_fields) set_record_error(w, 4, "");
+
+    if (w->rec_err){
+        if (!w->n_invalid){
+            w->first_err = w->rec_err;
+            w->first_err_line = w->n_lines;
+            memcpy(w->first_err_field, w->rec_field, sizeof(w->rec_field));
+        }
+        w->n_invalid++;
+    }
+    else if (count_record(w)){
+        w->status = EXIT_FAILURE;
+    }
+
+    // Reset the record
+    w->n_lines++;
+    w->curr_col = 1;
+    w->rec_err = 0;
+    w->age_group = 0;
+    w->region = 0;
+}
+
+
+// Parses the chunk of a worker (thread entry point).
+static void* run_worker(void* w_vp){
+    LineListWorker* w = (LineListWorker*) w_vp;
+    TraceSpan span = trace_begin("linelist", "parse_chunk");
+    struct csv_parser parser;
+
+    if (csv_init(&parser, CSV_APPEND_NULL) != 0){
+        fprintf(stderr, "Failed to initialize csv parser @ read_line_list.\n");
+        w->status = EXIT_FAILURE;
+        return NULL;
+    }
+
+    if (csv_parse(&parser, w->begin, w->length, line_list_cb1, line_list_cb2, w) != w->length){
+        fprintf(stderr, "Error while parsing file: \"%s\"\n", csv_strerror(csv_error(&parser)));
+        w->status = EXIT_FAILURE;
+    }
+    else if (!w->status){
+        csv_fini(&parser, line_list_cb1, line_list_cb2, w);  // Last record, if not terminated.
+    }
+
+    csv_free(&parser);
+    trace_end_bytes(span, w->length);
+    return NULL;
+}
+
+
+static void* worker_thread(void* w_vp){
+    trace_set_thread_name("line list worker");
+    return run_worker(w_vp);
+}
+
+
+static void free_worker(LineListWorker* w){
+    for (size_t r = 0; r < w->n_regions; r++) free(w->regions[r]);
+    free(w->regions);
+    free(w->counts);
+}
+
+
+static int compare_names(const void* a, const void* b){
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+
+// Number of elements of the counts array of a LineList (at least 1).
+static size_t line_list_counts_size(const LineList* list_p){
+    return list_p->n_regions * list_p->n_age_groups * list_p->n_weeks + 1;
+}
+
+
+// Merges the histograms of the workers into list_p.
+static int merge_workers(LineListWorker* workers, size_t n_workers, LineList* list_p){
+    size_t n_names = 0, n_age = list_p->n_age_groups;
+    long min_ordinal = 0, max_ordinal = -1;
+    int year, week;
+
+    // --- Regions: union of the regions of all workers, sorted by name
+    for (size_t i = 0; i < n_workers; i++) n_names += workers[i].n_regions;
+    list_p->regions = (char**) malloc((n_names ? n_names : 1) * sizeof(char*));
+    if (!list_p->regions) return EXIT_FAILURE;
+
+    for (size_t i = 0; i < n_workers; i++){
+        for (size_t r = 0; r < workers[i].n_regions; r++){
+            list_p->regions[list_p->n_regions++] = workers[i].regions[r];
+        }
+    }
+    qsort(list_p->regions, list_p->n_regions, sizeof(char*), compare_names);
+
+    n_names = list_p->n_regions;
+    list_p->n_regions = 0;
+    for (size_t k = 0; k < n_names; k++){
+        if (!list_p->n_regions || strcmp(list_p->regions[list_p->n_regions - 1], list_p->regions[k]) != 0)
+            list_p->regions[list_p->n_regions++] = list_p->regions[k];
+    }
+
+    // Own copies, as the names belong to the workers.
+    for (size_t r = 0; r < list_p->n_regions; r++){
+        char* copy = (char*) malloc(strlen(list_p->regions[r]) + 1);
+        if (!copy){
+            list_p->n_regions = r;
+            return EXIT_FAILURE;
+        }
+        list_p->regions[r] = strcpy(copy, list_p->regions[r]);
+    }
+
+    // --- Range of weeks
+    for (size_t i = 0; i < n_workers; i++){
+        if (!workers[i].n_records) continue;
+        if (max_ordinal < min_ordinal || workers[i].min_ordinal < min_ordinal) min_ordinal = workers[i].min_ordinal;
+        if (workers[i].max_ordinal > max_ordinal) max_ordinal = workers[i].max_ordinal;
+    }
+    list_p->n_weeks = (max_ordinal >= min_ordinal) ? (size_t) (max_ordinal - min_ordinal + 1) : 0;
+
+    list_p->year = (int*) malloc((list_p->n_weeks ? list_p->n_weeks : 1) * sizeof(int));
+    list_p->week = (int*) malloc((list_p->n_weeks ? list_p->n_weeks : 1) * sizeof(int));
+    list_p->counts = (int*) calloc(line_list_counts_size(list_p), sizeof(int));
+    if (!list_p->year || !list_p->week || !list_p->counts) return EXIT_FAILURE;
+
+    if (list_p->n_weeks) epiweek_of_ordinal(min_ordinal, &year, &week);
+    for (size_t k = 0; k < list_p->n_weeks; k++){
+        list_p->year[k] = year;
+        list_p->week[k] = week;
+        next_epiweek(&year, &week);
+    }
+
+    // --- Counts
+    for (size_t i = 0; i < n_workers; i++){
+        LineListWorker* w = workers + i;
+        if (!w->n_records) continue;
+
+        for (size_t r = 0; r < w->n_regions; r++){
+            char** found = (char**) bsearch(&w->regions[r], list_p->regions, list_p->n_regions,
+                sizeof(char*), compare_names);
+            size_t region = (size_t) (found - list_p->regions);
+
+            for (size_t a = 0; a < n_age && r * n_age + a < w->strata_capacity; a++){
+                const uint32_t* src = w->counts + (r * n_age + a) * w->n_weeks + (w->min_ordinal - w->base);
+                int* dst = list_p->counts + (region * n_age + a) * list_p->n_weeks + (w->min_ordinal - min_ordinal);
+
+                for (long k = 0; k <= w->max_ordinal - w->min_ordinal; k++) dst[k] += (int) src[k];
+            }
+        }
+        list_p->n_records += w->n_records;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Reads a line list (one record per case) and aggregates it into weekly counts per region and age
+group, in parallel. The first row of the file is assumed as header and is ignored.
+
+Onset dates are assigned to MMWR epiweeks (see mcmc_grid.h). The weeks of the result are
+consecutive, from the first to the last week with records; weeks without records have zero counts.
+
+Invalid records (bad date or age, age below the first group, not enough fields) make the reading
+fail, unless opts_p->skip_invalid is set; the first one is reported by line.
+
+@param fname  Path for the csv file. Must be a null-terminated string.
+@param list_p   Pointer to a LineList struct, to which the counts are written. Must be freed with
+     free_line_list. Left empty if reading fails.
+@param opts_p   Columns of the file, age groups and number of threads.
+
+@return An integer error code.
+*/
+int read_line_list(const char* fname, LineList* list_p, const LineListOptions* opts_p){
+    LineListWorker* workers = NULL;
+    size_t n_workers = 0, body_size, line_offset = 0;
+    const char *map = NULL, *body, *end;
+    struct stat st;
+    size_t map_size = 0;
+    int fd, status = EXIT_FAILURE;
+    long n_cpus;
+    TraceSpan load_span = trace_begin("linelist", "read_line_list"), span;
+    uint64_t load_start = metrics_load_begin();
+
+    memset(list_p, 0, sizeof(LineList));
+
+    if (!opts_p->date_col){
+        fprintf(stderr, "Missing date column @ read_line_list.\n");
+        goto end_load;
+    }
+    for (size_t k = 1; k < opts_p->n_age_edges; k++){
+        if (!(opts_p->age_edges[k - 1] < opts_p->age_edges[k])){
+            fprintf(stderr, "Age group edges must be increasing @ read_line_list.\n");
+            goto end_load;
+        }
+    }
+    list_p->n_age_groups = (opts_p->age_edges && opts_p->n_age_edges) ? opts_p->n_age_edges : 1;
+
+    // --- File mapping
+    fd = open(fname, O_RDONLY);
+    if (fd < 0){
+        fprintf(stderr, "Failed to open %s: \"%s\"\n", fname, strerror(errno));
+        goto end_load;
+    }
+    if (fstat(fd, &st)){
+        fprintf(stderr, "Failed to stat %s: \"%s\"\n", fname, strerror(errno));
+        close(fd);
+        goto end_load;
+    }
+    map = st.st_size ? (const char*) mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : "";
+    close(fd);  // The mapping remains valid.
+    if (map == MAP_FAILED){
+        fprintf(stderr, "Failed to map %s: \"%s\"\n", fname, strerror(errno));
+        goto end_load;
+    }
+    map_size = (size_t) st.st_size;
+    if (map_size) madvise((void*) map, map_size, MADV_SEQUENTIAL);
+
+    // --- Split of the records (after the header) into one chunk per thread, at line boundaries
+    end = map + map_size;
+    body = (const char*) memchr(map, '\n', map_size);
+    body = body ? body + 1 : end;
+    body_size = (size_t) (end - body);
+
+    n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    n_workers = (opts_p->n_threads > 0) ? (size_t) opts_p->n_threads : (n_cpus > 0 ? (size_t) n_cpus : 1);
+    if (n_workers > LINE_LIST_MAX_THREADS) n_workers = LINE_LIST_MAX_THREADS;
+    if (n_workers > body_size / LINE_LIST_MIN_CHUNK) n_workers = body_size / LINE_LIST_MIN_CHUNK;
+    if (n_workers < 1) n_workers = 1;
+
+    workers = (LineListWorker*) calloc(n_workers, sizeof(LineListWorker));
+    if (!workers){
+        fprintf(stderr, "Failed to allocate workers @ read_line_list.\n");
+        goto end_load;
+    }
+
+    for (size_t i = 0; i < n_workers; i++){
+        LineListWorker* w = workers + i;
+        const char* begin = (i > 0) ? workers[i - 1].begin + workers[i - 1].length : body;
+        const char* next = (i + 1 < n_workers) ? body + (i + 1) * (body_size / n_workers) : end;
+
+        // Each chunk ends after the line break that follows its nominal end.
+        if (next < end){
+            const char* nl = (const char*) memchr(next, '\n', (size_t) (end - next));
+            next = nl ? nl + 1 : end;
+        }
+        if (next < begin) next = begin;
+
+        w->opts_p = opts_p;
+        w->n_age_groups = list_p->n_age_groups;
+        w->n_fields = opts_p->date_col;
+        if (opts_p->age_col > w->n_fields) w->n_fields = opts_p->age_col;
+        if (opts_p->region_col > w->n_fields) w->n_fields = opts_p->region_col;
+        w->begin = begin;
+        w->length = (size_t) (next - begin);
+        w->curr_col = 1;
+        if (!opts_p->region_col && find_or_add_region(w, "") < 0) w->status = EXIT_FAILURE;
+    }
+
+    // --- Parallel parsing and counting (a worker whose thread cannot be started runs here)
+    for (size_t i = 1; i < n_workers; i++){
+        workers[i].started = (pthread_create(&workers[i].thread, NULL, worker_thread, workers + i) == 0);
+    }
+    run_worker(workers);
+    for (size_t i = 1; i < n_workers; i++){
+        if (workers[i].started) pthread_join(workers[i].thread, NULL);
+        else run_worker(workers + i);
+    }
+
+    // --- Error handling
+    status = EXIT_SUCCESS;
+    for (size_t i = 0; i < n_workers; i++){
+        LineListWorker* w = workers + i;
+
+        if (w->status) status = EXIT_FAILURE;
+        if (w->n_invalid && !list_p->n_invalid){  // First invalid record of the file.
+            fprintf(stderr, "Invalid record (\"%s\") at line %zu: %s\n", w->first_err_field,
+                line_offset + w->first_err_line + 2, line_list_err_str(w->first_err));
+        }
+        list_p->n_invalid += w->n_invalid;
+        line_offset += w->n_lines;
+    }
+    if (list_p->n_invalid && !opts_p->skip_invalid){
+        fprintf(stderr, "%zu invalid records in file \"%s\"\n", list_p->n_invalid, fname);
+        status = EXIT_FAILURE;
+    }
+
+    // --- Merge
+    span = trace_begin("linelist", "merge");
+    if (status == EXIT_SUCCESS && merge_workers(workers, n_workers, list_p)){
+        fprintf(stderr, "Failed to allocate line list counts @ read_line_list.\n");
+        status = EXIT_FAILURE;
+    }
+    trace_end(span);
+    if (status != EXIT_SUCCESS){
+        fprintf(stderr, "Error while reading file \"%s\"\n", fname);
+    }
+    else{
+        size_t n_weeks = list_p->n_weeks ? list_p->n_weeks : 1;
+        track_memory(list_p->year, n_weeks * sizeof(int), MEMORY_HEAP);
+        track_memory(list_p->week, n_weeks * sizeof(int), MEMORY_HEAP);
+        track_memory(list_p->counts, line_list_counts_size(list_p) * sizeof(int), MEMORY_HEAP);
+    }
+
+    // Every exit goes through here, so that failed loads are also traced and counted.
+end_load:
+    if (status != EXIT_SUCCESS) free_line_list(list_p);
+    for (size_t i = 0; workers && i < n_workers; i++) free_worker(workers + i);
+    free(workers);
+    if (map_size) munmap((void*) map, map_size);
+    trace_end_bytes(load_span, map_size);
+    metrics_load_end(load_start, map_size, status);
+    return status;
+}
+
+
+/*
+Frees the arrays of a LineList struct, leaving it empty.
+*/
+void free_line_list(LineList* list_p){
+    untrack_memory(list_p->year);
+    untrack_memory(list_p->week);
+    untrack_memory(list_p->counts);
+    for (size_t r = 0; r < list_p->n_regions; r++) free(list_p->regions[r]);
+    free(list_p->regions);
+    free(list_p->year);
+    free(list_p->week);
+    free(list_p->counts);
+    memset(list_p, 0, sizeof(LineList));
+}
+
+
+/*
+Finds the index of a region by name.
+
+@return An integer error code (EXIT_FAILURE if there is no such region).
+*/
+int find_line_list_region(const LineList* list_p, const char* name, size_t* region_p){
+    char** found;
+
+    if (!list_p->n_regions) return EXIT_FAILURE;
+    found = (char**) bsearch(&name, list_p->regions, list_p->n_regions, sizeof(char*), compare_names);
+    if (!found) return EXIT_FAILURE;
+    *region_p = (size_t) (found - list_p->regions);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Builds ILI data from the weekly counts of a region and age group, as read by read_line_list.
+LINE_LIST_ALL sums over all regions and/or age groups.
+
+@param data_p   Pointer to an ILIinput struct, to which the data is written. Must be freed
+     with free_ili_input.
+
+@return An integer error code.
+*/
+int line_list_ili(const LineList* list_p, size_t region, size_t age_group, ILIinput* data_p){
+    size_t n = list_p->n_weeks;
+    size_t n_bytes = (n ? n : 1) * sizeof(int);
+
+    memset(data_p, 0, sizeof(ILIinput));
+    if ((region != LINE_LIST_ALL && region >= list_p->n_regions)
+        || (age_group != LINE_LIST_ALL && age_group >= list_p->n_age_groups)){
+        fprintf(stderr, "Invalid region or age group @ line_list_ili.\n");
+        return EXIT_FAILURE;
+    }
+
+    data_p->year = (int*) malloc(n_bytes);
+    data_p->week = (int*) malloc(n_bytes);
+    data_p->estInc = (int*) calloc(n ? n : 1, sizeof(int));
+    if (!data_p->year || !data_p->week || !data_p->estInc){
+        fprintf(stderr, "Failed to allocate ILIinput struct data @ line_list_ili.\n");
+        free_ili_input(data_p);
+        return EXIT_FAILURE;
+    }
+    memcpy(data_p->year, list_p->year, n * sizeof(int));
+    memcpy(data_p->week, list_p->week, n * sizeof(int));
+    data_p->size = n;
+    track_memory(data_p->year, n * sizeof(int), MEMORY_HEAP);
+    track_memory(data_p->week, n * sizeof(int), MEMORY_HEAP);
+    track_memory(data_p->estInc, n * sizeof(int), MEMORY_HEAP);
+
+    for (size_t r = 0; r < list_p->n_regions; r++){
+        if (region != LINE_LIST_ALL && r != region) continue;
+        for (size_t a = 0; a < list_p->n_age_groups; a++){
+            const int* counts = list_p->counts + (r * list_p->n_age_groups + a) * n;
+            if (age_group != LINE_LIST_ALL && a != age_group) continue;
+            for (size_t k = 0; k < n; k++) data_p->estInc[k] += counts[k];
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Returns the memory held by the arrays of a LineList (heap).
+*/
+MemoryUsage line_list_memory(const LineList* list_p){
+    MemoryUsage usage = {0, 0, MEMORY_HEAP};
+
+    if (!list_p->counts) return usage;
+    usage.capacity = 2 * (list_p->n_weeks ? list_p->n_weeks : 1) * sizeof(int)
+        + line_list_counts_size(list_p) * sizeof(int) + list_p->n_regions * sizeof(char*);
+    for (size_t r = 0; r < list_p->n_regions; r++) usage.capacity += strlen(list_p->regions[r]) + 1;
+    usage.resident = usage.capacity;
+    return usage;
+}
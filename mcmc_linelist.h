@@ -0,0 +1,47 @@
+#ifndef MCMC_LINELIST_H
+#define MCMC_LINELIST_H
+
+#include <stddef.h>
+#include "mcmc_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LINE_LIST_ALL ((size_t) -1)  // Selects all regions or all age groups in line_list_ili.
+
+// Layout of a line-list file and options of its aggregation.
+typedef struct {
+    size_t date_col;          // Column (1-based) of the onset date, as YYYY-MM-DD. Required.
+    size_t age_col;           // Column (1-based) of the age, or 0 if ages are not used.
+    size_t region_col;        // Column (1-based) of the region, or 0 if regions are not used.
+    const double* age_edges;  // Lower bounds of the age groups, increasing. NULL for a single group.
+    size_t n_age_edges;
+    int n_threads;            // Number of threads. 0 for the number of online CPUs.
+    int skip_invalid;         // Skip (and count) invalid records, instead of failing.
+} LineListOptions;
+
+// Weekly case counts aggregated from a line list, per region and age group.
+typedef struct {
+    size_t n_weeks;       // Consecutive epiweeks, from the first to the last record.
+    int *year;
+    int *week;
+    size_t n_regions;
+    char **regions;       // Region names, sorted. A single empty name if regions are not used.
+    size_t n_age_groups;
+    int *counts;          // counts[(region * n_age_groups + age_group) * n_weeks + week index]
+    size_t n_records;     // Number of records aggregated.
+    size_t n_invalid;     // Number of invalid records skipped.
+} LineList;
+
+int read_line_list(const char* fname, LineList* list_p, const LineListOptions* opts_p);
+void free_line_list(LineList* list_p);
+int find_line_list_region(const LineList* list_p, const char* name, size_t* region_p);
+int line_list_ili(const LineList* list_p, size_t region, size_t age_group, ILIinput* data_p);
+MemoryUsage line_list_memory(const LineList* list_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
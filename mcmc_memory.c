@@ -0,0 +1,201 @@
+/*
+Memory accounting of the loaded datasets and output buffers, to size jobs (e.g. container memory
+limits, chains per node) from measurements rather than guesses.
+
+Every dataset handle and writer reports the memory it holds (resident bytes, capacity bytes and
+backing), e.g. ili_input_memory, bundle_memory, chain_writer_memory. In addition, the modules
+register their long-lived allocations and mappings (not the transient parsing state) in a
+process-wide registry, whose totals are given by get_memory_stats. The registry is keyed by
+address, so handles can be moved or copied freely (e.g. ILIinput structs returned by value).
+
+Vectors returned by the csv readers (read_csv_double_vector, ...) are registered by the reader and
+must be released with free_csv_vector, which unregisters them.
+
+The resident bytes of mappings are the pages in physical memory (mincore), so untouched parts of a
+bundle do not count. Heap memory is counted as resident. All functions are thread-safe.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "mcmc_memory.h"
+
+#define MEMORY_MINCORE_PAGES 4096  // Pages queried by each call to mincore.
+
+// Tracked allocation or mapping.
+typedef struct {
+    const void* addr;
+    size_t n_bytes;
+    MemoryBacking backing;
+} MemoryRegion;
+
+// The process-wide registry. Regions are unordered; there are few of them (one per dataset buffer).
+static struct {
+    pthread_mutex_t mutex;
+    MemoryRegion* regions;
+    size_t n_regions;
+    size_t capacity;
+} registry = {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0};
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+// Bytes of a mapping in physical memory. If they cannot be queried, the whole mapping is counted.
+static size_t mapping_resident(const void* addr, size_t n_bytes){
+    unsigned char in_core[MEMORY_MINCORE_PAGES];
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t) addr;
+    uintptr_t end = begin + n_bytes;
+    uintptr_t page = begin & ~(uintptr_t) (page_size - 1);
+    size_t resident = 0;
+
+    while (page < end){
+        size_t n_pages = (end - page + page_size - 1) / page_size;
+        if (n_pages > MEMORY_MINCORE_PAGES) n_pages = MEMORY_MINCORE_PAGES;
+
+        if (mincore((void*) page, n_pages * page_size, in_core)) return n_bytes;
+
+        for (size_t i = 0; i < n_pages; i++, page += page_size){
+            if (!(in_core[i] & 1)) continue;
+            resident += ((page + page_size < end) ? page + page_size : end)
+                - ((page > begin) ? page : begin);
+        }
+    }
+    return resident;
+}
+
+
+// Must be called with the registry lock held.
+static MemoryRegion* find_region(const void* addr){
+    for (size_t i = registry.n_regions; i-- > 0;){
+        if (registry.regions[i].addr == addr) return &registry.regions[i];
+    }
+    return NULL;
+}
+
+
+// Must be called with the registry lock held.
+static void add_region(const void* addr, size_t n_bytes, MemoryBacking backing){
+    MemoryRegion* r = find_region(addr);
+
+    if (!r){
+        if (registry.n_regions == registry.capacity){
+            size_t new_capacity = registry.capacity ? 2 * registry.capacity : 64;
+            MemoryRegion* new_regions = (MemoryRegion*) realloc(registry.regions,
+                new_capacity * sizeof(MemoryRegion));
+            if (!new_regions){
+                fprintf(stderr, "Failed to allocate memory registry.\n");
+                return;
+            }
+            registry.regions = new_regions;
+            registry.capacity = new_capacity;
+        }
+        r = &registry.regions[registry.n_regions++];
+        r->addr = addr;
+    }
+    r->n_bytes = n_bytes;
+    r->backing = backing;
+}
+
+
+// Must be called with the registry lock held.
+static void remove_region(const void* addr){
+    MemoryRegion* r = find_region(addr);
+    if (r) *r = registry.regions[--registry.n_regions];
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Returns the memory held by a buffer or mapping. Heap memory is counted as resident; the resident
+bytes of a mapping (mmap, shm) are its pages in physical memory.
+*/
+MemoryUsage region_memory(const void* addr, size_t n_bytes, MemoryBacking backing){
+    MemoryUsage usage = {0, 0, backing};
+
+    if (!addr || !n_bytes) return usage;
+    usage.capacity = n_bytes;
+    usage.resident = (backing == MEMORY_HEAP) ? n_bytes : mapping_resident(addr, n_bytes);
+    return usage;
+}
+
+
+/*
+Registers an allocation or mapping, counted by get_memory_stats until untrack_memory. Registering
+an address again updates its size. NULL addresses and empty regions are ignored.
+Mappings must be untracked before they are unmapped.
+*/
+void track_memory(const void* addr, size_t n_bytes, MemoryBacking backing){
+    if (!addr || !n_bytes) return;
+
+    pthread_mutex_lock(&registry.mutex);
+    add_region(addr, n_bytes, backing);
+    pthread_mutex_unlock(&registry.mutex);
+}
+
+
+/*
+Unregisters an allocation or mapping. Addresses that are not registered (including NULL) are ignored.
+*/
+void untrack_memory(const void* addr){
+    if (!addr) return;
+
+    pthread_mutex_lock(&registry.mutex);
+    remove_region(addr);
+    pthread_mutex_unlock(&registry.mutex);
+}
+
+
+/*
+Updates the registration of a heap allocation moved by realloc (old_addr may be NULL).
+*/
+void retrack_memory(const void* old_addr, const void* new_addr, size_t n_bytes){
+    pthread_mutex_lock(&registry.mutex);
+    if (old_addr) remove_region(old_addr);
+    if (new_addr && n_bytes) add_region(new_addr, n_bytes, MEMORY_HEAP);
+    pthread_mutex_unlock(&registry.mutex);
+}
+
+
+/*
+Returns the totals of all registered allocations and mappings, overall and by backing.
+*/
+MemoryStats get_memory_stats(void){
+    MemoryStats stats = {0};
+
+    for (int b = 0; b < MEMORY_N_BACKINGS; b++) stats.backing[b].backing = (MemoryBacking) b;
+
+    pthread_mutex_lock(&registry.mutex);
+    for (size_t i = 0; i < registry.n_regions; i++){
+        const MemoryRegion* r = &registry.regions[i];
+        MemoryUsage usage = region_memory(r->addr, r->n_bytes, r->backing);
+
+        stats.backing[r->backing].resident += usage.resident;
+        stats.backing[r->backing].capacity += usage.capacity;
+        stats.resident += usage.resident;
+        stats.capacity += usage.capacity;
+    }
+    stats.n_regions = registry.n_regions;
+    pthread_mutex_unlock(&registry.mutex);
+
+    return stats;
+}
+
+
+const char* memory_backing_name(MemoryBacking backing){
+    switch (backing){
+        case MEMORY_HEAP: return "heap";
+        case MEMORY_MMAP: return "mmap";
+        case MEMORY_SHM: return "shm";
+    }
+    return "unknown";
+}
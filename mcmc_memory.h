@@ -0,0 +1,55 @@
+#ifndef MCMC_MEMORY_H
+#define MCMC_MEMORY_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEMORY_N_BACKINGS 3
+
+/*
+The registry only records addresses; the tracked memory is never read. Declared to GCC, so that
+registering a freshly allocated (uninitialized) buffer is not reported as a read of it.
+*/
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 10
+#define MEMORY_ADDRESS_ONLY(...) __attribute__((access(none, __VA_ARGS__)))
+#else
+#define MEMORY_ADDRESS_ONLY(...)
+#endif
+
+// Where memory comes from (same as mcmc::Backend in mcmc_io.hpp).
+typedef enum {
+    MEMORY_HEAP = 0,  // malloc/realloc.
+    MEMORY_MMAP = 1,  // Mapped file (e.g. a bundle).
+    MEMORY_SHM = 2    // Shared memory mapping.
+} MemoryBacking;
+
+// Memory held by a dataset handle or writer.
+typedef struct {
+    size_t resident;   // Bytes holding data (heap), or in physical memory (mappings).
+    size_t capacity;   // Bytes allocated or mapped.
+    MemoryBacking backing;
+} MemoryUsage;
+
+// Totals of the memory registry.
+typedef struct {
+    size_t resident;
+    size_t capacity;
+    size_t n_regions;                           // Number of tracked allocations and mappings.
+    MemoryUsage backing[MEMORY_N_BACKINGS];     // Totals by backing (indexed by MemoryBacking).
+} MemoryStats;
+
+MemoryUsage region_memory(const void* addr, size_t n_bytes, MemoryBacking backing);
+MEMORY_ADDRESS_ONLY(1) void track_memory(const void* addr, size_t n_bytes, MemoryBacking backing);
+void untrack_memory(const void* addr);
+MEMORY_ADDRESS_ONLY(2) void retrack_memory(const void* old_addr, const void* new_addr, size_t n_bytes);
+MemoryStats get_memory_stats(void);
+const char* memory_backing_name(MemoryBacking backing);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,373 @@
+/*
+Live metrics of a running process in a fixed-layout page of shared memory, for production
+observability without logging: a monitor (e.g. mcmc_metrics_print) maps the page by name and reads
+it at any time, while the sampler, the chain writers and the readers update it.
+
+The page holds the iteration count and acceptance of the sampler (metrics_add_iterations, called
+by the sampler), the progress of the chain output (samples and bytes written, samples/s, queue
+depth, fsync latency; updated by ChainWriter) and load statistics (updated by the csv readers).
+Counters are updated with relaxed atomics, and each group of counters sits on its own cache line,
+so that threads updating different groups do not contend. While no page is open (the default),
+an update costs one atomic load.
+
+There is one page per process (open_metrics). Layout: MetricsPage below, in native byte order;
+version is stored last, so monitors never see a partially initialized page.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mcmc_metrics.h"
+#include "mcmc_memory.h"
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error "The metrics page requires lock-free 64-bit atomics (shared between processes)."
+#endif
+
+#define METRICS_CACHE_LINE 64
+
+typedef atomic_uint_least64_t MetricsCounter;
+
+typedef struct {
+    char magic[8];
+    _Atomic uint32_t version;
+    uint32_t page_size;         // sizeof(MetricsPage)
+    int64_t pid;
+    int64_t start_time;         // Seconds since the epoch.
+
+    // Sampler
+    _Alignas(METRICS_CACHE_LINE) MetricsCounter iterations;
+    MetricsCounter proposals;
+    MetricsCounter accepted;
+
+    // Chain output
+    _Alignas(METRICS_CACHE_LINE) MetricsCounter samples_written;
+    MetricsCounter bytes_written;
+    MetricsCounter queue_depth;      // Updated with wrapping additions of signed deltas.
+    MetricsCounter samples_per_sec;  // Bits of a double.
+    MetricsCounter rate_time_ns;     // Start of the current rate window (monotonic clock).
+    MetricsCounter rate_samples;     // Samples written at the start of the current rate window.
+    MetricsCounter fsyncs;
+    MetricsCounter fsync_last_ns;
+    MetricsCounter fsync_max_ns;
+    MetricsCounter fsync_total_ns;
+
+    // Input loads
+    _Alignas(METRICS_CACHE_LINE) MetricsCounter loads;
+    MetricsCounter load_failures;
+    MetricsCounter load_bytes;
+    MetricsCounter load_total_ns;
+    MetricsCounter load_max_ns;
+} MetricsPage;
+
+static _Atomic(MetricsPage*) page;  // Page of this process, if open.
+static char* page_name;
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+
+static MetricsPage* current_page(void){
+    return atomic_load_explicit(&page, memory_order_acquire);
+}
+
+
+static void add(MetricsCounter* c, uint64_t n){
+    atomic_fetch_add_explicit(c, n, memory_order_relaxed);
+}
+
+
+static void store_max(MetricsCounter* c, uint64_t value){
+    uint64_t prev = atomic_load_explicit(c, memory_order_relaxed);
+    while (prev < value && !atomic_compare_exchange_weak_explicit(c, &prev, value,
+        memory_order_relaxed, memory_order_relaxed));
+}
+
+
+static uint64_t load(const MetricsCounter* c){
+    return atomic_load_explicit(c, memory_order_relaxed);
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS (PROCESS BEING MONITORED)
+// ------------------------------------------------------------------------------------------------
+
+/*
+Creates the metrics page of this process in a new shared memory object (replacing any existing
+object with the same name), and starts updating it. Replaces the page previously opened, if any.
+
+@param shm_name  Name of the shared memory object, as for shm_open (e.g. "/mcmc_metrics").
+
+@return An integer error code.
+*/
+int open_metrics(const char* shm_name){
+    MetricsPage* p;
+    char* name;
+    int fd;
+
+    close_metrics();
+
+    name = (char*) malloc(strlen(shm_name) + 1);
+    if (!name){
+        fprintf(stderr, "Failed to allocate metrics page %s.\n", shm_name);
+        return EXIT_FAILURE;
+    }
+    strcpy(name, shm_name);
+
+    shm_unlink(shm_name);
+    fd = shm_open(shm_name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0){
+        fprintf(stderr, "Failed to create shared memory %s: \"%s\"\n", shm_name, strerror(errno));
+        free(name);
+        return EXIT_FAILURE;
+    }
+    if (ftruncate(fd, (off_t) sizeof(MetricsPage))){
+        fprintf(stderr, "Failed to resize shared memory %s: \"%s\"\n", shm_name, strerror(errno));
+        close(fd);
+        shm_unlink(shm_name);
+        free(name);
+        return EXIT_FAILURE;
+    }
+    p = (MetricsPage*) mmap(NULL, sizeof(MetricsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED){
+        fprintf(stderr, "Failed to map shared memory %s: \"%s\"\n", shm_name, strerror(errno));
+        shm_unlink(shm_name);
+        free(name);
+        return EXIT_FAILURE;
+    }
+    track_memory(p, sizeof(MetricsPage), MEMORY_SHM);
+
+    // The object is zero-filled: all counters start at 0.
+    p->page_size = sizeof(MetricsPage);
+    p->pid = (int64_t) getpid();
+    p->start_time = (int64_t) time(NULL);
+    atomic_store_explicit(&p->rate_time_ns, now_ns(), memory_order_relaxed);
+    memcpy(p->magic, METRICS_MAGIC, sizeof(p->magic));
+    atomic_store_explicit(&p->version, METRICS_VERSION, memory_order_release);
+
+    page_name = name;
+    atomic_store_explicit(&page, p, memory_order_release);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Stops updating the metrics page and removes it (monitors still attached keep their mapping).
+Must not be called while instrumented code is running on other threads.
+*/
+void close_metrics(void){
+    MetricsPage* p = atomic_exchange(&page, NULL);
+
+    if (!p) return;
+    untrack_memory(p);
+    munmap(p, sizeof(MetricsPage));
+    shm_unlink(page_name);
+    free(page_name);
+    page_name = NULL;
+}
+
+
+int metrics_enabled(void){
+    return current_page() != NULL;
+}
+
+
+/*
+Counts sampler iterations, and the proposals made and accepted in them. Meant to be called from
+the sampling loop (e.g. once per iteration, or once per batch of iterations).
+*/
+void metrics_add_iterations(uint64_t n_iter, uint64_t n_proposed, uint64_t n_accepted){
+    MetricsPage* p = current_page();
+
+    if (!p) return;
+    add(&p->iterations, n_iter);
+    add(&p->proposals, n_proposed);
+    add(&p->accepted, n_accepted);
+}
+
+
+/*
+Changes the number of samples queued in the writers (positive when samples are buffered, negative
+when they are written).
+*/
+void metrics_add_queued(int64_t n_samples){
+    MetricsPage* p = current_page();
+    if (p) add(&p->queue_depth, (uint64_t) n_samples);
+}
+
+
+/*
+Counts samples and bytes written to the output, and updates samples/s once per rate window.
+*/
+void metrics_add_written(uint64_t n_samples, uint64_t n_bytes){
+    MetricsPage* p = current_page();
+    uint64_t total, now, window_start;
+
+    if (!p) return;
+    add(&p->bytes_written, n_bytes);
+    if (!n_samples) return;
+
+    total = atomic_fetch_add_explicit(&p->samples_written, n_samples, memory_order_relaxed) + n_samples;
+    now = now_ns();
+    window_start = load(&p->rate_time_ns);
+
+    // A single thread closes each window.
+    if (now - window_start >= METRICS_RATE_WINDOW_NS
+        && atomic_compare_exchange_strong_explicit(&p->rate_time_ns, &window_start, now,
+            memory_order_relaxed, memory_order_relaxed)){
+        uint64_t prev = atomic_exchange_explicit(&p->rate_samples, total, memory_order_relaxed);
+        double rate = (double) (total - prev) * 1e9 / (double) (now - window_start);
+        uint64_t bits;
+
+        memcpy(&bits, &rate, sizeof(bits));
+        atomic_store_explicit(&p->samples_per_sec, bits, memory_order_relaxed);
+    }
+}
+
+
+/*
+Records the latency of an fsync of the output.
+*/
+void metrics_add_fsync(uint64_t latency_ns){
+    MetricsPage* p = current_page();
+
+    if (!p) return;
+    add(&p->fsyncs, 1);
+    add(&p->fsync_total_ns, latency_ns);
+    atomic_store_explicit(&p->fsync_last_ns, latency_ns, memory_order_relaxed);
+    store_max(&p->fsync_max_ns, latency_ns);
+}
+
+
+/*
+Starts timing a load. Returns 0 if no metrics page is open (the load is then not counted).
+*/
+uint64_t metrics_load_begin(void){
+    return current_page() ? now_ns() : 0;
+}
+
+
+/*
+Counts a load started with metrics_load_begin, with the bytes read and its error code.
+*/
+void metrics_load_end(uint64_t start, uint64_t n_bytes, int status){
+    MetricsPage* p = current_page();
+    uint64_t elapsed;
+
+    if (!p || !start) return;
+    elapsed = now_ns() - start;
+    add(&p->loads, 1);
+    if (status) add(&p->load_failures, 1);
+    add(&p->load_bytes, n_bytes);
+    add(&p->load_total_ns, elapsed);
+    store_max(&p->load_max_ns, elapsed);
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS (MONITOR)
+// ------------------------------------------------------------------------------------------------
+
+/*
+Attaches to the metrics page of another process (read-only).
+
+@param shm_name  Name of the shared memory object, as given to open_metrics.
+
+@return An integer error code.
+*/
+int attach_metrics(MetricsReader* reader_p, const char* shm_name){
+    const MetricsPage* p;
+    struct stat st;
+    int fd;
+
+    memset(reader_p, 0, sizeof(MetricsReader));
+    fd = shm_open(shm_name, O_RDONLY, 0);
+    if (fd < 0){
+        fprintf(stderr, "Failed to open shared memory %s: \"%s\"\n", shm_name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (fstat(fd, &st) || (size_t) st.st_size < sizeof(MetricsPage)){
+        fprintf(stderr, "Shared memory %s is not a metrics page (too small).\n", shm_name);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    p = (const MetricsPage*) mmap(NULL, sizeof(MetricsPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED){
+        fprintf(stderr, "Failed to map shared memory %s: \"%s\"\n", shm_name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    if (atomic_load_explicit(&p->version, memory_order_acquire) != METRICS_VERSION
+        || memcmp(p->magic, METRICS_MAGIC, sizeof(p->magic)) != 0
+        || p->page_size != sizeof(MetricsPage)){
+        fprintf(stderr, "Shared memory %s is not a valid metrics page.\n", shm_name);
+        munmap((void*) p, sizeof(MetricsPage));
+        return EXIT_FAILURE;
+    }
+
+    reader_p->map = (void*) p;
+    reader_p->map_size = sizeof(MetricsPage);
+    track_memory(reader_p->map, reader_p->map_size, MEMORY_SHM);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Copies the current values of the metrics page. Counters are read individually (not as an atomic
+snapshot), so related values may be off by the updates made during the copy.
+*/
+void read_metrics(const MetricsReader* reader_p, MetricsSnapshot* snap_p){
+    const MetricsPage* p = (const MetricsPage*) reader_p->map;
+    uint64_t bits = load(&p->samples_per_sec);
+
+    memset(snap_p, 0, sizeof(MetricsSnapshot));
+    snap_p->pid = p->pid;
+    snap_p->start_time = p->start_time;
+
+    snap_p->iterations = load(&p->iterations);
+    snap_p->proposals = load(&p->proposals);
+    snap_p->accepted = load(&p->accepted);
+    snap_p->acceptance_rate = snap_p->proposals ? (double) snap_p->accepted / (double) snap_p->proposals : 0;
+
+    snap_p->samples_written = load(&p->samples_written);
+    snap_p->bytes_written = load(&p->bytes_written);
+    snap_p->queue_depth = load(&p->queue_depth);
+    if ((int64_t) snap_p->queue_depth < 0) snap_p->queue_depth = 0;  // Updates seen out of order.
+    memcpy(&snap_p->samples_per_sec, &bits, sizeof(bits));
+    snap_p->fsyncs = load(&p->fsyncs);
+    snap_p->fsync_last_ns = load(&p->fsync_last_ns);
+    snap_p->fsync_max_ns = load(&p->fsync_max_ns);
+    snap_p->fsync_total_ns = load(&p->fsync_total_ns);
+
+    snap_p->loads = load(&p->loads);
+    snap_p->load_failures = load(&p->load_failures);
+    snap_p->load_bytes = load(&p->load_bytes);
+    snap_p->load_total_ns = load(&p->load_total_ns);
+    snap_p->load_max_ns = load(&p->load_max_ns);
+}
+
+
+void detach_metrics(MetricsReader* reader_p){
+    untrack_memory(reader_p->map);
+    if (reader_p->map) munmap(reader_p->map, reader_p->map_size);
+    memset(reader_p, 0, sizeof(MetricsReader));
+}
@@ -0,0 +1,69 @@
+#ifndef MCMC_METRICS_H
+#define MCMC_METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define METRICS_MAGIC "MCMCMTRC"
+#define METRICS_VERSION 1
+#define METRICS_RATE_WINDOW_NS 1000000000u  // Minimum interval over which samples/s is measured.
+
+// Copy of the metrics page, as read by a monitor.
+typedef struct {
+    int64_t pid;              // Process that created the page.
+    int64_t start_time;       // Creation time, in seconds since the epoch.
+
+    // Sampler
+    uint64_t iterations;
+    uint64_t proposals;
+    uint64_t accepted;
+    double acceptance_rate;   // accepted / proposals (0 if no proposals).
+
+    // Chain output
+    uint64_t samples_written;
+    uint64_t bytes_written;
+    uint64_t queue_depth;     // Samples accepted by the writers, not written to the file yet.
+    double samples_per_sec;   // Over the last rate window.
+    uint64_t fsyncs;
+    uint64_t fsync_last_ns;
+    uint64_t fsync_max_ns;
+    uint64_t fsync_total_ns;
+
+    // Input loads
+    uint64_t loads;
+    uint64_t load_failures;
+    uint64_t load_bytes;
+    uint64_t load_total_ns;
+    uint64_t load_max_ns;
+} MetricsSnapshot;
+
+// Metrics page attached for reading (see attach_metrics).
+typedef struct {
+    void* map;
+    size_t map_size;
+} MetricsReader;
+
+int open_metrics(const char* shm_name);
+void close_metrics(void);
+int metrics_enabled(void);
+
+void metrics_add_iterations(uint64_t n_iter, uint64_t n_proposed, uint64_t n_accepted);
+void metrics_add_queued(int64_t n_samples);
+void metrics_add_written(uint64_t n_samples, uint64_t n_bytes);
+void metrics_add_fsync(uint64_t latency_ns);
+uint64_t metrics_load_begin(void);
+void metrics_load_end(uint64_t start, uint64_t n_bytes, int status);
+
+int attach_metrics(MetricsReader* reader_p, const char* shm_name);
+void read_metrics(const MetricsReader* reader_p, MetricsSnapshot* snap_p);
+void detach_metrics(MetricsReader* reader_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
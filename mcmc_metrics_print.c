@@ -0,0 +1,83 @@
+/*
+Tool that prints the live metrics page of a running process (see mcmc_metrics.h).
+
+Usage:
+    mcmc_metrics_print <shm_name> [interval_s]
+
+Prints the page once, or every interval_s seconds until interrupted. In the repeated mode, the
+samples/s and iterations/s are also measured from the changes between two prints.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "mcmc_metrics.h"
+
+
+static double ms(uint64_t ns){
+    return ns / 1e6;
+}
+
+
+static void print_metrics(const MetricsSnapshot* m, const MetricsSnapshot* prev_p, double elapsed_s){
+    long uptime = (long) (time(NULL) - m->start_time);
+
+    printf("pid %lld, up %02ld:%02ld:%02ld\n", (long long) m->pid, uptime / 3600, uptime / 60 % 60, uptime % 60);
+    printf("  iterations       %llu", (unsigned long long) m->iterations);
+    if (prev_p) printf(" (%.1f/s)", (m->iterations - prev_p->iterations) / elapsed_s);
+    printf("\n  acceptance       %.4f (%llu/%llu)\n", m->acceptance_rate,
+        (unsigned long long) m->accepted, (unsigned long long) m->proposals);
+
+    printf("  samples written  %llu (%.1f/s", (unsigned long long) m->samples_written, m->samples_per_sec);
+    if (prev_p) printf(", %.1f/s since last print", (m->samples_written - prev_p->samples_written) / elapsed_s);
+    printf(")\n  bytes written    %llu\n", (unsigned long long) m->bytes_written);
+    printf("  queue depth      %llu\n", (unsigned long long) m->queue_depth);
+    printf("  fsync            %llu", (unsigned long long) m->fsyncs);
+    if (m->fsyncs){
+        printf(" (last %.3f ms, mean %.3f ms, max %.3f ms)", ms(m->fsync_last_ns),
+            ms(m->fsync_total_ns) / m->fsyncs, ms(m->fsync_max_ns));
+    }
+
+    printf("\n  loads            %llu (%llu failed, %llu bytes", (unsigned long long) m->loads,
+        (unsigned long long) m->load_failures, (unsigned long long) m->load_bytes);
+    if (m->loads) printf(", mean %.3f ms, max %.3f ms", ms(m->load_total_ns) / m->loads, ms(m->load_max_ns));
+    printf(")\n");
+    fflush(stdout);
+}
+
+
+int main(int argc, char *argv[])
+{
+    MetricsReader reader;
+    MetricsSnapshot snap, prev;
+    struct timespec t, prev_t, pause;
+    double interval = 0;
+
+    if (argc < 2 || argc > 3 || (argc == 3 && (interval = atof(argv[2])) <= 0)) {
+        fprintf(stderr, "Usage: %s <shm_name> [interval_s]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (attach_metrics(&reader, argv[1])) return EXIT_FAILURE;
+
+    read_metrics(&reader, &snap);
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    print_metrics(&snap, NULL, 0);
+
+    pause.tv_sec = (time_t) interval;
+    pause.tv_nsec = (long) ((interval - (double) pause.tv_sec) * 1e9);
+    while (interval > 0){
+        prev = snap;
+        prev_t = t;
+        nanosleep(&pause, NULL);
+
+        read_metrics(&reader, &snap);
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        printf("\n");
+        print_metrics(&snap, &prev, (t.tv_sec - prev_t.tv_sec) + (t.tv_nsec - prev_t.tv_nsec) / 1e9);
+    }
+
+    detach_metrics(&reader);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,345 @@
+/*
+Live mirror of the latest samples of a chain in shared memory, for out-of-process monitoring.
+
+The sampler pushes each sample into a ring of N slots in a POSIX shared memory object; monitor
+processes attach to it by name and read the most recent samples at any time, without locks,
+system calls or files. Pushing a sample costs a few stores and a copy of the sample, and is never
+slowed down by readers: each slot is protected by a sequence lock, so a reader that overlaps with
+the writer detects the torn copy and discards it, instead of blocking the writer.
+
+Layout of the shared memory object (native byte order):
+    RingHeader | parameter names (null-terminated, in order) | padding | N slots
+Each slot (SAMPLE_RING_ALIGNMENT-aligned) is:
+    uint64 seq | int64 iteration | n_params float64 values
+where seq is 2k + 1 while sample k (0-based count of samples pushed) is written, and 2k + 2 once it
+is complete. Sample k is in slot k % N. The header holds the number of samples pushed (head).
+The version field is stored last, so readers never see a partially initialized ring.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mcmc_ring.h"
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error "The sample ring requires lock-free 64-bit atomics (shared between processes)."
+#endif
+
+// Header of the shared memory object.
+typedef struct {
+    char magic[8];
+    _Atomic uint32_t version;  // Set once the ring is initialized.
+    uint32_t n_params;
+    uint64_t n_slots;
+    uint64_t slot_size;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint64_t slots_offset;
+    _Atomic uint64_t head;     // Number of samples pushed.
+} RingHeader;
+
+typedef struct {
+    _Atomic uint64_t seq;
+    int64_t iter;
+    double values[];
+} RingSlot;
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+static size_t round_up(size_t n, size_t alignment){
+    return (n + alignment - 1) / alignment * alignment;
+}
+
+
+static RingHeader* ring_header(const SampleRing* ring_p){
+    return (RingHeader*) ring_p->map;
+}
+
+
+static RingSlot* ring_slot(const SampleRing* ring_p, uint64_t k){
+    return (RingSlot*) (ring_p->slots + (k % ring_p->n_slots) * ring_p->slot_size);
+}
+
+
+static char* copy_string(const char* s){
+    char* copy = (char*) malloc(strlen(s) + 1);
+    if (copy) strcpy(copy, s);
+    return copy;
+}
+
+
+/*
+Copies sample k, if it is still in its slot and was not overwritten during the copy.
+The copy races with the writer by design (sequence lock); torn copies are discarded.
+*/
+static int read_slot(const SampleRing* ring_p, uint64_t k, int64_t* iter_p, double* values){
+    RingSlot* slot = ring_slot(ring_p, k);
+    uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    int64_t iter;
+
+    if (seq != 2 * k + 2) return 0;  // Being written, or overwritten by a later sample.
+
+    iter = slot->iter;
+    memcpy(values, slot->values, ring_p->n_params * sizeof(double));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq) return 0;
+
+    if (iter_p) *iter_p = iter;
+    return 1;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Creates a sample ring in a new shared memory object, replacing any existing object with the same
+name (monitors still attached to it keep their old mapping).
+
+@param name  Name of the shared memory object, as for shm_open (e.g. "/mcmc_chain0").
+@param n_params  Number of parameters in each sample.
+@param param_names  Names of the parameters. Copied into the ring.
+@param n_slots  Number of latest samples held.
+
+@return An integer error code.
+*/
+int create_sample_ring(SampleRing* ring_p, const char* name, size_t n_params,
+    const char* const* param_names, size_t n_slots){
+
+    RingHeader* header;
+    size_t names_size = 0, slot_size, slots_offset;
+    char* names;
+    int fd;
+
+    memset(ring_p, 0, sizeof(SampleRing));
+    if (n_slots == 0 || n_params > UINT32_MAX){
+        fprintf(stderr, "Invalid size of sample ring %s.\n", name);
+        return EXIT_FAILURE;
+    }
+
+    for (size_t p = 0; p < n_params; p++) names_size += strlen(param_names[p]) + 1;
+    slot_size = round_up(sizeof(RingSlot) + n_params * sizeof(double), SAMPLE_RING_ALIGNMENT);
+    slots_offset = round_up(sizeof(RingHeader) + names_size, SAMPLE_RING_ALIGNMENT);
+    if (n_slots > (SIZE_MAX - slots_offset) / slot_size){
+        fprintf(stderr, "Invalid size of sample ring %s.\n", name);
+        return EXIT_FAILURE;
+    }
+
+    ring_p->name = copy_string(name);
+    if (!ring_p->name){
+        fprintf(stderr, "Failed to allocate sample ring %s.\n", name);
+        return EXIT_FAILURE;
+    }
+
+    // --- Shared memory object, always new (so that readers never see it resized)
+    shm_unlink(name);
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0){
+        fprintf(stderr, "Failed to create shared memory %s: \"%s\"\n", name, strerror(errno));
+        free(ring_p->name); ring_p->name = NULL;
+        return EXIT_FAILURE;
+    }
+    ring_p->owner = 1;
+    ring_p->map_size = slots_offset + n_slots * slot_size;
+    if (ftruncate(fd, (off_t) ring_p->map_size)){
+        fprintf(stderr, "Failed to resize shared memory %s: \"%s\"\n", name, strerror(errno));
+        close(fd);
+        close_sample_ring(ring_p);
+        return EXIT_FAILURE;
+    }
+    ring_p->map = mmap(NULL, ring_p->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);  // The mapping remains valid.
+    if (ring_p->map == MAP_FAILED){
+        fprintf(stderr, "Failed to map shared memory %s: \"%s\"\n", name, strerror(errno));
+        ring_p->map = NULL;
+        close_sample_ring(ring_p);
+        return EXIT_FAILURE;
+    }
+    track_memory(ring_p->map, ring_p->map_size, MEMORY_SHM);
+
+    // --- Header and names (the object is zero-filled, so every slot is empty)
+    header = ring_header(ring_p);
+    header->n_params = (uint32_t) n_params;
+    header->n_slots = n_slots;
+    header->slot_size = slot_size;
+    header->names_offset = sizeof(RingHeader);
+    header->names_size = names_size;
+    header->slots_offset = slots_offset;
+    atomic_init(&header->head, 0);
+
+    names = (char*) ring_p->map + header->names_offset;
+    for (size_t p = 0; p < n_params; p++){
+        strcpy(names, param_names[p]);
+        names += strlen(param_names[p]) + 1;
+    }
+    memcpy(header->magic, SAMPLE_RING_MAGIC, sizeof(header->magic));
+    atomic_store_explicit(&header->version, SAMPLE_RING_VERSION, memory_order_release);
+
+    ring_p->n_params = n_params;
+    ring_p->n_slots = n_slots;
+    ring_p->slot_size = slot_size;
+    ring_p->slots = (unsigned char*) ring_p->map + slots_offset;
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Pushes a sample into the ring, overwriting the oldest one if it is full. Lock-free and wait-free;
+must only be called by the process (and thread) that created the ring.
+*/
+void push_sample_ring(SampleRing* ring_p, int64_t iter, const double* sample){
+    uint64_t k = ring_p->n_written++;
+    RingSlot* slot = ring_slot(ring_p, k);
+
+    atomic_store_explicit(&slot->seq, 2 * k + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->iter = iter;
+    memcpy(slot->values, sample, ring_p->n_params * sizeof(double));
+    atomic_store_explicit(&slot->seq, 2 * k + 2, memory_order_release);
+
+    atomic_store_explicit(&ring_header(ring_p)->head, k + 1, memory_order_release);
+}
+
+
+/*
+Attaches to an existing sample ring (read-only), e.g. from a monitor process.
+
+@param name  Name of the shared memory object, as given to create_sample_ring.
+
+@return An integer error code.
+*/
+int attach_sample_ring(SampleRing* ring_p, const char* name){
+    const RingHeader* header;
+    struct stat st;
+    int fd;
+
+    memset(ring_p, 0, sizeof(SampleRing));
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0){
+        fprintf(stderr, "Failed to open shared memory %s: \"%s\"\n", name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (fstat(fd, &st) || (size_t) st.st_size < sizeof(RingHeader)){
+        fprintf(stderr, "Shared memory %s is not a sample ring (too small).\n", name);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    ring_p->map_size = (size_t) st.st_size;
+    ring_p->map = mmap(NULL, ring_p->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring_p->map == MAP_FAILED){
+        fprintf(stderr, "Failed to map shared memory %s: \"%s\"\n", name, strerror(errno));
+        ring_p->map = NULL;
+        return EXIT_FAILURE;
+    }
+    track_memory(ring_p->map, ring_p->map_size, MEMORY_SHM);
+
+    header = ring_header(ring_p);
+    if (atomic_load_explicit(&header->version, memory_order_acquire) != SAMPLE_RING_VERSION
+        || memcmp(header->magic, SAMPLE_RING_MAGIC, sizeof(header->magic)) != 0
+        || header->n_slots == 0
+        || header->slot_size < sizeof(RingSlot) + header->n_params * sizeof(double)
+        || header->names_offset != sizeof(RingHeader)
+        || header->names_size > ring_p->map_size
+        || header->slots_offset < header->names_offset + header->names_size
+        || header->slots_offset > ring_p->map_size
+        || header->n_slots > (ring_p->map_size - header->slots_offset) / header->slot_size
+        || (header->names_size && ((const char*) ring_p->map)[header->names_offset + header->names_size - 1])){
+        fprintf(stderr, "Shared memory %s is not a valid sample ring.\n", name);
+        close_sample_ring(ring_p);
+        return EXIT_FAILURE;
+    }
+
+    ring_p->n_params = header->n_params;
+    ring_p->n_slots = header->n_slots;
+    ring_p->slot_size = header->slot_size;
+    ring_p->slots = (unsigned char*) ring_p->map + header->slots_offset;
+    ring_p->name = copy_string(name);  // Only used for messages; may be NULL.
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Returns the number of samples pushed into the ring so far.
+*/
+uint64_t sample_ring_count(const SampleRing* ring_p){
+    return atomic_load_explicit(&ring_header(ring_p)->head, memory_order_acquire);
+}
+
+
+/*
+Returns the name of parameter p, or NULL if p is out of range.
+*/
+const char* sample_ring_param_name(const SampleRing* ring_p, size_t p){
+    const RingHeader* header = ring_header(ring_p);
+    const char* name = (const char*) ring_p->map + header->names_offset;
+    const char* end = name + header->names_size;
+
+    if (p >= ring_p->n_params) return NULL;
+    for (; p > 0 && name < end; p--) name += strlen(name) + 1;
+    return (name < end) ? name : NULL;
+}
+
+
+/*
+Copies the most recent samples not read yet, oldest first. Never blocks the writer. Samples
+overwritten before they could be copied (the writer is more than n_slots samples ahead) are skipped.
+
+@param cursor_p  Number of samples already read; updated to the number pushed so far. If NULL,
+    the latest max_samples samples are read.
+@param max_samples  Maximum number of samples copied (the latest ones are kept).
+@param iters  Receives the iteration index of each sample copied. May be NULL.
+@param samples  Receives the samples, by row (max_samples * n_params values).
+
+@return The number of samples copied.
+*/
+size_t read_sample_ring(const SampleRing* ring_p, uint64_t* cursor_p, size_t max_samples,
+    int64_t* iters, double* samples){
+
+    uint64_t head = sample_ring_count(ring_p);
+    uint64_t first = cursor_p ? *cursor_p : 0;
+    size_t n = 0;
+
+    if (first > head || head - first > ring_p->n_slots)
+        first = (head > ring_p->n_slots) ? head - ring_p->n_slots : 0;
+    if (head - first > max_samples) first = head - max_samples;
+
+    for (uint64_t k = first; k < head; k++){
+        if (read_slot(ring_p, k, iters ? iters + n : NULL, samples + n * ring_p->n_params)) n++;
+    }
+    if (cursor_p) *cursor_p = head;
+    return n;
+}
+
+
+/*
+Unmaps the ring. The process that created it also removes the shared memory object (monitors
+still attached keep their mapping until they close it).
+*/
+void close_sample_ring(SampleRing* ring_p){
+    untrack_memory(ring_p->map);
+    if (ring_p->map) munmap(ring_p->map, ring_p->map_size);
+    if (ring_p->owner && ring_p->name) shm_unlink(ring_p->name);
+    free(ring_p->name);
+    memset(ring_p, 0, sizeof(SampleRing));
+}
+
+
+/*
+Returns the memory held by the mapping of a ring (shm).
+*/
+MemoryUsage sample_ring_memory(const SampleRing* ring_p){
+    return region_memory(ring_p->map, ring_p->map_size, MEMORY_SHM);
+}
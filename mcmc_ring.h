@@ -0,0 +1,48 @@
+#ifndef MCMC_RING_H
+#define MCMC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "mcmc_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLE_RING_MAGIC "MCMCRING"
+#define SAMPLE_RING_VERSION 1
+#define SAMPLE_RING_ALIGNMENT 64  // Alignment, in bytes, of the slots (one cache line).
+
+// Shared-memory ring holding the latest samples of a chain, written by the sampler and read by
+// monitor processes (see mcmc_ring.c for the layout).
+typedef struct {
+    void* map;
+    size_t map_size;
+    char* name;          // Name of the shared memory object (e.g. "/mcmc_chain0").
+    int owner;           // Whether this process created the ring (and unlinks it on close).
+
+    size_t n_params;
+    size_t n_slots;      // Number of samples held.
+    size_t slot_size;    // Bytes per slot.
+    unsigned char* slots;
+    uint64_t n_written;  // Samples pushed by this process (owner only).
+} SampleRing;
+
+int create_sample_ring(SampleRing* ring_p, const char* name, size_t n_params,
+    const char* const* param_names, size_t n_slots);
+void push_sample_ring(SampleRing* ring_p, int64_t iter, const double* sample);
+
+int attach_sample_ring(SampleRing* ring_p, const char* name);
+uint64_t sample_ring_count(const SampleRing* ring_p);
+const char* sample_ring_param_name(const SampleRing* ring_p, size_t p);
+size_t read_sample_ring(const SampleRing* ring_p, uint64_t* cursor_p, size_t max_samples,
+    int64_t* iters, double* samples);
+
+void close_sample_ring(SampleRing* ring_p);
+MemoryUsage sample_ring_memory(const SampleRing* ring_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,797 @@
+/*
+Rolling output of MCMC chains over size-capped segments, with background compression.
+
+A RollingChainWriter writes the chain through a ChainWriter (see mcmc_chain.h) into the segment
+"<prefix>.<k>.arrow", and rolls over to segment k + 1 when the segment reaches the size or number
+of iterations given in the options. Each segment is a complete Arrow IPC file, and the iteration
+column continues over segments, so the chain is the concatenation of the segments in order.
+
+Closed segments are compressed with zlib (gzip format, "<segment>.gz") by a small pool of threads
+running at the lowest priority, so that the sampler is not slowed down and only the hot segment
+stays uncompressed. The manifest "<prefix>.manifest.csv" lists the segments, as:
+
+    segment,first_iter,last_iter,bytes,state
+    chain.00000.arrow.gz,0,99999,41022571,compressed
+    chain.00001.arrow,100000,199999,160001432,closed
+    chain.00002.arrow,200000,199999,296,open
+
+with the segment file names relative to the manifest. It is rewritten (atomically, by renaming a
+temporary file) each time a segment is closed or compressed, so readers may open it at any time.
+An uncompressed segment is only removed once the manifest lists its compressed file, and the
+directory is synced after each rename, so that the manifest names existing files after a crash.
+
+A downsample of the whole chain for trace plots can be kept in the sidecar "<prefix>.lttb.csv"
+(downsample_rolling_chain_writer), which spans all the segments.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "mcmc_segment.h"
+#include "mcmc_trace.h"
+
+#define SEGMENT_IO_SIZE (1 << 20)   // Size, in bytes, of the chunks copied by (de)compression.
+#define SEGMENT_LINE_SIZE 4096      // Maximum length of a line of the manifest.
+
+static const char* const SEGMENT_STATE_NAMES[] = {"open", "closed", "compressed"};
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+// Returns a newly allocated string with the concatenation of a and b.
+static char* concat(const char* a, const char* b){
+    char* s = (char*) malloc(strlen(a) + strlen(b) + 1);
+
+    if (s){
+        strcpy(s, a);
+        strcat(s, b);
+    }
+    return s;
+}
+
+
+static char* segment_path(const char* prefix, size_t k){
+    char suffix[32];
+
+    snprintf(suffix, sizeof(suffix), ".%05zu.arrow", k);
+    return concat(prefix, suffix);
+}
+
+
+static const char* base_name(const char* path){
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+
+// Syncs the directory holding a file, so that a rename into it survives a crash.
+static int sync_parent_dir(const char* fname){
+    size_t dir_len = (size_t) (base_name(fname) - fname);
+    char* dir = (char*) malloc(dir_len + 2);
+    int fd, status = EXIT_SUCCESS;
+
+    if (!dir){
+        fprintf(stderr, "Failed to allocate directory name @ sync_parent_dir.\n");
+        return EXIT_FAILURE;
+    }
+    if (dir_len) memcpy(dir, fname, dir_len);
+    else dir[dir_len++] = '.';
+    dir[dir_len] = '\0';
+
+    fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0 || fsync(fd)){
+        fprintf(stderr, "Failed to sync directory %s: \"%s\"\n", dir, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    if (fd >= 0) close(fd);
+    free(dir);
+    return status;
+}
+
+
+static int file_size(const char* fname, int64_t* bytes_p){
+    struct stat st;
+
+    if (stat(fname, &st)){
+        fprintf(stderr, "Failed to stat %s: \"%s\"\n", fname, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    *bytes_p = (int64_t) st.st_size;
+    return EXIT_SUCCESS;
+}
+
+
+// Appends a segment, taking ownership of fname (freed if the list cannot grow).
+static int append_segment(ChainManifest* m, char* fname, int64_t first_iter, int64_t last_iter,
+    int64_t bytes, SegmentState state){
+
+    if (m->n_segments == m->capacity){
+        size_t new_capacity = m->capacity ? 2 * m->capacity : 16;
+        ChainSegment* new_segments = (ChainSegment*) realloc(m->segments, new_capacity * sizeof(ChainSegment));
+        if (!new_segments){
+            fprintf(stderr, "Failed to allocate the segment list @ append_segment.\n");
+            free(fname);
+            return EXIT_FAILURE;
+        }
+        m->segments = new_segments;
+        m->capacity = new_capacity;
+    }
+
+    m->segments[m->n_segments].fname = fname;
+    m->segments[m->n_segments].first_iter = first_iter;
+    m->segments[m->n_segments].last_iter = last_iter;
+    m->segments[m->n_segments].bytes = bytes;
+    m->segments[m->n_segments].state = state;
+    m->n_segments++;
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Rewrites the manifest of a rolling writer: written to a temporary file, synced, then renamed over
+the previous one (and the directory synced), so readers always find a complete manifest. Called
+with the mutex held.
+*/
+static int write_manifest(RollingChainWriter* w){
+    char* fname = concat(w->prefix, ".manifest.csv");
+    char* tmp_fname = fname ? concat(fname, ".tmp") : NULL;
+    const ChainSegment* seg;
+    FILE* fp;
+    int status = EXIT_SUCCESS;
+
+    if (!tmp_fname){
+        fprintf(stderr, "Failed to allocate manifest name @ write_manifest.\n");
+        free(fname);
+        return EXIT_FAILURE;
+    }
+
+    fp = fopen(tmp_fname, "w");
+    if (!fp){
+        fprintf(stderr, "Failed to open %s: \"%s\"\n", tmp_fname, strerror(errno));
+        free(fname); free(tmp_fname);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(fp, "segment,first_iter,last_iter,bytes,state\n");
+    for (size_t k = 0; k < w->manifest.n_segments; k++){
+        seg = &w->manifest.segments[k];
+        fprintf(fp, "%s,%lld,%lld,%lld,%s\n", base_name(seg->fname), (long long) seg->first_iter,
+            (long long) seg->last_iter, (long long) seg->bytes, SEGMENT_STATE_NAMES[seg->state]);
+    }
+
+    if (fflush(fp) || fsync(fileno(fp))){
+        fprintf(stderr, "Failed to write to %s: \"%s\"\n", tmp_fname, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    if (fclose(fp) && status == EXIT_SUCCESS){
+        fprintf(stderr, "Failed to close %s: \"%s\"\n", tmp_fname, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    if (status == EXIT_SUCCESS && rename(tmp_fname, fname)){
+        fprintf(stderr, "Failed to rename %s: \"%s\"\n", tmp_fname, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    if (status == EXIT_SUCCESS) status = sync_parent_dir(fname);
+
+    free(fname); free(tmp_fname);
+    return status;
+}
+
+
+/*
+Compresses src into dst (gzip), through a temporary file that is synced and renamed. The source is
+left in place, to be removed by the caller once the manifest lists dst.
+*/
+static int compress_segment(const char* src, const char* dst, int level, int64_t* bytes_p){
+    char* tmp_fname = concat(dst, ".tmp");
+    unsigned char* buf = (unsigned char*) malloc(SEGMENT_IO_SIZE);
+    char mode[16] = "wb";
+    FILE* in = NULL;
+    gzFile out = NULL;
+    int fd = -1;
+    size_t n;
+    uint64_t in_bytes = 0;
+    int status = EXIT_SUCCESS;
+    TraceSpan span = trace_begin("segment", "compress_segment");
+
+    if (!tmp_fname || !buf){
+        fprintf(stderr, "Failed to allocate compression buffers @ compress_segment.\n");
+        free(tmp_fname); free(buf);
+        trace_end(span);
+        return EXIT_FAILURE;
+    }
+    if (level > 0) snprintf(mode, sizeof(mode), "wb%d", level);
+
+    in = fopen(src, "rb");
+    if (!in){
+        fprintf(stderr, "Failed to open %s: \"%s\"\n", src, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    if (status == EXIT_SUCCESS){
+        int gz_fd;
+
+        fd = open(tmp_fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        gz_fd = (fd >= 0) ? dup(fd) : -1;  // Closed by gzclose; fd is kept for the fsync.
+        if (gz_fd >= 0) out = gzdopen(gz_fd, mode);
+        if (!out){
+            if (gz_fd >= 0) close(gz_fd);
+            fprintf(stderr, "Failed to open %s: \"%s\"\n", tmp_fname, strerror(errno));
+            status = EXIT_FAILURE;
+        }
+    }
+
+    while (status == EXIT_SUCCESS && (n = fread(buf, 1, SEGMENT_IO_SIZE, in)) > 0){
+        if (gzwrite(out, buf, (unsigned) n) != (int) n){
+            int errnum;
+            fprintf(stderr, "Failed to compress %s: \"%s\"\n", src, gzerror(out, &errnum));
+            status = EXIT_FAILURE;
+        }
+        in_bytes += n;
+    }
+    if (status == EXIT_SUCCESS && ferror(in)){
+        fprintf(stderr, "Failed to read %s: \"%s\"\n", src, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+
+    if (out && gzclose(out) != Z_OK && status == EXIT_SUCCESS){
+        fprintf(stderr, "Failed to write to %s.\n", tmp_fname);
+        status = EXIT_FAILURE;
+    }
+    if (fd >= 0){
+        if (status == EXIT_SUCCESS && fsync(fd)){
+            fprintf(stderr, "Failed to sync %s: \"%s\"\n", tmp_fname, strerror(errno));
+            status = EXIT_FAILURE;
+        }
+        close(fd);
+    }
+    if (in) fclose(in);
+
+    if (status == EXIT_SUCCESS && rename(tmp_fname, dst)){
+        fprintf(stderr, "Failed to rename %s: \"%s\"\n", tmp_fname, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    if (status == EXIT_SUCCESS) status = sync_parent_dir(dst);
+    if (status == EXIT_SUCCESS){
+        status = file_size(dst, bytes_p);
+    }
+    else if (fd >= 0){
+        unlink(tmp_fname);
+    }
+
+    free(tmp_fname); free(buf);
+    trace_end_bytes(span, in_bytes);
+    return status;
+}
+
+
+/*
+Compression thread: takes the segments from the queue, in order, until the writer is closed and
+the queue is empty. Runs at the lowest priority (on Linux, the nice value is per thread). The
+uncompressed segment is removed only after the manifest pointing to the compressed one is written;
+if that write fails, it is left in place.
+*/
+static void* compress_thread(void* writer_vp){
+    RollingChainWriter* w = (RollingChainWriter*) writer_vp;
+    char* src;
+    char* dst;
+    int64_t bytes = 0;
+    size_t k;
+    int status;
+
+    trace_set_thread_name("segment compression");
+    setpriority(PRIO_PROCESS, 0, SEGMENT_COMPRESS_NICE);
+
+    pthread_mutex_lock(&w->mutex);
+    while (1){
+        while (w->n_jobs == 0 && !w->stopping) pthread_cond_wait(&w->cond, &w->mutex);
+        if (w->n_jobs == 0) break;
+
+        k = w->jobs[0];
+        memmove(w->jobs, w->jobs + 1, --w->n_jobs * sizeof(size_t));
+        src = w->manifest.segments[k].fname;  // Not freed while queued.
+        pthread_mutex_unlock(&w->mutex);
+
+        dst = concat(src, ".gz");
+        status = dst ? compress_segment(src, dst, w->opts.compress_level, &bytes) : EXIT_FAILURE;
+
+        pthread_mutex_lock(&w->mutex);
+        if (status == EXIT_SUCCESS){
+            w->manifest.segments[k].fname = dst;
+            w->manifest.segments[k].bytes = bytes;
+            w->manifest.segments[k].state = SEGMENT_COMPRESSED;
+            if (write_manifest(w) == EXIT_SUCCESS){
+                pthread_mutex_unlock(&w->mutex);
+                unlink(src);
+                pthread_mutex_lock(&w->mutex);
+            }
+            free(src);
+        }
+        else{
+            free(dst);
+            w->n_failed++;
+        }
+    }
+    pthread_mutex_unlock(&w->mutex);
+    return NULL;
+}
+
+
+/*
+Marks the last segment as closed, with its final size, and queues it for compression. Called with
+the mutex held, once the segment file is closed.
+*/
+static int close_last_segment(RollingChainWriter* w){
+    ChainSegment* seg = &w->manifest.segments[w->manifest.n_segments - 1];
+
+    seg->state = SEGMENT_CLOSED;
+    seg->last_iter = w->next_iter - 1;
+    if (file_size(seg->fname, &seg->bytes)) return EXIT_FAILURE;
+    if (w->n_threads == 0) return EXIT_SUCCESS;
+
+    if (w->n_jobs == w->jobs_capacity){
+        size_t new_capacity = w->jobs_capacity ? 2 * w->jobs_capacity : 16;
+        size_t* new_jobs = (size_t*) realloc(w->jobs, new_capacity * sizeof(size_t));
+        if (!new_jobs){
+            fprintf(stderr, "Failed to allocate compression queue @ close_last_segment.\n");
+            return EXIT_FAILURE;
+        }
+        w->jobs = new_jobs;
+        w->jobs_capacity = new_capacity;
+    }
+    w->jobs[w->n_jobs++] = w->manifest.n_segments - 1;
+    pthread_cond_signal(&w->cond);
+    return EXIT_SUCCESS;
+}
+
+
+// Opens the next segment, continuing the iteration count, and lists it in the manifest.
+static int open_next_segment(RollingChainWriter* w){
+    char* fname = segment_path(w->prefix, w->manifest.n_segments);
+    int status;
+
+    if (!fname){
+        fprintf(stderr, "Failed to allocate segment name @ open_next_segment.\n");
+        return EXIT_FAILURE;
+    }
+    if (open_chain_writer(&w->writer, fname, w->n_params, (const char* const*) w->param_names,
+        w->batch_iters)){
+        free(fname);
+        return EXIT_FAILURE;
+    }
+    w->writer.next_iter = w->next_iter;
+    w->segment_start = w->next_iter;
+
+    pthread_mutex_lock(&w->mutex);
+    status = append_segment(&w->manifest, fname, w->next_iter, w->next_iter - 1,
+        w->writer.file_pos, SEGMENT_OPEN);
+    pthread_mutex_unlock(&w->mutex);
+    return status;
+}
+
+
+// Waits for the queued compressions and joins the threads.
+static void stop_compress_threads(RollingChainWriter* w){
+    pthread_mutex_lock(&w->mutex);
+    w->stopping = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+
+    for (int i = 0; i < w->n_threads; i++) pthread_join(w->threads[i], NULL);
+    w->n_threads = 0;
+}
+
+
+static void free_rolling_chain_writer(RollingChainWriter* w){
+    if (w->param_names){
+        for (size_t p = 0; p < w->n_params; p++) free(w->param_names[p]);
+    }
+    free(w->param_names); w->param_names = NULL;
+    free(w->prefix); w->prefix = NULL;
+    free(w->jobs); w->jobs = NULL;
+    free(w->threads); w->threads = NULL;
+    free_chain_manifest(&w->manifest);
+    free_downsample_sidecar(&w->sidecar);
+    pthread_mutex_destroy(&w->mutex);
+    pthread_cond_destroy(&w->cond);
+    w->n_jobs = w->jobs_capacity = 0;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Opens a rolling chain writer: the first segment, the manifest and the compression threads.
+
+@param writer_p  Pointer to a RollingChainWriter struct, which is initialized. Must not be moved
+    while open.
+@param prefix  Path prefix of the segments and manifest (e.g. "out/chain" gives "out/chain.00000.arrow"
+    and "out/chain.manifest.csv").
+@param n_params  Number of parameters in each sample.
+@param param_names  Names of the parameters (column names). Copied.
+@param batch_iters  Number of iterations buffered in each record batch.
+@param opts_p  Segment limits and compression options (see RollingOptions).
+
+@return An integer error code.
+*/
+int open_rolling_chain_writer(RollingChainWriter* writer_p, const char* prefix, size_t n_params,
+    const char* const* param_names, size_t batch_iters, const RollingOptions* opts_p){
+
+    memset(writer_p, 0, sizeof(RollingChainWriter));
+    writer_p->n_params = n_params;
+    writer_p->batch_iters = batch_iters;
+    writer_p->opts = *opts_p;
+    pthread_mutex_init(&writer_p->mutex, NULL);
+    pthread_cond_init(&writer_p->cond, NULL);
+
+    writer_p->prefix = concat(prefix, "");
+    writer_p->param_names = (char**) calloc(n_params, sizeof(char*));
+    if (!writer_p->prefix || !writer_p->param_names){
+        fprintf(stderr, "Failed to allocate rolling chain writer @ open_rolling_chain_writer.\n");
+        free_rolling_chain_writer(writer_p);
+        return EXIT_FAILURE;
+    }
+    for (size_t p = 0; p < n_params; p++){
+        writer_p->param_names[p] = concat(param_names[p], "");
+        if (!writer_p->param_names[p]){
+            fprintf(stderr, "Failed to allocate parameter names @ open_rolling_chain_writer.\n");
+            free_rolling_chain_writer(writer_p);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (open_next_segment(writer_p)){
+        free_rolling_chain_writer(writer_p);
+        return EXIT_FAILURE;
+    }
+
+    pthread_mutex_lock(&writer_p->mutex);
+    if (write_manifest(writer_p)){
+        pthread_mutex_unlock(&writer_p->mutex);
+        close_chain_writer(&writer_p->writer);
+        free_rolling_chain_writer(writer_p);
+        return EXIT_FAILURE;
+    }
+    pthread_mutex_unlock(&writer_p->mutex);
+
+    // --- Compression threads
+    if (opts_p->n_compress_threads > 0){
+        writer_p->threads = (pthread_t*) malloc(opts_p->n_compress_threads * sizeof(pthread_t));
+        for (int i = 0; writer_p->threads && i < opts_p->n_compress_threads; i++){
+            if (pthread_create(&writer_p->threads[i], NULL, compress_thread, writer_p)) break;
+            writer_p->n_threads++;
+        }
+        if (writer_p->n_threads == 0){
+            fprintf(stderr, "Failed to start compression threads @ open_rolling_chain_writer.\n");
+            close_chain_writer(&writer_p->writer);
+            free_rolling_chain_writer(writer_p);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Keeps a downsample of the whole chain, over all segments, for trace plots (see
+downsample_chain_writer). The sidecar is rewritten at each roll, every update_iters iterations
+(at the first flush after them) and at close. A sidecar of the segment writer itself would only
+cover its segment, and is lost at the roll.
+
+@param sidecar_fname  Path of the sidecar. NULL for the prefix plus ".lttb.csv".
+@param n_points  Number of points of the downsample of each parameter (e.g. 5000).
+@param update_iters  Iterations between rewrites of the sidecar. 0 to write it only at rolls and close.
+
+@return An integer error code.
+*/
+int downsample_rolling_chain_writer(RollingChainWriter* writer_p, const char* sidecar_fname,
+    size_t n_points, int64_t update_iters){
+
+    return open_downsample_sidecar(&writer_p->sidecar, sidecar_fname ? sidecar_fname : writer_p->prefix,
+        sidecar_fname ? "" : ".lttb.csv", writer_p->n_params, n_points, update_iters, writer_p->next_iter);
+}
+
+
+/*
+Appends one sample (n_params values) to the chain, first rolling over to a new segment if the
+current one has reached its size or number of iterations.
+*/
+int write_rolling_chain_sample(RollingChainWriter* writer_p, const double* sample){
+    int64_t n_iters = writer_p->next_iter - writer_p->segment_start;
+    int64_t iter = writer_p->next_iter;
+    int status;
+
+    if (!writer_p->writer.fp){
+        fprintf(stderr, "Failed to write to %s: no open segment.\n", writer_p->prefix);
+        return EXIT_FAILURE;
+    }
+
+    if (n_iters > 0 && ((writer_p->opts.max_iters > 0 && n_iters >= writer_p->opts.max_iters)
+        || (writer_p->opts.max_bytes > 0 && writer_p->writer.file_pos >= writer_p->opts.max_bytes))){
+        if (roll_chain_writer(writer_p)) return EXIT_FAILURE;
+    }
+
+    // The iteration count follows the segment writer, which only counts the samples it accepted.
+    status = write_chain_sample(&writer_p->writer, sample);
+    writer_p->next_iter = writer_p->writer.next_iter;
+
+    if (writer_p->sidecar.fname && writer_p->next_iter > iter){  // Sample accepted
+        add_downsample_sample(&writer_p->sidecar.ds, iter, sample);
+        if (writer_p->writer.n_buffered == 0)  // Just flushed
+            update_downsample_sidecar(&writer_p->sidecar, writer_p->next_iter,
+                (const char* const*) writer_p->param_names);
+    }
+    return status;
+}
+
+
+/*
+Appends n_iter samples, stored by row (sample i at samples[i * n_params]).
+*/
+int write_rolling_chain_samples(RollingChainWriter* writer_p, const double* samples, size_t n_iter){
+    for (size_t i = 0; i < n_iter; i++){
+        if (write_rolling_chain_sample(writer_p, samples + i * writer_p->n_params))
+            return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Closes the current segment (queuing it for compression) and opens the next one. Called by the
+write functions at the segment limits, but may also be called directly, e.g. at checkpoints.
+
+@return An integer error code. If the next segment cannot be opened, later writes fail.
+*/
+int roll_chain_writer(RollingChainWriter* writer_p){
+    TraceSpan span;
+    int status;
+
+    if (!writer_p->writer.fp){
+        fprintf(stderr, "Failed to roll %s: no open segment.\n", writer_p->prefix);
+        return EXIT_FAILURE;
+    }
+
+    span = trace_begin("segment", "roll_chain_writer");
+    status = close_chain_writer(&writer_p->writer);
+
+    pthread_mutex_lock(&writer_p->mutex);
+    if (close_last_segment(writer_p)) status = EXIT_FAILURE;
+    pthread_mutex_unlock(&writer_p->mutex);
+
+    if (open_next_segment(writer_p)) status = EXIT_FAILURE;
+
+    pthread_mutex_lock(&writer_p->mutex);
+    if (write_manifest(writer_p)) status = EXIT_FAILURE;
+    pthread_mutex_unlock(&writer_p->mutex);
+
+    if (writer_p->sidecar.fname && write_downsample(&writer_p->sidecar.ds, writer_p->sidecar.fname,
+        (const char* const*) writer_p->param_names))
+        status = EXIT_FAILURE;
+
+    trace_end(span);
+    return status;
+}
+
+
+/*
+Closes the current segment, waits for the compression of all closed segments and writes the final
+manifest. The writer is freed even if an error occurs. Segments that could not be compressed are
+left in place, uncompressed, and listed as closed.
+
+@return An integer error code.
+*/
+int close_rolling_chain_writer(RollingChainWriter* writer_p){
+    TraceSpan span = trace_begin("segment", "close_rolling_chain_writer");
+    int status = EXIT_SUCCESS;
+
+    if (writer_p->writer.fp){
+        if (close_chain_writer(&writer_p->writer)) status = EXIT_FAILURE;
+
+        pthread_mutex_lock(&writer_p->mutex);
+        if (close_last_segment(writer_p)) status = EXIT_FAILURE;
+        pthread_mutex_unlock(&writer_p->mutex);
+    }
+
+    stop_compress_threads(writer_p);
+
+    if (writer_p->n_failed){
+        fprintf(stderr, "Failed to compress %zu segments of %s.\n", writer_p->n_failed, writer_p->prefix);
+        status = EXIT_FAILURE;
+    }
+    if (write_manifest(writer_p)) status = EXIT_FAILURE;
+    if (writer_p->sidecar.fname && write_downsample(&writer_p->sidecar.ds, writer_p->sidecar.fname,
+        (const char* const*) writer_p->param_names))
+        status = EXIT_FAILURE;
+
+    free_rolling_chain_writer(writer_p);
+    trace_end(span);
+    return status;
+}
+
+
+/*
+Reads the manifest of a rolling chain. The segment paths are completed with the directory of the
+manifest, so they can be opened directly.
+
+@param fname  Path of the manifest ("<prefix>.manifest.csv").
+@param manifest_p  Pointer to a ChainManifest struct, which is filled. Free with free_chain_manifest.
+
+@return An integer error code.
+*/
+int read_chain_manifest(const char* fname, ChainManifest* manifest_p){
+    char line[SEGMENT_LINE_SIZE];
+    char* fields[4];  // first_iter, last_iter, bytes, state
+    char* end;
+    char* path;
+    size_t dir_len = (size_t) (base_name(fname) - fname);
+    size_t line_no = 1;
+    long long values[3];
+    int n_fields, valid, state;
+    int status = EXIT_SUCCESS;
+    FILE* fp;
+
+    memset(manifest_p, 0, sizeof(ChainManifest));
+
+    fp = fopen(fname, "r");
+    if (!fp){
+        fprintf(stderr, "Failed to open %s: \"%s\"\n", fname, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    if (!fgets(line, sizeof(line), fp) || strncmp(line, "segment,", 8)){
+        fprintf(stderr, "Failed to read %s: missing header.\n", fname);
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+
+    while (status == EXIT_SUCCESS && fgets(line, sizeof(line), fp)){
+        line_no++;
+        end = strchr(line, '\n');
+        if (!end && !feof(fp)){
+            fprintf(stderr, "Failed to read %s: line %zu is too long.\n", fname, line_no);
+            status = EXIT_FAILURE;
+            break;
+        }
+        if (end) *end = '\0';
+        if (line[0] == '\0') continue;
+
+        // Fields are split from the right, so that segment names may contain commas.
+        for (n_fields = 0; n_fields < 4 && (end = strrchr(line, ',')); n_fields++){
+            *end = '\0';
+            fields[3 - n_fields] = end + 1;
+        }
+        if (n_fields < 4){
+            fprintf(stderr, "Failed to read %s: line %zu has too few fields.\n", fname, line_no);
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        valid = 1;
+        for (int i = 0; i < 3; i++){
+            values[i] = strtoll(fields[i], &end, 10);
+            if (end == fields[i] || *end != '\0') valid = 0;
+        }
+        for (state = 0; state < 3 && strcmp(fields[3], SEGMENT_STATE_NAMES[state]); state++);
+        if (!valid || state == 3){
+            fprintf(stderr, "Failed to read %s: invalid value at line %zu.\n", fname, line_no);
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        path = (char*) malloc(dir_len + strlen(line) + 1);
+        if (!path){
+            fprintf(stderr, "Failed to allocate segment name @ read_chain_manifest.\n");
+            status = EXIT_FAILURE;
+            break;
+        }
+        memcpy(path, fname, dir_len);
+        strcpy(path + dir_len, line);
+
+        status = append_segment(manifest_p, path, values[0], values[1], values[2], (SegmentState) state);
+    }
+
+    if (status == EXIT_SUCCESS && ferror(fp)){
+        fprintf(stderr, "Failed to read %s: \"%s\"\n", fname, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+
+    fclose(fp);
+    if (status != EXIT_SUCCESS) free_chain_manifest(manifest_p);
+    return status;
+}
+
+
+/*
+Returns the index of the segment holding an iteration, or n_segments if none does. The open
+segment holds all the iterations from its first one, as its range in the manifest is only updated
+when it is closed.
+*/
+size_t find_chain_segment(const ChainManifest* manifest_p, int64_t iter){
+    size_t lo = 0, hi = manifest_p->n_segments, mid;
+    const ChainSegment* seg;
+
+    // Last segment with first_iter <= iter
+    while (lo < hi){
+        mid = lo + (hi - lo) / 2;
+        if (manifest_p->segments[mid].first_iter <= iter) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return manifest_p->n_segments;
+
+    seg = &manifest_p->segments[lo - 1];
+    if (iter <= seg->last_iter || seg->state == SEGMENT_OPEN) return lo - 1;
+    return manifest_p->n_segments;
+}
+
+
+/*
+Decompresses a compressed segment (gzip) into an Arrow IPC file, which can then be read or mapped
+as any chain file.
+
+@return An integer error code.
+*/
+int inflate_chain_segment(const char* gz_fname, const char* out_fname){
+    unsigned char* buf = (unsigned char*) malloc(SEGMENT_IO_SIZE);
+    gzFile in;
+    FILE* out;
+    int n, errnum;
+    int status = EXIT_SUCCESS;
+
+    if (!buf){
+        fprintf(stderr, "Failed to allocate buffer @ inflate_chain_segment.\n");
+        return EXIT_FAILURE;
+    }
+
+    in = gzopen(gz_fname, "rb");
+    if (!in){
+        fprintf(stderr, "Failed to open %s: \"%s\"\n", gz_fname, strerror(errno));
+        free(buf);
+        return EXIT_FAILURE;
+    }
+    out = fopen(out_fname, "wb");
+    if (!out){
+        fprintf(stderr, "Failed to open %s: \"%s\"\n", out_fname, strerror(errno));
+        gzclose(in); free(buf);
+        return EXIT_FAILURE;
+    }
+
+    while ((n = gzread(in, buf, SEGMENT_IO_SIZE)) > 0){
+        if (fwrite(buf, 1, (size_t) n, out) != (size_t) n){
+            fprintf(stderr, "Failed to write to %s: \"%s\"\n", out_fname, strerror(errno));
+            status = EXIT_FAILURE;
+            break;
+        }
+    }
+    if (n < 0){
+        fprintf(stderr, "Failed to decompress %s: \"%s\"\n", gz_fname, gzerror(in, &errnum));
+        status = EXIT_FAILURE;
+    }
+
+    gzclose(in);
+    if (fclose(out) && status == EXIT_SUCCESS){
+        fprintf(stderr, "Failed to close %s: \"%s\"\n", out_fname, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    free(buf);
+    return status;
+}
+
+
+void free_chain_manifest(ChainManifest* manifest_p){
+    for (size_t k = 0; k < manifest_p->n_segments; k++) free(manifest_p->segments[k].fname);
+    free(manifest_p->segments);
+    manifest_p->segments = NULL;
+    manifest_p->n_segments = manifest_p->capacity = 0;
+}
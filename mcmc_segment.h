@@ -0,0 +1,89 @@
+#ifndef MCMC_SEGMENT_H
+#define MCMC_SEGMENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "mcmc_chain.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SEGMENT_COMPRESS_NICE 19  // Nice value of the compression threads (lowest priority).
+
+// State of a segment of a rolling chain, as listed in the manifest.
+typedef enum {
+    SEGMENT_OPEN = 0,       // Being written (the hot file).
+    SEGMENT_CLOSED = 1,     // Complete Arrow IPC file.
+    SEGMENT_COMPRESSED = 2  // Complete Arrow IPC file, gzip-compressed (".gz").
+} SegmentState;
+
+// Segment of a rolling chain: one Arrow IPC file with consecutive iterations.
+typedef struct {
+    char* fname;          // Path of the file (the manifest only holds its base name).
+    int64_t first_iter;
+    int64_t last_iter;    // Inclusive. For an open segment, the last iteration flushed so far.
+    int64_t bytes;        // Size of the file.
+    SegmentState state;
+} ChainSegment;
+
+// List of the segments of a rolling chain, in iteration order.
+typedef struct {
+    ChainSegment* segments;
+    size_t n_segments;
+    size_t capacity;
+} ChainManifest;
+
+// Options of a rolling chain writer. Zero values disable the corresponding feature.
+typedef struct {
+    int64_t max_bytes;         // Size at which a segment is closed (checked before each sample).
+    int64_t max_iters;         // Number of iterations after which a segment is closed.
+    int n_compress_threads;    // Threads compressing the closed segments. 0 to leave them uncompressed.
+    int compress_level;        // zlib level, 1-9. 0 for the zlib default.
+} RollingOptions;
+
+// Chain writer that rolls its output over size-capped segments "<prefix>.<k>.arrow", listed in the
+// manifest "<prefix>.manifest.csv". Must not be moved while open.
+typedef struct {
+    ChainWriter writer;        // Current segment.
+    char* prefix;
+    size_t n_params;
+    char* *param_names;
+    size_t batch_iters;
+    RollingOptions opts;
+    int64_t next_iter;         // Iteration of the next sample, counted over all segments.
+    int64_t segment_start;     // First iteration of the current segment.
+    DownsampleSidecar sidecar; // Trace-plot sidecar over all segments (see downsample_rolling_chain_writer).
+
+    pthread_mutex_t mutex;     // Guards the fields below, shared with the compression threads.
+    pthread_cond_t cond;
+    ChainManifest manifest;
+    size_t *jobs;              // Segments waiting for compression, in order.
+    size_t n_jobs;
+    size_t jobs_capacity;
+    int stopping;              // Set at close: the threads exit once the queue is empty.
+    size_t n_failed;           // Segments left uncompressed because compression failed.
+    pthread_t* threads;
+    int n_threads;
+} RollingChainWriter;
+
+int open_rolling_chain_writer(RollingChainWriter* writer_p, const char* prefix, size_t n_params,
+    const char* const* param_names, size_t batch_iters, const RollingOptions* opts_p);
+int downsample_rolling_chain_writer(RollingChainWriter* writer_p, const char* sidecar_fname,
+    size_t n_points, int64_t update_iters);
+int write_rolling_chain_sample(RollingChainWriter* writer_p, const double* sample);
+int write_rolling_chain_samples(RollingChainWriter* writer_p, const double* samples, size_t n_iter);
+int roll_chain_writer(RollingChainWriter* writer_p);
+int close_rolling_chain_writer(RollingChainWriter* writer_p);
+
+int read_chain_manifest(const char* fname, ChainManifest* manifest_p);
+size_t find_chain_segment(const ChainManifest* manifest_p, int64_t iter);
+int inflate_chain_segment(const char* gz_fname, const char* out_fname);
+void free_chain_manifest(ChainManifest* manifest_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
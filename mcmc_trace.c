@@ -0,0 +1,293 @@
+/*
+Lightweight tracing of the load and write pipelines, exported in the Chrome Trace Event format
+(JSON), which can be opened in Perfetto (ui.perfetto.dev) or chrome://tracing.
+
+Instrumented code times spans with trace_begin / trace_end. When tracing is disabled (the
+default), a span costs one atomic load. When enabled, each thread records its spans into its own
+buffer, allocated on its first span and registered in a global lock-free list, so that recording
+never takes a lock nor contends with other threads. Buffers have a fixed capacity; spans beyond it
+are dropped (and counted) rather than allocating on the hot path. Buffers outlive their threads,
+so the spans of finished workers (e.g. background loads) are still exported.
+
+Usage:
+    trace_start(0);                   // Default capacity per thread.
+    ... loads, writers ...
+    trace_export_json("trace.json");
+    trace_clear();                    // Frees the buffers (no instrumented code may be running).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mcmc_trace.h"
+
+// Complete event ("ph": "X").
+typedef struct {
+    const char* category;
+    const char* name;
+    uint64_t start_ns;  // Since the start of the trace.
+    uint64_t dur_ns;
+    uint64_t n_bytes;
+    int has_bytes;
+} TraceEvent;
+
+// Events of one thread. Only the owner thread writes; count and named are published with release
+// stores.
+typedef struct TraceBuffer {
+    struct TraceBuffer* next;
+    uint32_t tid;
+    atomic_int named;  // Set once thread_name is written; the name is not changed after.
+    char thread_name[TRACE_THREAD_NAME_SIZE];
+    size_t capacity;
+    atomic_size_t count;
+    atomic_size_t dropped;
+    TraceEvent events[];
+} TraceBuffer;
+
+static _Atomic(TraceBuffer*) buffers;  // All buffers, most recent first.
+static atomic_int enabled;
+static atomic_uint epoch;              // Incremented by trace_clear, invalidating thread buffers.
+static atomic_size_t capacity = TRACE_DEFAULT_CAPACITY;
+static atomic_uint next_tid;
+static atomic_uint_least64_t origin_ns;  // Time origin of the trace.
+
+static _Thread_local TraceBuffer* local_buffer;  // Valid only if local_epoch is the current epoch.
+static _Thread_local unsigned local_epoch;
+
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+
+// Returns the buffer of the calling thread, allocating and registering it if needed (NULL on failure).
+static TraceBuffer* thread_buffer(void){
+    unsigned current = atomic_load_explicit(&epoch, memory_order_acquire);
+    TraceBuffer* b = local_buffer;
+    size_t n_events;
+
+    if (b && local_epoch == current) return b;
+
+    n_events = atomic_load_explicit(&capacity, memory_order_relaxed);
+    b = (TraceBuffer*) malloc(sizeof(TraceBuffer) + n_events * sizeof(TraceEvent));
+    if (!b) return NULL;
+
+    b->tid = atomic_fetch_add_explicit(&next_tid, 1, memory_order_relaxed) + 1;
+    atomic_init(&b->named, 0);
+    b->thread_name[0] = '\0';
+    b->capacity = n_events;
+    atomic_init(&b->count, 0);
+    atomic_init(&b->dropped, 0);
+
+    b->next = atomic_load_explicit(&buffers, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&buffers, &b->next, b,
+        memory_order_release, memory_order_relaxed));
+
+    local_buffer = b;
+    local_epoch = current;
+    return b;
+}
+
+
+static void record(TraceSpan span, uint64_t n_bytes, int has_bytes){
+    uint64_t end_ns;
+    TraceBuffer* b;
+    size_t i;
+
+    if (!span.start_ns) return;
+    end_ns = now_ns();
+
+    b = thread_buffer();
+    if (!b) return;
+
+    i = atomic_load_explicit(&b->count, memory_order_relaxed);
+    if (i == b->capacity){
+        atomic_fetch_add_explicit(&b->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    b->events[i].category = span.category;
+    b->events[i].name = span.name;
+    b->events[i].start_ns = span.start_ns - atomic_load_explicit(&origin_ns, memory_order_relaxed);
+    b->events[i].dur_ns = end_ns - span.start_ns;
+    b->events[i].n_bytes = n_bytes;
+    b->events[i].has_bytes = has_bytes;
+    atomic_store_explicit(&b->count, i + 1, memory_order_release);
+}
+
+
+// Writes a JSON string, escaping quotes, backslashes and control characters.
+static void write_json_string(FILE* fp, const char* s){
+    fputc('"', fp);
+    for (; *s; s++){
+        unsigned char c = (unsigned char) *s;
+        if (c == '"' || c == '\\') fprintf(fp, "\\%c", c);
+        else if (c < 0x20) fprintf(fp, "\\u%04x", c);
+        else fputc(c, fp);
+    }
+    fputc('"', fp);
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Enables the recording of spans. Buffers allocated from now on hold events_per_thread events
+(TRACE_DEFAULT_CAPACITY if 0). Recording can be stopped and restarted; events accumulate until
+trace_clear.
+
+@return An integer error code.
+*/
+int trace_start(size_t events_per_thread){
+    uint_least64_t unset = 0;
+
+    if (!events_per_thread) events_per_thread = TRACE_DEFAULT_CAPACITY;
+    atomic_store_explicit(&capacity, events_per_thread, memory_order_relaxed);
+    atomic_compare_exchange_strong(&origin_ns, &unset, now_ns() - 1);
+    atomic_store_explicit(&enabled, 1, memory_order_release);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Disables the recording of spans. Spans already begun are still recorded when they end.
+*/
+void trace_stop(void){
+    atomic_store_explicit(&enabled, 0, memory_order_release);
+}
+
+
+int trace_enabled(void){
+    return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+
+/*
+Frees all recorded events. Must not be called while instrumented code is running on any thread.
+*/
+void trace_clear(void){
+    TraceBuffer* b = atomic_exchange(&buffers, NULL);
+
+    atomic_fetch_add(&epoch, 1);
+    while (b){
+        TraceBuffer* next = b->next;
+        free(b);
+        b = next;
+    }
+    atomic_store(&origin_ns, atomic_load(&enabled) ? now_ns() - 1 : 0);
+}
+
+
+/*
+Begins a span. Nothing is recorded unless tracing is enabled.
+*/
+TraceSpan trace_begin(const char* category, const char* name){
+    TraceSpan span = {category, name, 0};
+    if (atomic_load_explicit(&enabled, memory_order_relaxed)) span.start_ns = now_ns();
+    return span;
+}
+
+
+/*
+Ends a span and records it in the buffer of the calling thread.
+*/
+void trace_end(TraceSpan span){
+    record(span, 0, 0);
+}
+
+
+/*
+Ends a span, recording the number of bytes it processed (shown as an argument of the event).
+*/
+void trace_end_bytes(TraceSpan span, uint64_t n_bytes){
+    record(span, n_bytes, 1);
+}
+
+
+/*
+Names the calling thread in the exported trace (truncated to TRACE_THREAD_NAME_SIZE - 1
+characters). Only has an effect while tracing is enabled, and only the first name is kept, so
+that an export running concurrently never reads a name being rewritten.
+*/
+void trace_set_thread_name(const char* name){
+    TraceBuffer* b;
+
+    if (!trace_enabled() || !(b = thread_buffer())) return;
+    if (atomic_load_explicit(&b->named, memory_order_relaxed)) return;
+    strncpy(b->thread_name, name, TRACE_THREAD_NAME_SIZE - 1);
+    b->thread_name[TRACE_THREAD_NAME_SIZE - 1] = '\0';
+    atomic_store_explicit(&b->named, 1, memory_order_release);
+}
+
+
+/*
+Writes all recorded events in the Chrome Trace Event format (JSON object with "traceEvents").
+Can be called while other threads are recording; their events completed so far are exported.
+
+@return An integer error code.
+*/
+int trace_export_json(const char* fname){
+    FILE* fp = fopen(fname, "w");
+    long pid = (long) getpid();
+    size_t dropped = 0;
+    int first = 1;
+    int write_error;
+
+    if (!fp){
+        fprintf(stderr, "Failed to open %s: \"%s\"\n", fname, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+    for (TraceBuffer* b = atomic_load_explicit(&buffers, memory_order_acquire); b; b = b->next){
+        size_t count = atomic_load_explicit(&b->count, memory_order_acquire);
+
+        if (atomic_load_explicit(&b->named, memory_order_acquire) && b->thread_name[0]){
+            fprintf(fp, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%ld,\"tid\":%u,\"args\":{\"name\":",
+                first ? "" : ",\n", pid, (unsigned) b->tid);
+            write_json_string(fp, b->thread_name);
+            fprintf(fp, "}}");
+            first = 0;
+        }
+
+        for (size_t i = 0; i < count; i++){
+            const TraceEvent* e = &b->events[i];
+
+            fprintf(fp, "%s{\"ph\":\"X\",\"cat\":", first ? "" : ",\n");
+            write_json_string(fp, e->category);
+            fprintf(fp, ",\"name\":");
+            write_json_string(fp, e->name);
+            fprintf(fp, ",\"pid\":%ld,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", pid, (unsigned) b->tid,
+                e->start_ns / 1e3, e->dur_ns / 1e3);
+            if (e->has_bytes) fprintf(fp, ",\"args\":{\"bytes\":%llu}", (unsigned long long) e->n_bytes);
+            fprintf(fp, "}");
+            first = 0;
+        }
+        dropped += atomic_load_explicit(&b->dropped, memory_order_relaxed);
+    }
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%zu}}\n", dropped);
+
+    if (dropped)
+        fprintf(stderr, "%zu trace events were dropped (buffers full); increase the capacity of trace_start.\n",
+            dropped);
+
+    write_error = ferror(fp);
+    if (fclose(fp) || write_error){
+        fprintf(stderr, "Failed to write trace %s.\n", fname);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
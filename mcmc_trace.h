@@ -0,0 +1,38 @@
+#ifndef MCMC_TRACE_H
+#define MCMC_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACE_DEFAULT_CAPACITY 65536  // Default number of events recorded per thread.
+#define TRACE_THREAD_NAME_SIZE 32     // Maximum size of a thread name, including the null terminator.
+
+// Span being timed, returned by trace_begin. Name and category must be string literals (or
+// otherwise outlive the export).
+typedef struct {
+    const char* category;
+    const char* name;
+    uint64_t start_ns;  // 0 if tracing was disabled when the span began.
+} TraceSpan;
+
+int trace_start(size_t events_per_thread);
+void trace_stop(void);
+int trace_enabled(void);
+void trace_clear(void);
+
+TraceSpan trace_begin(const char* category, const char* name);
+void trace_end(TraceSpan span);
+void trace_end_bytes(TraceSpan span, uint64_t n_bytes);
+void trace_set_thread_name(const char* name);
+
+int trace_export_json(const char* fname);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
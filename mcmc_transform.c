@@ -0,0 +1,606 @@
+/*
+Transforms applied to the values of a column as it is loaded (see read_csv_double_vector_tf),
+so that scaling, logs or clamping do not require a separate pass over the loaded data.
+
+A column transform is a sequence of steps, applied in order. The loaders apply them to each chunk
+of freshly parsed values while it is still in cache. The affine and clamp steps have AVX2 and
+AVX-512 variants, selected at run time (see mcmc_cpu.h). So do log and log1p: the vector kernels
+split each value into exponent and mantissa and evaluate a polynomial on the mantissa (as fdlibm
+does, within ~1 ulp of libm); vectors with zero, negative, subnormal or non-finite values are
+passed to libm, so the special cases match it exactly.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <pthread.h>
+
+#include "mcmc_cpu.h"
+#include "mcmc_transform.h"
+
+#ifdef CPU_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+// Kernels of the vectorized steps, resolved on first use.
+typedef struct {
+    void (*affine_pd)(double* v, size_t n, double scale, double offset);
+    void (*affine_ps)(float* v, size_t n, float scale, float offset);
+    void (*clamp_pd)(double* v, size_t n, double lo, double hi);
+    void (*clamp_ps)(float* v, size_t n, float lo, float hi);
+    void (*log_pd)(double* v, size_t n);
+    void (*log_ps)(float* v, size_t n);
+    void (*log1p_pd)(double* v, size_t n);
+    void (*log1p_ps)(float* v, size_t n);
+} TransformKernels;
+
+/*
+Constants of the vectorized logs. x = 2^k * z with z in [sqrt(1/2), sqrt(2)); with f = z - 1 and
+s = f / (2 + f), log(z) = f - f^2/2 + s * (f^2/2 + R(s^2)), R being the fdlibm polynomials.
+*/
+#define LOG_PD_SHIFT 0x00095f619980c433LL  // 1.0 minus sqrt(1/2), in the bits of doubles.
+#define LOG_PD_ONE 0x3ff0000000000000LL
+#define LOG_PD_MAGIC 0x4330000000000000LL  // 2^52, to convert small integers to doubles.
+#define LOG_PS_SQRT_HALF 0x3f3504f3        // sqrt(1/2), in the bits of floats.
+
+static const double log_pd_coef[] = {
+    6.666666666666735130e-01, 3.999999999940941908e-01, 2.857142874366239149e-01,
+    2.222219843214978396e-01, 1.818357216161805012e-01, 1.531383769920937332e-01,
+    1.479819860511658591e-01};
+static const double ln2_hi = 6.93147180369123816490e-01, ln2_lo = 1.90821492927058770002e-10;
+
+static const float log_ps_coef[] = {
+    0.66666662693f, 0.40000972152f, 0.28498786688f, 0.24279078841f};
+static const float ln2_hi_f = 6.9313812256e-01f, ln2_lo_f = 9.0580006145e-06f;
+
+static const TransformKernels* kernels;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+
+// ------------------------------------------------------------------------------------------------
+// CONSTRUCTORS
+// ------------------------------------------------------------------------------------------------
+
+ColumnTransform affine_transform(double scale, double offset){
+    ColumnTransform t = {TRANSFORM_AFFINE, scale, offset, NULL, NULL};
+    return t;
+}
+
+ColumnTransform log_transform(void){
+    ColumnTransform t = {TRANSFORM_LOG, 0.0, 0.0, NULL, NULL};
+    return t;
+}
+
+ColumnTransform log1p_transform(void){
+    ColumnTransform t = {TRANSFORM_LOG1P, 0.0, 0.0, NULL, NULL};
+    return t;
+}
+
+ColumnTransform clamp_transform(double lo, double hi){
+    ColumnTransform t = {TRANSFORM_CLAMP, lo, hi, NULL, NULL};
+    return t;
+}
+
+ColumnTransform func_transform(transform_func func, void* user_data){
+    ColumnTransform t = {TRANSFORM_FUNC, 0.0, 0.0, func, user_data};
+    return t;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// KERNELS
+// ------------------------------------------------------------------------------------------------
+
+static void affine_pd_scalar(double* v, size_t n, double scale, double offset){
+    for (size_t i = 0; i < n; i++){
+        v[i] = v[i] * scale + offset;
+    }
+}
+
+
+static void affine_ps_scalar(float* v, size_t n, float scale, float offset){
+    for (size_t i = 0; i < n; i++){
+        v[i] = v[i] * scale + offset;
+    }
+}
+
+
+// NaN values are mapped to lo, in all the variants.
+static void clamp_pd_scalar(double* v, size_t n, double lo, double hi){
+    for (size_t i = 0; i < n; i++){
+        v[i] = fmin(fmax(v[i], lo), hi);
+    }
+}
+
+
+static void clamp_ps_scalar(float* v, size_t n, float lo, float hi){
+    for (size_t i = 0; i < n; i++){
+        v[i] = fminf(fmaxf(v[i], lo), hi);
+    }
+}
+
+
+static void log_pd_scalar(double* v, size_t n){
+    for (size_t i = 0; i < n; i++) v[i] = log(v[i]);
+}
+
+
+static void log_ps_scalar(float* v, size_t n){
+    for (size_t i = 0; i < n; i++) v[i] = logf(v[i]);
+}
+
+
+static void log1p_pd_scalar(double* v, size_t n){
+    for (size_t i = 0; i < n; i++) v[i] = log1p(v[i]);
+}
+
+
+static void log1p_ps_scalar(float* v, size_t n){
+    for (size_t i = 0; i < n; i++) v[i] = log1pf(v[i]);
+}
+
+
+#ifdef CPU_HAVE_AVX2
+
+CPU_TARGET_AVX2 static void affine_pd_avx2(double* v, size_t n, double scale, double offset){
+    __m256d s = _mm256_set1_pd(scale);
+    __m256d o = _mm256_set1_pd(offset);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4){
+        _mm256_storeu_pd(v + i, _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(v + i), s), o));
+    }
+    affine_pd_scalar(v + i, n - i, scale, offset);
+}
+
+
+CPU_TARGET_AVX2 static void affine_ps_avx2(float* v, size_t n, float scale, float offset){
+    __m256 s = _mm256_set1_ps(scale);
+    __m256 o = _mm256_set1_ps(offset);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        _mm256_storeu_ps(v + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(v + i), s), o));
+    }
+    affine_ps_scalar(v + i, n - i, scale, offset);
+}
+
+
+CPU_TARGET_AVX2 static void clamp_pd_avx2(double* v, size_t n, double lo, double hi){
+    __m256d l = _mm256_set1_pd(lo);
+    __m256d h = _mm256_set1_pd(hi);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4){
+        _mm256_storeu_pd(v + i, _mm256_min_pd(_mm256_max_pd(_mm256_loadu_pd(v + i), l), h));
+    }
+    clamp_pd_scalar(v + i, n - i, lo, hi);
+}
+
+
+CPU_TARGET_AVX2 static void clamp_ps_avx2(float* v, size_t n, float lo, float hi){
+    __m256 l = _mm256_set1_ps(lo);
+    __m256 h = _mm256_set1_ps(hi);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        _mm256_storeu_ps(v + i, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(v + i), l), h));
+    }
+    clamp_ps_scalar(v + i, n - i, lo, hi);
+}
+
+
+// Log of 4 positive normal doubles. The exponent k is taken biased (k + 1023, always positive),
+// so that it is converted with the 2^52 trick (AVX2 has no 64-bit integer conversion).
+CPU_TARGET_AVX2 static inline __m256d log_core_pd_avx2(__m256d x){
+    __m256i ix = _mm256_castpd_si256(x);
+    __m256i kb = _mm256_srli_epi64(_mm256_add_epi64(ix, _mm256_set1_epi64x(LOG_PD_SHIFT)), 52);
+    __m256i iz = _mm256_add_epi64(_mm256_sub_epi64(ix, _mm256_slli_epi64(kb, 52)),
+        _mm256_set1_epi64x(LOG_PD_ONE));
+    __m256d k = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(kb, _mm256_set1_epi64x(LOG_PD_MAGIC))),
+        _mm256_set1_pd(4503599627370496.0 + 1023.0));
+    __m256d f = _mm256_sub_pd(_mm256_castsi256_pd(iz), _mm256_set1_pd(1.0));
+    __m256d s = _mm256_div_pd(f, _mm256_add_pd(_mm256_set1_pd(2.0), f));
+    __m256d z = _mm256_mul_pd(s, s);
+    __m256d hfsq = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), f), f);
+    __m256d r = _mm256_set1_pd(log_pd_coef[6]);
+
+    for (int c = 5; c >= 0; c--) r = _mm256_fmadd_pd(r, z, _mm256_set1_pd(log_pd_coef[c]));
+    r = _mm256_mul_pd(r, z);
+    r = _mm256_fmadd_pd(s, _mm256_add_pd(hfsq, r), _mm256_mul_pd(k, _mm256_set1_pd(ln2_lo)));
+    return _mm256_fmsub_pd(k, _mm256_set1_pd(ln2_hi), _mm256_sub_pd(_mm256_sub_pd(hfsq, r), f));
+}
+
+
+// Log of 8 positive normal floats.
+CPU_TARGET_AVX2 static inline __m256 log_core_ps_avx2(__m256 x){
+    __m256i ix = _mm256_castps_si256(x);
+    __m256i t = _mm256_sub_epi32(ix, _mm256_set1_epi32(LOG_PS_SQRT_HALF));
+    __m256 k = _mm256_cvtepi32_ps(_mm256_srai_epi32(t, 23));
+    __m256i iz = _mm256_sub_epi32(ix, _mm256_and_si256(t, _mm256_set1_epi32((int) 0xff800000)));
+    __m256 f = _mm256_sub_ps(_mm256_castsi256_ps(iz), _mm256_set1_ps(1.0f));
+    __m256 s = _mm256_div_ps(f, _mm256_add_ps(_mm256_set1_ps(2.0f), f));
+    __m256 z = _mm256_mul_ps(s, s);
+    __m256 hfsq = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), f), f);
+    __m256 r = _mm256_set1_ps(log_ps_coef[3]);
+
+    for (int c = 2; c >= 0; c--) r = _mm256_fmadd_ps(r, z, _mm256_set1_ps(log_ps_coef[c]));
+    r = _mm256_mul_ps(r, z);
+    r = _mm256_fmadd_ps(s, _mm256_add_ps(hfsq, r), _mm256_mul_ps(k, _mm256_set1_ps(ln2_lo_f)));
+    return _mm256_fmsub_ps(k, _mm256_set1_ps(ln2_hi_f), _mm256_sub_ps(_mm256_sub_ps(hfsq, r), f));
+}
+
+
+// Mask of the lanes in [DBL_MIN, DBL_MAX] (false for NaN).
+CPU_TARGET_AVX2 static inline int normal_mask_pd_avx2(__m256d x){
+    return _mm256_movemask_pd(_mm256_and_pd(_mm256_cmp_pd(x, _mm256_set1_pd(DBL_MIN), _CMP_GE_OQ),
+        _mm256_cmp_pd(x, _mm256_set1_pd(DBL_MAX), _CMP_LE_OQ)));
+}
+
+
+CPU_TARGET_AVX2 static inline int normal_mask_ps_avx2(__m256 x){
+    return _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(x, _mm256_set1_ps(FLT_MIN), _CMP_GE_OQ),
+        _mm256_cmp_ps(x, _mm256_set1_ps(FLT_MAX), _CMP_LE_OQ)));
+}
+
+
+CPU_TARGET_AVX2 static void log_pd_avx2(double* v, size_t n){
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4){
+        __m256d x = _mm256_loadu_pd(v + i);
+        if (normal_mask_pd_avx2(x) == 0xf) _mm256_storeu_pd(v + i, log_core_pd_avx2(x));
+        else log_pd_scalar(v + i, 4);
+    }
+    log_pd_scalar(v + i, n - i);
+}
+
+
+CPU_TARGET_AVX2 static void log_ps_avx2(float* v, size_t n){
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        __m256 x = _mm256_loadu_ps(v + i);
+        if (normal_mask_ps_avx2(x) == 0xff) _mm256_storeu_ps(v + i, log_core_ps_avx2(x));
+        else log_ps_scalar(v + i, 8);
+    }
+    log_ps_scalar(v + i, n - i);
+}
+
+
+// log1p(x) = log(u) + (x - (u - 1)) / u, with u = 1 + x rounded; the second term corrects the
+// rounding of u.
+CPU_TARGET_AVX2 static void log1p_pd_avx2(double* v, size_t n){
+    __m256d one = _mm256_set1_pd(1.0);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4){
+        __m256d x = _mm256_loadu_pd(v + i);
+        __m256d u = _mm256_add_pd(one, x);
+        if (normal_mask_pd_avx2(u) == 0xf){
+            __m256d c = _mm256_div_pd(_mm256_sub_pd(x, _mm256_sub_pd(u, one)), u);
+            _mm256_storeu_pd(v + i, _mm256_add_pd(log_core_pd_avx2(u), c));
+        }
+        else log1p_pd_scalar(v + i, 4);
+    }
+    log1p_pd_scalar(v + i, n - i);
+}
+
+
+CPU_TARGET_AVX2 static void log1p_ps_avx2(float* v, size_t n){
+    __m256 one = _mm256_set1_ps(1.0f);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        __m256 x = _mm256_loadu_ps(v + i);
+        __m256 u = _mm256_add_ps(one, x);
+        if (normal_mask_ps_avx2(u) == 0xff){
+            __m256 c = _mm256_div_ps(_mm256_sub_ps(x, _mm256_sub_ps(u, one)), u);
+            _mm256_storeu_ps(v + i, _mm256_add_ps(log_core_ps_avx2(u), c));
+        }
+        else log1p_ps_scalar(v + i, 8);
+    }
+    log1p_ps_scalar(v + i, n - i);
+}
+
+#endif
+
+
+#ifdef CPU_HAVE_AVX512
+
+CPU_TARGET_AVX512 static void affine_pd_avx512(double* v, size_t n, double scale, double offset){
+    __m512d s = _mm512_set1_pd(scale);
+    __m512d o = _mm512_set1_pd(offset);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        _mm512_storeu_pd(v + i, _mm512_add_pd(_mm512_mul_pd(_mm512_loadu_pd(v + i), s), o));
+    }
+    affine_pd_scalar(v + i, n - i, scale, offset);
+}
+
+
+CPU_TARGET_AVX512 static void affine_ps_avx512(float* v, size_t n, float scale, float offset){
+    __m512 s = _mm512_set1_ps(scale);
+    __m512 o = _mm512_set1_ps(offset);
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16){
+        _mm512_storeu_ps(v + i, _mm512_add_ps(_mm512_mul_ps(_mm512_loadu_ps(v + i), s), o));
+    }
+    affine_ps_scalar(v + i, n - i, scale, offset);
+}
+
+
+CPU_TARGET_AVX512 static void clamp_pd_avx512(double* v, size_t n, double lo, double hi){
+    __m512d l = _mm512_set1_pd(lo);
+    __m512d h = _mm512_set1_pd(hi);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        _mm512_storeu_pd(v + i, _mm512_min_pd(_mm512_max_pd(_mm512_loadu_pd(v + i), l), h));
+    }
+    clamp_pd_scalar(v + i, n - i, lo, hi);
+}
+
+
+CPU_TARGET_AVX512 static void clamp_ps_avx512(float* v, size_t n, float lo, float hi){
+    __m512 l = _mm512_set1_ps(lo);
+    __m512 h = _mm512_set1_ps(hi);
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16){
+        _mm512_storeu_ps(v + i, _mm512_min_ps(_mm512_max_ps(_mm512_loadu_ps(v + i), l), h));
+    }
+    clamp_ps_scalar(v + i, n - i, lo, hi);
+}
+
+
+CPU_TARGET_AVX512 static inline __m512d log_core_pd_avx512(__m512d x){
+    __m512i ix = _mm512_castpd_si512(x);
+    __m512i kb = _mm512_srli_epi64(_mm512_add_epi64(ix, _mm512_set1_epi64(LOG_PD_SHIFT)), 52);
+    __m512i iz = _mm512_add_epi64(_mm512_sub_epi64(ix, _mm512_slli_epi64(kb, 52)),
+        _mm512_set1_epi64(LOG_PD_ONE));
+    __m512d k = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(kb, _mm512_set1_epi64(LOG_PD_MAGIC))),
+        _mm512_set1_pd(4503599627370496.0 + 1023.0));
+    __m512d f = _mm512_sub_pd(_mm512_castsi512_pd(iz), _mm512_set1_pd(1.0));
+    __m512d s = _mm512_div_pd(f, _mm512_add_pd(_mm512_set1_pd(2.0), f));
+    __m512d z = _mm512_mul_pd(s, s);
+    __m512d hfsq = _mm512_mul_pd(_mm512_mul_pd(_mm512_set1_pd(0.5), f), f);
+    __m512d r = _mm512_set1_pd(log_pd_coef[6]);
+
+    for (int c = 5; c >= 0; c--) r = _mm512_fmadd_pd(r, z, _mm512_set1_pd(log_pd_coef[c]));
+    r = _mm512_mul_pd(r, z);
+    r = _mm512_fmadd_pd(s, _mm512_add_pd(hfsq, r), _mm512_mul_pd(k, _mm512_set1_pd(ln2_lo)));
+    return _mm512_fmsub_pd(k, _mm512_set1_pd(ln2_hi), _mm512_sub_pd(_mm512_sub_pd(hfsq, r), f));
+}
+
+
+CPU_TARGET_AVX512 static inline __m512 log_core_ps_avx512(__m512 x){
+    __m512i ix = _mm512_castps_si512(x);
+    __m512i t = _mm512_sub_epi32(ix, _mm512_set1_epi32(LOG_PS_SQRT_HALF));
+    __m512 k = _mm512_cvtepi32_ps(_mm512_srai_epi32(t, 23));
+    __m512i iz = _mm512_sub_epi32(ix, _mm512_and_si512(t, _mm512_set1_epi32((int) 0xff800000)));
+    __m512 f = _mm512_sub_ps(_mm512_castsi512_ps(iz), _mm512_set1_ps(1.0f));
+    __m512 s = _mm512_div_ps(f, _mm512_add_ps(_mm512_set1_ps(2.0f), f));
+    __m512 z = _mm512_mul_ps(s, s);
+    __m512 hfsq = _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), f), f);
+    __m512 r = _mm512_set1_ps(log_ps_coef[3]);
+
+    for (int c = 2; c >= 0; c--) r = _mm512_fmadd_ps(r, z, _mm512_set1_ps(log_ps_coef[c]));
+    r = _mm512_mul_ps(r, z);
+    r = _mm512_fmadd_ps(s, _mm512_add_ps(hfsq, r), _mm512_mul_ps(k, _mm512_set1_ps(ln2_lo_f)));
+    return _mm512_fmsub_ps(k, _mm512_set1_ps(ln2_hi_f), _mm512_sub_ps(_mm512_sub_ps(hfsq, r), f));
+}
+
+
+CPU_TARGET_AVX512 static inline __mmask8 normal_mask_pd_avx512(__m512d x){
+    return _mm512_cmp_pd_mask(x, _mm512_set1_pd(DBL_MIN), _CMP_GE_OQ)
+        & _mm512_cmp_pd_mask(x, _mm512_set1_pd(DBL_MAX), _CMP_LE_OQ);
+}
+
+
+CPU_TARGET_AVX512 static inline __mmask16 normal_mask_ps_avx512(__m512 x){
+    return _mm512_cmp_ps_mask(x, _mm512_set1_ps(FLT_MIN), _CMP_GE_OQ)
+        & _mm512_cmp_ps_mask(x, _mm512_set1_ps(FLT_MAX), _CMP_LE_OQ);
+}
+
+
+CPU_TARGET_AVX512 static void log_pd_avx512(double* v, size_t n){
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        __m512d x = _mm512_loadu_pd(v + i);
+        if (normal_mask_pd_avx512(x) == 0xff) _mm512_storeu_pd(v + i, log_core_pd_avx512(x));
+        else log_pd_scalar(v + i, 8);
+    }
+    log_pd_scalar(v + i, n - i);
+}
+
+
+CPU_TARGET_AVX512 static void log_ps_avx512(float* v, size_t n){
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16){
+        __m512 x = _mm512_loadu_ps(v + i);
+        if (normal_mask_ps_avx512(x) == 0xffff) _mm512_storeu_ps(v + i, log_core_ps_avx512(x));
+        else log_ps_scalar(v + i, 16);
+    }
+    log_ps_scalar(v + i, n - i);
+}
+
+
+CPU_TARGET_AVX512 static void log1p_pd_avx512(double* v, size_t n){
+    __m512d one = _mm512_set1_pd(1.0);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        __m512d x = _mm512_loadu_pd(v + i);
+        __m512d u = _mm512_add_pd(one, x);
+        if (normal_mask_pd_avx512(u) == 0xff){
+            __m512d c = _mm512_div_pd(_mm512_sub_pd(x, _mm512_sub_pd(u, one)), u);
+            _mm512_storeu_pd(v + i, _mm512_add_pd(log_core_pd_avx512(u), c));
+        }
+        else log1p_pd_scalar(v + i, 8);
+    }
+    log1p_pd_scalar(v + i, n - i);
+}
+
+
+CPU_TARGET_AVX512 static void log1p_ps_avx512(float* v, size_t n){
+    __m512 one = _mm512_set1_ps(1.0f);
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16){
+        __m512 x = _mm512_loadu_ps(v + i);
+        __m512 u = _mm512_add_ps(one, x);
+        if (normal_mask_ps_avx512(u) == 0xffff){
+            __m512 c = _mm512_div_ps(_mm512_sub_ps(x, _mm512_sub_ps(u, one)), u);
+            _mm512_storeu_ps(v + i, _mm512_add_ps(log_core_ps_avx512(u), c));
+        }
+        else log1p_ps_scalar(v + i, 16);
+    }
+    log1p_ps_scalar(v + i, n - i);
+}
+
+#endif
+
+
+static const TransformKernels scalar_kernels =
+    {affine_pd_scalar, affine_ps_scalar, clamp_pd_scalar, clamp_ps_scalar,
+     log_pd_scalar, log_ps_scalar, log1p_pd_scalar, log1p_ps_scalar};
+#ifdef CPU_HAVE_AVX2
+static const TransformKernels avx2_kernels =
+    {affine_pd_avx2, affine_ps_avx2, clamp_pd_avx2, clamp_ps_avx2,
+     log_pd_avx2, log_ps_avx2, log1p_pd_avx2, log1p_ps_avx2};
+#endif
+#ifdef CPU_HAVE_AVX512
+static const TransformKernels avx512_kernels =
+    {affine_pd_avx512, affine_ps_avx512, clamp_pd_avx512, clamp_ps_avx512,
+     log_pd_avx512, log_ps_avx512, log1p_pd_avx512, log1p_ps_avx512};
+#endif
+
+
+static void resolve_kernels(void){
+    kernels = &scalar_kernels;
+
+    switch (cpu_isa()){
+    case CPU_ISA_AVX512:
+#ifdef CPU_HAVE_AVX512
+        kernels = &avx512_kernels;
+        break;
+#endif
+    case CPU_ISA_AVX2:
+#ifdef CPU_HAVE_AVX2
+        kernels = &avx2_kernels;
+#endif
+        break;
+    case CPU_ISA_SCALAR:
+        break;
+    }
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Checks a sequence of transform steps (known kinds, a function for TRANSFORM_FUNC, lo <= hi).
+
+@return An integer error code.
+*/
+int check_transforms(const ColumnTransform* steps, size_t n_steps){
+    for (size_t s = 0; s < n_steps; s++){
+        switch (steps[s].kind){
+        case TRANSFORM_AFFINE:
+        case TRANSFORM_LOG:
+        case TRANSFORM_LOG1P:
+            break;
+
+        case TRANSFORM_CLAMP:
+            if (!(steps[s].a <= steps[s].b)){
+                fprintf(stderr, "Invalid clamp bounds [%g, %g] in transform step %zu.\n",
+                    steps[s].a, steps[s].b, s);
+                return EXIT_FAILURE;
+            }
+            break;
+
+        case TRANSFORM_FUNC:
+            if (!steps[s].func){
+                fprintf(stderr, "Missing function in transform step %zu.\n", s);
+                return EXIT_FAILURE;
+            }
+            break;
+
+        default:
+            fprintf(stderr, "Unknown kind %d in transform step %zu.\n", (int) steps[s].kind, s);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/*
+Applies a sequence of transform steps, in order, to a vector of doubles (in place).
+Log of zero or negative values gives -inf or NaN, as in libm; other values are within ~1 ulp of
+libm. The steps must have been checked.
+*/
+void apply_transforms(double* vec, size_t size, const ColumnTransform* steps, size_t n_steps){
+    pthread_once(&kernels_once, resolve_kernels);
+
+    for (size_t s = 0; s < n_steps; s++){
+        const ColumnTransform* t = steps + s;
+
+        switch (t->kind){
+        case TRANSFORM_AFFINE:
+            kernels->affine_pd(vec, size, t->a, t->b);
+            break;
+        case TRANSFORM_LOG:
+            kernels->log_pd(vec, size);
+            break;
+        case TRANSFORM_LOG1P:
+            kernels->log1p_pd(vec, size);
+            break;
+        case TRANSFORM_CLAMP:
+            kernels->clamp_pd(vec, size, t->a, t->b);
+            break;
+        case TRANSFORM_FUNC:
+            for (size_t i = 0; i < size; i++) vec[i] = t->func(vec[i], t->user_data);
+            break;
+        }
+    }
+}
+
+
+/*
+Single precision version of apply_transforms. The built-in steps are computed in single
+precision; user functions are evaluated in double precision and rounded back.
+*/
+void apply_transforms_f32(float* vec, size_t size, const ColumnTransform* steps, size_t n_steps){
+    pthread_once(&kernels_once, resolve_kernels);
+
+    for (size_t s = 0; s < n_steps; s++){
+        const ColumnTransform* t = steps + s;
+
+        switch (t->kind){
+        case TRANSFORM_AFFINE:
+            kernels->affine_ps(vec, size, (float) t->a, (float) t->b);
+            break;
+        case TRANSFORM_LOG:
+            kernels->log_ps(vec, size);
+            break;
+        case TRANSFORM_LOG1P:
+            kernels->log1p_ps(vec, size);
+            break;
+        case TRANSFORM_CLAMP:
+            kernels->clamp_ps(vec, size, (float) t->a, (float) t->b);
+            break;
+        case TRANSFORM_FUNC:
+            for (size_t i = 0; i < size; i++) vec[i] = (float) t->func(vec[i], t->user_data);
+            break;
+        }
+    }
+}
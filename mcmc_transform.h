@@ -0,0 +1,43 @@
+#ifndef MCMC_TRANSFORM_H
+#define MCMC_TRANSFORM_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Kind of transform applied to the values of a column.
+typedef enum {
+    TRANSFORM_AFFINE = 1,  // x -> scale * x + offset (e.g. counts to rates per 100k).
+    TRANSFORM_LOG = 2,     // x -> log(x)
+    TRANSFORM_LOG1P = 3,   // x -> log(1 + x)
+    TRANSFORM_CLAMP = 4,   // x -> min(max(x, lo), hi)
+    TRANSFORM_FUNC = 5     // x -> func(x, user_data)
+} TransformKind;
+
+typedef double (*transform_func)(double x, void* user_data);
+
+// One step of a column transform. Use the constructors below rather than filling it directly.
+typedef struct {
+    TransformKind kind;
+    double a, b;           // scale and offset (affine), or lo and hi (clamp).
+    transform_func func;   // TRANSFORM_FUNC only.
+    void* user_data;
+} ColumnTransform;
+
+ColumnTransform affine_transform(double scale, double offset);
+ColumnTransform log_transform(void);
+ColumnTransform log1p_transform(void);
+ColumnTransform clamp_transform(double lo, double hi);
+ColumnTransform func_transform(transform_func func, void* user_data);
+
+int check_transforms(const ColumnTransform* steps, size_t n_steps);
+void apply_transforms(double* vec, size_t size, const ColumnTransform* steps, size_t n_steps);
+void apply_transforms_f32(float* vec, size_t size, const ColumnTransform* steps, size_t n_steps);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
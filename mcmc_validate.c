@@ -0,0 +1,220 @@
+/*
+Range and consistency checks of ILI data, run by read_ili_csv_checked on each chunk of freshly
+parsed rows (while still in cache) instead of in a separate pass over the loaded data.
+
+On CPUs with AVX2 (selected at run time, see mcmc_cpu.h; AVX-512 nodes use the same variant),
+rows are checked 8 at a time with branch-free vector comparisons; only the invalid rows, and the
+rows at the end of a year (whose number of weeks is looked up by the scalar path), are re-checked
+one by one.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "mcmc_cpu.h"
+#include "mcmc_grid.h"
+#include "mcmc_validate.h"
+
+#ifdef CPU_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+#define VALIDATION_GROUP 8  // Rows checked at once by the vector variant.
+
+// ------------------------------------------------------------------------------------------------
+// AUXILIARY FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+// Bounds actually checked: disabled checks get bounds that every value satisfies.
+typedef struct {
+    int min_week, max_week;
+    int min_year, max_year;
+    int min_estInc;
+    int continuity;
+} Bounds;
+
+typedef size_t (*validate_func)(const ILIinput* data_p, size_t start, size_t end, const Bounds* b,
+    size_t* n_reported_p);
+
+static validate_func vector_kernel;  // NULL when rows are only checked by the scalar path.
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static Bounds effective_bounds(const ILIvalidation* rules_p){
+    Bounds b = {INT_MIN, INT_MAX, INT_MIN, INT_MAX, INT_MIN, 0};
+
+    if (rules_p->checks & ILI_CHECK_WEEK){ b.min_week = rules_p->min_week; b.max_week = rules_p->max_week; }
+    if (rules_p->checks & ILI_CHECK_YEAR){ b.min_year = rules_p->min_year; b.max_year = rules_p->max_year; }
+    if (rules_p->checks & ILI_CHECK_ESTINC) b.min_estInc = rules_p->min_estInc;
+    b.continuity = (rules_p->checks & ILI_CHECK_CONTINUITY) != 0;
+    return b;
+}
+
+
+/*
+Whether (year, week) is the epiweek that follows (prev_year, prev_week): week 53 only exists in
+53-week years, and the following year starts after the last week of the year (see
+epiweeks_in_year). Differences are taken only after checking their sign, so that values near
+INT_MAX or INT_MIN cannot overflow. The number of weeks is only computed at the end of a year.
+*/
+static int is_next_epiweek(int prev_year, int prev_week, int year, int week){
+    if (year == prev_year && week > prev_week && week - 1 == prev_week)
+        return week <= 52 || week <= epiweeks_in_year(year);
+    return week == 1 && year > prev_year && year - 1 == prev_year
+        && prev_week >= 52 && prev_week >= epiweeks_in_year(prev_year);
+}
+
+
+// Returns the ILI_CHECK_* flags of the checks failed by row i.
+static unsigned check_row(const ILIinput* data_p, size_t i, const Bounds* b){
+    int year = data_p->year[i], week = data_p->week[i];
+    unsigned failed = 0;
+
+    if (week < b->min_week || week > b->max_week) failed |= ILI_CHECK_WEEK;
+    if (year < b->min_year || year > b->max_year) failed |= ILI_CHECK_YEAR;
+    if (data_p->estInc[i] < b->min_estInc) failed |= ILI_CHECK_ESTINC;
+    if (b->continuity && i > 0 && !is_next_epiweek(data_p->year[i-1], data_p->week[i-1], year, week))
+        failed |= ILI_CHECK_CONTINUITY;
+    return failed;
+}
+
+
+// Reports the checks failed by row i. Lines are 1-based and the first line is the header.
+static void report_row(const ILIinput* data_p, size_t i, unsigned failed, const Bounds* b){
+    size_t line = i + 2;
+
+    if (failed & ILI_CHECK_WEEK)
+        fprintf(stderr, "Invalid ILI row %zu (line %zu): week %d is out of range [%d, %d]\n",
+            i, line, data_p->week[i], b->min_week, b->max_week);
+    if (failed & ILI_CHECK_YEAR)
+        fprintf(stderr, "Invalid ILI row %zu (line %zu): year %d is out of range [%d, %d]\n",
+            i, line, data_p->year[i], b->min_year, b->max_year);
+    if (failed & ILI_CHECK_ESTINC)
+        fprintf(stderr, "Invalid ILI row %zu (line %zu): estInc %d is below %d\n",
+            i, line, data_p->estInc[i], b->min_estInc);
+    if (failed & ILI_CHECK_CONTINUITY)
+        fprintf(stderr, "Invalid ILI row %zu (line %zu): %d-W%02d does not follow %d-W%02d\n",
+            i, line, data_p->year[i], data_p->week[i], data_p->year[i-1], data_p->week[i-1]);
+}
+
+
+// Checks one row, reporting it if invalid (up to VALIDATION_MAX_REPORTS rows). Returns 1 if invalid.
+static size_t validate_row(const ILIinput* data_p, size_t i, const Bounds* b, size_t* n_reported_p){
+    unsigned failed = check_row(data_p, i, b);
+
+    if (!failed) return 0;
+    if (*n_reported_p < VALIDATION_MAX_REPORTS) report_row(data_p, i, failed, b);
+    (*n_reported_p)++;
+    return 1;
+}
+
+
+#ifdef CPU_HAVE_AVX2
+// Checks rows [start, end), a multiple of VALIDATION_GROUP rows with start > 0.
+CPU_TARGET_AVX2 static size_t validate_avx2(const ILIinput* data_p, size_t start, size_t end,
+    const Bounds* b, size_t* n_reported_p){
+    size_t n_invalid = 0;
+    __m256i min_week = _mm256_set1_epi32(b->min_week), max_week = _mm256_set1_epi32(b->max_week);
+    __m256i min_year = _mm256_set1_epi32(b->min_year), max_year = _mm256_set1_epi32(b->max_year);
+    __m256i min_estInc = _mm256_set1_epi32(b->min_estInc);
+    __m256i continuity = _mm256_set1_epi32(b->continuity ? -1 : 0);
+    __m256i one = _mm256_set1_epi32(1), last_weeks = _mm256_set1_epi32(51), week_52 = _mm256_set1_epi32(52);
+
+    for (size_t i = start; i < end; i += VALIDATION_GROUP){
+        __m256i week = _mm256_loadu_si256((const __m256i*) (data_p->week + i));
+        __m256i year = _mm256_loadu_si256((const __m256i*) (data_p->year + i));
+        __m256i estInc = _mm256_loadu_si256((const __m256i*) (data_p->estInc + i));
+        __m256i prev_week = _mm256_loadu_si256((const __m256i*) (data_p->week + i - 1));
+        __m256i prev_year = _mm256_loadu_si256((const __m256i*) (data_p->year + i - 1));
+        __m256i bad, next, wrap, year_end;
+        int mask;
+
+        // Ranges
+        bad = _mm256_or_si256(_mm256_cmpgt_epi32(min_week, week), _mm256_cmpgt_epi32(week, max_week));
+        bad = _mm256_or_si256(bad, _mm256_cmpgt_epi32(min_year, year));
+        bad = _mm256_or_si256(bad, _mm256_cmpgt_epi32(year, max_year));
+        bad = _mm256_or_si256(bad, _mm256_cmpgt_epi32(min_estInc, estInc));
+
+        // Continuity: next week of the same year, or week 1 after week 52/53 of the previous year.
+        // As in is_next_epiweek, x - 1 == prev is only compared when x > prev (no wrap-around).
+        next = _mm256_and_si256(_mm256_cmpgt_epi32(week, prev_week),
+            _mm256_cmpeq_epi32(_mm256_sub_epi32(week, one), prev_week));
+        next = _mm256_and_si256(next, _mm256_cmpeq_epi32(year, prev_year));
+        wrap = _mm256_and_si256(_mm256_cmpgt_epi32(year, prev_year),
+            _mm256_cmpeq_epi32(_mm256_sub_epi32(year, one), prev_year));
+        wrap = _mm256_and_si256(wrap, _mm256_and_si256(_mm256_cmpgt_epi32(prev_week, last_weeks),
+            _mm256_cmpeq_epi32(week, one)));
+        bad = _mm256_or_si256(bad, _mm256_andnot_si256(_mm256_or_si256(next, wrap), continuity));
+
+        // Rows at the end of a year depend on its number of weeks (epiweeks_in_year): re-checked
+        // by the scalar path, which only reports them if they are invalid.
+        year_end = _mm256_or_si256(_mm256_cmpgt_epi32(prev_week, last_weeks), _mm256_cmpgt_epi32(week, week_52));
+        bad = _mm256_or_si256(bad, _mm256_and_si256(year_end, continuity));
+
+        // Rare path: re-check the invalid (or year-end) rows one by one, to report them.
+        mask = _mm256_movemask_ps(_mm256_castsi256_ps(bad));
+        while (mask){
+            int lane = __builtin_ctz(mask);
+            n_invalid += validate_row(data_p, i + lane, b, n_reported_p);
+            mask &= mask - 1;
+        }
+    }
+    return n_invalid;
+}
+#endif
+
+
+static void resolve_kernels(void){
+    vector_kernel = NULL;
+#ifdef CPU_HAVE_AVX2
+    if (cpu_isa() >= CPU_ISA_AVX2) vector_kernel = validate_avx2;
+#endif
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// HIGH-LEVEL INTERFACE FUNCTIONS
+// ------------------------------------------------------------------------------------------------
+
+/*
+Returns the default checks: weeks in [1, 53], years in [1900, 2100], estInc >= 0 and
+consecutive epiweeks.
+*/
+ILIvalidation default_ili_validation(void){
+    ILIvalidation rules = {ILI_CHECK_ALL, 1, 53, 1900, 2100, 0};
+    return rules;
+}
+
+
+/*
+Checks rows [start, end) of ILI data against the given rules. The continuity of row start is
+checked against row start - 1, so that consecutive chunks can be checked independently.
+
+Invalid rows are reported to stderr, up to VALIDATION_MAX_REPORTS rows in total, counted by
+n_reported_p (which must be zero at the first call of a load).
+
+@return The number of invalid rows.
+*/
+size_t validate_ili_rows(const ILIinput* data_p, size_t start, size_t end,
+    const ILIvalidation* rules_p, size_t* n_reported_p){
+    Bounds b = effective_bounds(rules_p);
+    size_t n_invalid = 0;
+    size_t i = start;
+
+    pthread_once(&kernels_once, resolve_kernels);
+
+    // The first row has no predecessor, so it is always checked by the scalar path.
+    if (i == 0 && i < end) n_invalid += validate_row(data_p, i++, &b, n_reported_p);
+
+    if (vector_kernel && i + VALIDATION_GROUP <= end){
+        size_t n_vector = (end - i) / VALIDATION_GROUP * VALIDATION_GROUP;
+        n_invalid += vector_kernel(data_p, i, i + n_vector, &b, n_reported_p);
+        i += n_vector;
+    }
+
+    for (; i < end; i++){
+        n_invalid += validate_row(data_p, i, &b, n_reported_p);
+    }
+    return n_invalid;
+}
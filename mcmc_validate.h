@@ -0,0 +1,20 @@
+#ifndef MCMC_VALIDATE_H
+#define MCMC_VALIDATE_H
+
+#include <stddef.h>
+#include "mcmc_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VALIDATION_MAX_REPORTS 10  // Maximum number of invalid rows reported individually by a load.
+
+size_t validate_ili_rows(const ILIinput* data_p, size_t start, size_t end,
+    const ILIvalidation* rules_p, size_t* n_reported_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -17,7 +17,7 @@ int main (int argc, char *argv[])
   ILIinput data = {};
 
   double* contacts = NULL;
-  int t = 0;
+  size_t t = 0;
 
   // Check the arguments given to the program call
   if (argc < 3) {
@@ -30,33 +30,34 @@ int main (int argc, char *argv[])
   // -------------- USE THESE CHUNKS IN YOUR CODE ----------------
   // Read the ILI file. Return if reading is unsuccessful.
   if (read_ili_csv(fname, &data)){
-    // [[ Please perform free/deallocations here ]]
+    free_ili_input(&data);
     return EXIT_FAILURE;
   }
 
   // Read the contacts file. Return if unsuccessful.
   if (read_csv_double_vector(contacts_fname, &contacts, &t)){
-    // [[ Please perform free/deallocations here ]]
+    free_csv_vector(contacts);
+    free_ili_input(&data);
     return EXIT_FAILURE;
   }
 
   // -----------------------------------------------------------
 
   // Print ILI content
-  for (int i = 0; i < data.size; i++){
+  for (size_t i = 0; i < data.size; i++){
     printf("%d, %d, %d\n", data.year[i], data.week[i], data.estInc[i]);
   }
-  printf("Data has %lu entries.\n", data.size);
+  printf("Data has %zu entries.\n", data.size);
 
   // Print contacts.csv content
-  for (int i = 0; i < t; i++){
+  for (size_t i = 0; i < t; i++){
     printf("%lf\n", contacts[i]);
   }
-  printf("Data has %d entries.\n", t);
+  printf("Data has %zu entries.\n", t);
 
 
-  // Free contacts data
-  free(contacts);
+  // Free contacts data with interface function.
+  free_csv_vector(contacts);
 
   // Free ILI data with interface function.
   free_ili_input(&data);
@@ -0,0 +1,136 @@
+/*
+Streams a synthetic contacts file larger than 4 GiB, with more than 2^31 rows, through
+read_csv_float_vector, and compares its throughput with the one of a small file.
+
+Checks that the row count is returned in full (64 bits) and that the first, last and
+2^31-th values are the ones written. The large file takes ~6.5 GB of disk and the loaded
+vector ~8.7 GB of memory; the number of rows can be reduced with a second argument.
+
+Usage: my_large_csv_test <directory for the generated files> [n_rows]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <time.h>
+#include "mcmc_io.h"
+
+#define DEFAULT_ROWS (((size_t) 1 << 31) + ((size_t) 1 << 24))  // More than 2^31 rows, ~6.5 GB.
+#define SMALL_ROWS ((size_t) 1000000)
+#define FIRST_VALUE 0.5f
+#define LAST_VALUE 9.25f
+#define GEN_BUF_SIZE (1 << 20)
+
+
+// Value of the (0-based) row i of a generated file with n rows.
+static float expected_value(size_t i, size_t n){
+  if (i == 0) return FIRST_VALUE;
+  if (i == n - 1) return LAST_VALUE;
+  return (float) (i % 10);
+}
+
+
+// Writes a file with a header and n rows ",<digit>" (empty index column), except the first and last.
+static int generate_file(const char* fname, size_t n){
+  FILE* fp = fopen(fname, "wb");
+  static char buf[GEN_BUF_SIZE];
+  size_t len = 0;
+
+  if (!fp){
+    perror(fname);
+    return EXIT_FAILURE;
+  }
+  fputs("index,contacts\n", fp);
+  for (size_t i = 0; i < n; i++){
+    if (len > GEN_BUF_SIZE - 16){
+      if (fwrite(buf, 1, len, fp) != len) break;
+      len = 0;
+    }
+    if (i == 0 || i == n - 1) len += (size_t) sprintf(buf + len, ",%g\n", expected_value(i, n));
+    else {
+      buf[len++] = ',';
+      buf[len++] = (char) ('0' + i % 10);
+      buf[len++] = '\n';
+    }
+  }
+  fwrite(buf, 1, len, fp);
+  if (ferror(fp) | fclose(fp)){
+    fprintf(stderr, "Failed to write %s\n", fname);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+
+static double seconds_since(const struct timespec* t0){
+  struct timespec t1;
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  return (double) (t1.tv_sec - t0->tv_sec) + 1e-9 * (double) (t1.tv_nsec - t0->tv_nsec);
+}
+
+
+// Generates, reads and checks a file with n rows. Prints the throughput of the reading.
+static int stream_file(const char* fname, size_t n, const char* label){
+  float* vec = NULL;
+  size_t size = 0;
+  struct timespec t0;
+  double secs;
+  int status;
+
+  if (generate_file(fname, n)) return EXIT_FAILURE;
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  status = read_csv_float_vector(fname, &vec, &size);
+  secs = seconds_since(&t0);
+  remove(fname);
+  if (status) return EXIT_FAILURE;
+
+  if (size != n){
+    fprintf(stderr, "%s: read %zu rows, expected %zu\n", label, size, n);
+    status = EXIT_FAILURE;
+  }
+  else if (vec[0] != expected_value(0, n) || vec[n - 1] != expected_value(n - 1, n)){
+    fprintf(stderr, "%s: first/last values %g/%g, expected %g/%g\n", label, vec[0], vec[n - 1],
+      expected_value(0, n), expected_value(n - 1, n));
+    status = EXIT_FAILURE;
+  }
+  else if (n > (size_t) INT_MAX + 1 && vec[(size_t) INT_MAX + 1] != expected_value((size_t) INT_MAX + 1, n)){
+    fprintf(stderr, "%s: wrong value at row 2^31\n", label);
+    status = EXIT_FAILURE;
+  }
+  else {
+    printf("%-6s %12zu rows  %7.3f s  %6.2f Mrows/s\n", label, size, secs, 1e-6 * (double) size / secs);
+  }
+
+  free_csv_vector(vec);
+  return status;
+}
+
+
+int main (int argc, char *argv[])
+{
+  char small_fname[4096], large_fname[4096];
+  size_t n_rows = DEFAULT_ROWS;
+
+  // Check the arguments given to the program call
+  if (argc < 2) {
+    fprintf(stderr, "Please inform a directory for the generated files (and optionally the number of rows).\n");
+    return EXIT_FAILURE;
+  }
+  if (argc > 2) n_rows = strtoull(argv[2], NULL, 10);
+  if (n_rows < 2) n_rows = 2;
+  snprintf(small_fname, sizeof(small_fname), "%s/small_contacts.csv", argv[1]);
+  snprintf(large_fname, sizeof(large_fname), "%s/large_contacts.csv", argv[1]);
+
+  if (n_rows <= (size_t) INT_MAX)
+    printf("Warning: %zu rows do not exceed 2^31; the 64-bit row count is not exercised.\n", n_rows);
+
+  // Small-file throughput, as reference
+  if (stream_file(small_fname, SMALL_ROWS, "small")) return EXIT_FAILURE;
+
+  // Large file
+  if (stream_file(large_fname, n_rows, "large")) return EXIT_FAILURE;
+
+  printf("OK\n");
+  return EXIT_SUCCESS;
+}